@@ -1,11 +1,12 @@
 #include "analysis.h"
 #include "analysisregister.h"
+#include "record.h"
+#include "speciesindex.h"
 #include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <sstream>
 #include <string>
-#include <unordered_set>
 
 class RapidityAndPtHistogramAnalysis : public Analysis {
 public:
@@ -23,65 +24,111 @@ public:
             2212
         };
         for (int pdg : positive_pdgs) {
-            selected_pdgs_.insert(pdg);
+            species_.add(pdg);
             if (pdg != 111 && pdg != 310 && pdg != 130) {
-                selected_pdgs_.insert(-pdg);
+                species_.add(-pdg);
             }
         }
+        pending_.resize(species_.size());
+        groups_.resize((wounded_max_ - wounded_min_) / wounded_bin_width_ + 1);
 
     }
 
-    void analyze_particle_block(const ParticleBlock& block, const Accessor& accessor) override {
+    std::vector<Quantity> required_quantities() const override {
+        return {Quantity::PDG, Quantity::NCOLL, Quantity::P0,
+                Quantity::PX, Quantity::PY, Quantity::PZ};
+    }
+
+    // Binning and species change the partial result without changing the name.
+    std::string config_id() const override {
+        std::ostringstream id;
+        id.precision(17);
+        id << name << ";y=" << y_min_ << ':' << y_max_ << ':' << y_bins_
+           << ";pt=" << pt_min_ << ':' << pt_max_ << ':' << pt_bins_
+           << ";wounded=" << wounded_min_ << ':' << wounded_max_ << ':' << wounded_bin_width_
+           << ";species=";
+        for (size_t s = 0; s < species_.size(); ++s) id << species_.pdg(s) << ',';
+        return id.str();
+    }
+
+    void on_layout(const Accessor& accessor) override {
+        records_.bind(accessor.get_layout(),
+                      {Quantity::PDG, Quantity::NCOLL, Quantity::P0,
+                       Quantity::PX, Quantity::PY, Quantity::PZ});
+    }
+
+    void analyze_particle_block(const ParticleBlock& block, const Accessor&) override {
+        records_.visit([&](const auto& rec) { analyze_block_(block, rec); });
+    }
+
+    void finalize() override {
+
+        write_binning_metadata_();
+
+  }
+    void save(const std::string&) override {}
+
+private:
+    // Instantiated once per Record in RecordDispatcher, so offsets and stride
+    // are compile-time constants for the common layouts.
+    template <typename Rec>
+    void analyze_block_(const ParticleBlock& block, const Rec& rec) {
         int wounded = 0;
-        for (size_t i = 0; i < block.npart; ++i) {
-            int pdg = accessor.get_int("pdg", block, i);
-            int ncoll = accessor.get_int("ncoll", block, i);
+        for_each_record(block, rec, [&](const char* p) {
+            int pdg = rec.template get<Quantity::PDG>(p);
+            int ncoll = rec.template get<Quantity::NCOLL>(p);
             if ((pdg == 2212 || pdg == 2112) && ncoll > 0) ++wounded;
-        }
+        });
         if (wounded <= 0) return;
 
-        DataNode& group = group_for_wounded_(wounded);
+        GroupHandles& group = group_for_wounded_(wounded);
 
-        for (size_t i = 0; i < block.npart; ++i) {
-            int pdg = accessor.get_int("pdg", block, i);
-            if (!selected_pdgs_.count(pdg)) continue;
+        for_each_record(block, rec, [&](const char* p) {
+            const int species = species_.index(rec.template get<Quantity::PDG>(p));
+            if (species < 0) return;
 
-            double E  = accessor.get_double("p0", block, i);
-            double pz = accessor.get_double("pz", block, i);
-            double px = accessor.get_double("px", block, i);
-            double py = accessor.get_double("py", block, i);
+            double E  = rec.template get<Quantity::P0>(p);
+            double pz = rec.template get<Quantity::PZ>(p);
+            double px = rec.template get<Quantity::PX>(p);
+            double py = rec.template get<Quantity::PY>(p);
             double y = 0.5 * std::log((E + pz) / (E - pz));
             if (std::isfinite(E) && std::isfinite(pz) && E > std::abs(pz)) {
                 if (std::isfinite(y) && y >= y_min_ && y < y_max_) {
-                    auto& ydata = get_or_make_histogram_(group, "rapidity_pdg_" + std::to_string(pdg), y_hist_);
-                    std::get<Histogram1D>(ydata).fill(y);
+                    pending_[species].y.push_back(y);
                 }
             }
 
             if (std::isfinite(px) && std::isfinite(py)) {
                 double pt = std::hypot(px, py);
                 if (std::isfinite(pt) && pt >= pt_min_ && pt < pt_max_ && std::abs(y) < 0.5) {
-            
-                    auto& ptdata = get_or_make_histogram_(group, "p_perp_pdg_" + std::to_string(pdg), pt_hist_);
-                    std::get<Histogram1D>(ptdata).fill(pt);
+                    pending_[species].pt.push_back(pt);
                 }
             }
+        });
+
+        // One batch fill per histogram and block; the buffers keep their
+        // capacity. A histogram is created on its first entry in the group.
+        for (size_t s = 0; s < pending_.size(); ++s) {
+            PendingValues& values = pending_[s];
+            if (!values.y.empty()) {
+                if (!group.y[s]) {
+                    group.y[s] = group.node->handle("rapidity_pdg_" + std::to_string(species_.pdg(s)), y_hist_);
+                }
+                group.y[s]->fill(values.y);
+                values.y.clear();
+            }
+            if (!values.pt.empty()) {
+                if (!group.pt[s]) {
+                    group.pt[s] = group.node->handle("p_perp_pdg_" + std::to_string(species_.pdg(s)), pt_hist_);
+                }
+                group.pt[s]->fill(values.pt);
+                values.pt.clear();
+            }
         }
 
-        DataNode& ev_node = group.add_child("n_events");
-        Data& ev_data = ev_node.get_data();
-        if (!std::holds_alternative<int>(ev_data)) ev_data = 0;
-        std::get<int>(ev_data) += 1;
+        *group.n_events += 1;
     }
 
-    void finalize() override {
-
-        write_binning_metadata_();
-
-  }
-    void save(const std::string&) override {}
-
-private:
     void write_binning_metadata_() {
         DataNode& meta = dataNode.add_child("meta").add_child("histogram_binning");
 
@@ -116,16 +163,23 @@ private:
         return "w" + zpad3_(start) + "-" + zpad3_(end);
     }
 
-    DataNode& group_for_wounded_(int wounded) {
-        auto [start, end] = bin_bounds_(wounded);
-        return wounded_node_.add_child(wounded_range_label_(start, end));
-    }
+    // Resolved on the first block of the wounded bin, then reused.
+    struct GroupHandles {
+        DataNode* node = nullptr;
+        DataHandle<int> n_events;
+        std::vector<DataHandle<Histogram1D>> y, pt;  // by species index
+    };
 
-    Data& get_or_make_histogram_(DataNode& group, const std::string& key, const Histogram1D& ref) {
-        DataNode& node = group.add_child(key);
-        Data& d = node.get_data();
-        if (!std::holds_alternative<Histogram1D>(d)) d = ref;
-        return d;
+    GroupHandles& group_for_wounded_(int wounded) {
+        auto [start, end] = bin_bounds_(wounded);
+        GroupHandles& group = groups_[(start - wounded_min_) / wounded_bin_width_];
+        if (!group.node) {
+            group.node = &wounded_node_.add_child(wounded_range_label_(start, end));
+            group.n_events = group.node->handle("n_events", 0);
+            group.y.resize(species_.size());
+            group.pt.resize(species_.size());
+        }
+        return group;
     }
 
 private:
@@ -138,8 +192,24 @@ private:
     Histogram1D y_hist_;
     Histogram1D pt_hist_;
 
+    // In-range values of the current block, per species, awaiting a batch fill.
+    struct PendingValues {
+        std::vector<double> y, pt;
+    };
+    std::vector<PendingValues> pending_;
+    std::vector<GroupHandles> groups_;  // by wounded bin
+
     DataNode& wounded_node_;
-    std::unordered_set<int> selected_pdgs_;
+    SpeciesIndex species_;  // selected pdgs
+
+    // Layouts the Rapidity analysis is usually run with, in on-disk order.
+    RecordDispatcher<
+        Record<Quantity::P0, Quantity::PX, Quantity::PY, Quantity::PZ,
+               Quantity::PDG, Quantity::NCOLL>,
+        Record<Quantity::MASS, Quantity::P0, Quantity::PX, Quantity::PY, Quantity::PZ,
+               Quantity::PDG, Quantity::NCOLL, Quantity::CHARGE>,
+        SmashExtendedRecord
+    > records_;
 };
 
 REGISTER_ANALYSIS("Rapidity", RapidityAndPtHistogramAnalysis);
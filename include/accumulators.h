@@ -0,0 +1,212 @@
+// Accumulators.h
+#ifndef ACCUMULATORS_H
+#define ACCUMULATORS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "yamlwriter.h"
+
+// Fixed-size summaries of a stream of values that merge like histograms
+// (`a += b`), for results that would otherwise keep every value in a
+// std::vector<double>. All of them are Data alternatives, so they can sit in
+// a DataNode tree, be merged across files and threads, and round-trip
+// through partial results. Merging is deterministic: the same values merged
+// in the same order give the same bits.
+
+// Count, mean and variance by Welford's update; merged with Chan et al.'s
+// pairwise formula.
+class RunningMoments {
+public:
+    RunningMoments() = default;
+    RunningMoments(uint64_t count, double mean, double m2)
+        : count_(count), mean_(mean), m2_(m2) {}
+
+    void add(double x) {
+        ++count_;
+        const double delta = x - mean_;
+        mean_ += delta / static_cast<double>(count_);
+        m2_ += delta * (x - mean_);
+    }
+
+    RunningMoments& operator+=(const RunningMoments& other) {
+        if (other.count_ == 0) return *this;
+        if (count_ == 0) return *this = other;
+        const double na = static_cast<double>(count_);
+        const double nb = static_cast<double>(other.count_);
+        const double n = na + nb;
+        const double delta = other.mean_ - mean_;
+        mean_ += delta * nb / n;
+        m2_ += other.m2_ + delta * delta * na * nb / n;
+        count_ += other.count_;
+        return *this;
+    }
+
+    uint64_t count() const { return count_; }
+    // NaN without values.
+    double mean() const { return count_ ? mean_ : std::numeric_limits<double>::quiet_NaN(); }
+    // Sample variance (n - 1); NaN for fewer than two values.
+    double variance() const {
+        return count_ > 1 ? m2_ / static_cast<double>(count_ - 1)
+                          : std::numeric_limits<double>::quiet_NaN();
+    }
+    double stddev() const { return std::sqrt(variance()); }
+    double m2() const { return m2_; }
+
+private:
+    uint64_t count_ = 0;
+    double mean_ = 0.0;
+    double m2_ = 0.0;  // sum of squared deviations from the mean
+};
+
+// Smallest and largest value seen (+inf / -inf without values).
+class MinMax {
+public:
+    MinMax() = default;
+    MinMax(uint64_t count, double min, double max) : count_(count), min_(min), max_(max) {}
+
+    void add(double x) {
+        ++count_;
+        min_ = std::min(min_, x);
+        max_ = std::max(max_, x);
+    }
+
+    MinMax& operator+=(const MinMax& other) {
+        count_ += other.count_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        return *this;
+    }
+
+    uint64_t count() const { return count_; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+
+private:
+    uint64_t count_ = 0;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+};
+
+// Count and sum with Neumaier's variant of Kahan compensation, so sums of
+// many small terms (or of partial sums of very different size) keep their
+// low bits.
+class KahanSum {
+public:
+    KahanSum() = default;
+    KahanSum(uint64_t count, double sum, double compensation)
+        : count_(count), sum_(sum), compensation_(compensation) {}
+
+    void add(double x) {
+        ++count_;
+        add_term(x);
+    }
+
+    KahanSum& operator+=(const KahanSum& other) {
+        count_ += other.count_;
+        add_term(other.sum_);
+        add_term(other.compensation_);
+        return *this;
+    }
+
+    uint64_t count() const { return count_; }
+    double sum() const { return sum_ + compensation_; }
+    // NaN without values.
+    double mean() const {
+        return count_ ? sum() / static_cast<double>(count_) : std::numeric_limits<double>::quiet_NaN();
+    }
+    double raw_sum() const { return sum_; }
+    double compensation() const { return compensation_; }
+
+private:
+    void add_term(double x) {
+        const double t = sum_ + x;
+        if (std::fabs(sum_) >= std::fabs(x)) {
+            compensation_ += (sum_ - t) + x;
+        } else {
+            compensation_ += (x - t) + sum_;
+        }
+        sum_ = t;
+    }
+
+    uint64_t count_ = 0;
+    double sum_ = 0.0;
+    double compensation_ = 0.0;  // low-order bits lost from sum_
+};
+
+// Quantiles of a weighted stream from a merging t-digest (Dunning): values
+// are kept as centroids (mean, weight), small near the tails and large in
+// the middle, under the k1 scale function. About compression / 2 centroids
+// plus a buffer of up to 5 * compression recent values are held, however
+// many values are added. With the default, |F(quantile(q)) - q| stays below
+// 5e-4 at the YAML levels for 10^6 values merged from 50 sketches
+// (tests/test_accumulators.cc); the error falls roughly as 1 / compression.
+class QuantileSketch {
+public:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    explicit QuantileSketch(double compression = 200.0);
+
+    // Restores a sketch from its stored state (see centroids(), buffer()).
+    QuantileSketch(double compression, double total_weight, double min, double max,
+                   std::vector<Centroid> centroids, std::vector<Centroid> buffer);
+
+    void add(double x, double weight = 1.0) {
+        if (!(weight > 0.0) || std::isnan(x)) return;
+        buffer_.push_back({x, weight});
+        total_weight_ += weight;
+        min_ = std::min(min_, x);
+        max_ = std::max(max_, x);
+        if (buffer_.size() >= buffer_limit()) compress();
+    }
+
+    // Merges other's centroids and buffer into this sketch, keeping this
+    // sketch's compression.
+    QuantileSketch& operator+=(const QuantileSketch& other);
+
+    // Value below which a fraction `q` of the weight lies, interpolated
+    // between centroids; min() and max() at the ends. NaN when empty.
+    double quantile(double q) const;
+
+    double compression() const { return compression_; }
+    double total_weight() const { return total_weight_; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+    const std::vector<Centroid>& centroids() const { return centroids_; }
+    const std::vector<Centroid>& buffer() const { return buffer_; }
+
+    // Folds the buffer into the centroids.
+    void compress();
+
+private:
+    size_t buffer_limit() const { return static_cast<size_t>(5 * compression_) + 16; }
+
+    double compression_;
+    double total_weight_ = 0.0;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+    std::vector<Centroid> centroids_;  // sorted by mean
+    std::vector<Centroid> buffer_;     // not yet merged, in insertion order
+};
+
+// Quantile levels written for a QuantileSketch.
+inline constexpr double sketch_yaml_levels[] = {0.01, 0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99};
+
+void to_yaml(YAML::Emitter& out, const RunningMoments& m);
+void to_yaml(YAML::Emitter& out, const MinMax& m);
+void to_yaml(YAML::Emitter& out, const KahanSum& s);
+void to_yaml(YAML::Emitter& out, const QuantileSketch& s);
+void to_yaml(YamlWriter& out, const RunningMoments& m);
+void to_yaml(YamlWriter& out, const MinMax& m);
+void to_yaml(YamlWriter& out, const KahanSum& s);
+void to_yaml(YamlWriter& out, const QuantileSketch& s);
+
+#endif // ACCUMULATORS_H
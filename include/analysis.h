@@ -12,7 +12,9 @@
 #include <yaml-cpp/yaml.h>
 
 #include "binaryreader.h"
+#include "columnblock.h"
 #include "histogram1d.h"
+#include "particlefilter.h"
 #include "datatree.h"
 // ---------- Merge keys (vector of name/value pairs) ----------
 using MergeKeyValue = std::variant<int, double, std::string>;
@@ -52,6 +54,7 @@ inline bool operator==(MergeKeySet const& A, MergeKeySet const& B) {
 }
 
 void to_yaml(YAML::Emitter& out, const MergeKeyValue& v);
+void to_yaml(YamlWriter& out, const MergeKeyValue& v);
 
 // Helpers (you can also keep these in utils.h if you prefer)
 MergeKeySet parse_merge_key(const std::string& meta);
@@ -61,18 +64,44 @@ std::string label_from_keyset(const MergeKeySet& ks);
 
 // ---------- Analysis base ----------
 class Analysis {
+public:
+    // Where the result tree lives. With Arena, its nodes, names and histogram
+    // counts come from a DataArena owned by this instance: close together,
+    // and released at once when the instance goes. Merges between instances
+    // copy rather than splice, since each has its own arena, so analyses
+    // merged per file (all of run_analysis) are better off on the heap.
+    enum class TreeAllocation { Heap, Arena };
+
+private:
+    std::unique_ptr<DataArena> arena;  // declared before dataNode: outlives it
+
 protected:
     MergeKeySet keys;
     std::string smash_version;
+    std::string name;  // registered name, set by AnalysisRegistry::create
     DataNode dataNode;
 
 public:
+    explicit Analysis(TreeAllocation allocation = TreeAllocation::Heap);
     virtual ~Analysis() = default;
     Analysis& operator+=(const Analysis& other);
+    // Same, moving other's results instead of copying them.
+    Analysis& operator+=(Analysis&& other);
+    // *this += *others[0], *others[1], ... (moved from); see merge_trees.
+    void merge_from(const std::vector<Analysis*>& others, int n_threads);
 
     void set_merge_keys(MergeKeySet k);
     const MergeKeySet& get_merge_keys() const;
 
+    void set_name(std::string n) { name = std::move(n); }
+    const std::string& get_name() const { return name; }
+
+    // Identifies the settings this analysis runs with (binning, cuts, ...).
+    // Part of every result cache key and checkpoint, so changing it
+    // invalidates stored partials. Override it when the settings can change
+    // without the name changing.
+    virtual std::string config_id() const { return name; }
+
     void on_header(Header& header);
     void save_as_yaml(const std::string& filename) const;
 
@@ -82,7 +111,28 @@ public:
 
     const std::string& get_smash_version() const { return smash_version; }
 
-    virtual void analyze_particle_block(const ParticleBlock& block, const Accessor& accessor) = 0;
+    // Merges a stored partial result (e.g. from ResultCache) into this
+    // analysis, which takes the place of one analysed file.
+    void restore(const std::string& smash_version_in, const DataNode& data);
+
+    // Called after on_header, once the layout of the file is known. Resolve
+    // QuantityHandles here instead of looking quantities up by name per particle.
+    virtual void on_layout(const Accessor& /*accessor*/) {}
+
+    // Row-oriented analyses implement analyze_particle_block. Columnar ones
+    // instead list the quantities they read in columns() and implement
+    // analyze_columns; DispatchingAccessor decodes the union of all
+    // registered analyses' columns once per block and shares it.
+    virtual void analyze_particle_block(const ParticleBlock& /*block*/, const Accessor& /*accessor*/) {}
+    virtual std::vector<Quantity> columns() const { return {}; }
+
+    // Quantities the analysis reads, checked against the file layout before
+    // the first block. Defaults to columns().
+    virtual std::vector<Quantity> required_quantities() const { return columns(); }
+    virtual void analyze_columns(const ColumnBlock& /*columns*/) {}
+
+    // Interactions of collision-history output, in file order.
+    virtual void analyze_interaction_block(const InteractionBlock& /*block*/, const Accessor& /*accessor*/) {}
     virtual void finalize() = 0;
     virtual void save(const std::string& save_dir_path) = 0;
     virtual void print_result_to(std::ostream& os) const {}
@@ -94,10 +144,17 @@ public:
     void register_analysis(std::shared_ptr<Analysis> analysis);
     void on_particle_block(const ParticleBlock& block) override;
     void on_end_block(const EndBlock& block) override;
+    void on_interaction_block(const InteractionBlock& block) override;
     void on_header(Header& header) override;
 
+    // Union of required_quantities() over all registered analyses.
+    std::vector<Quantity> required_quantities() const;
+
 private:
     std::vector<std::shared_ptr<Analysis>> analyses;
+    std::vector<char> columnar;           // per analysis: uses analyze_columns
+    std::vector<Quantity> column_union;   // decoded once per block
+    ColumnBlock column_block;
 }; 
 
 // ---------- Result entry + run ----------
@@ -106,15 +163,91 @@ struct Entry {
     std::shared_ptr<Analysis> analysis;
 };
 
-// Write one YAML with all entries (deterministic order)
+// One element of the "results" sequence of save_all_to_yaml.
+void to_yaml(YamlWriter& out, const Entry& e);
+
+// Write one YAML with all entries (deterministic order), streamed to the
+// file through a YamlWriter.
 void save_all_to_yaml(const std::string& filename,
                       const std::vector<Entry>& results);
 
+// Where and how often run_analysis saves its progress (see Checkpoint).
+struct CheckpointOptions {
+    std::string path;        // empty: no checkpoints
+    double interval = 60.0;  // minimum seconds between checkpoints
+    bool resume = false;     // continue from `path` if it exists
+};
+
+// What is saved per analysis: the finalized <analysis>.yaml, the mergeable
+// <analysis>.bark (see PartialResult), or both.
+enum class OutputFormat { Yaml, Binary, Both };
+
+// "yaml", "binary" or "both".
+OutputFormat parse_output_format(const std::string& name);
+
+// One task of a job array (--shard i/N): a deterministic slice of the inputs.
+// By files, shard i gets the i-th of N contiguous runs of input files; by
+// events, the i-th of N event ranges of similar particle count in every file
+// (needs event indices, so SMASH binary files only). Sharded runs save a
+// mergeable <analysis>.shard-<i>-of-<N>.bark that records the shard.
+struct ShardSpec {
+    enum class Mode { Files, Events };
+
+    uint32_t index = 0;
+    uint32_t count = 1;  // 1: not sharded
+    Mode mode = Mode::Files;
+
+    bool is_sharded() const { return count > 1; }
+};
+
+// "i/N" with 0 <= i < N.
+ShardSpec parse_shard(const std::string& spec);
+
+// Runs every analysis in `analysis_names` over each file in a single read and
+// writes one <analysis>.yaml per analysis. An empty `quantities` infers each
+// file's record layout from its header (see smash_quantities).
+void run_analysis(const std::vector<std::pair<std::string, std::string>>& file_and_meta,
+                  const std::vector<std::string>& analysis_names,
+                  const std::vector<std::string>& quantities,
+                  bool save_output = true,
+                  bool print_output = true,
+                  const std::string& output_folder = ".",
+                  ReadMode read_mode = ReadMode::Stream,
+                  int n_threads = 1,
+                  int block_workers = 1,
+                  EventRange events = {},
+                  const ParticleFilter& filter = {},
+                  const std::string& cache_dir = "",
+                  const CheckpointOptions& checkpoint = {},
+                  OutputFormat format = OutputFormat::Yaml,
+                  const ShardSpec& shard = {});
+
 void run_analysis(const std::vector<std::pair<std::string, std::string>>& file_and_meta,
                   const std::string& analysis_name,
                   const std::vector<std::string>& quantities,
                   bool save_output = true,
                   bool print_output = true,
-                  const std::string& output_folder = ".");
+                  const std::string& output_folder = ".",
+                  ReadMode read_mode = ReadMode::Stream,
+                  int n_threads = 1,      // files in flight; <= 0: one per hardware thread
+                  int block_workers = 1,  // > 1: split each file's blocks over this many workers
+                  EventRange events = {},  // uses/creates <file>.idx when not all events
+                  const ParticleFilter& filter = {}, // applied by the reader before analyses
+                  const std::string& cache_dir = "", // per-file partial results; empty: off
+                  const CheckpointOptions& checkpoint = {},
+                  OutputFormat format = OutputFormat::Yaml,
+                  const ShardSpec& shard = {});
+
+// Reduces partial results (<analysis>.bark files, from run_analysis or
+// earlier merges) by merge key and writes one output per analysis. Files are
+// loaded on `n_threads` threads (<= 0: all cores) and merged in input order;
+// shards of a sharded run are merged in shard order. A shard given twice is
+// an error, and so is a missing one unless only partials are written.
+void merge_results(const std::vector<std::string>& inputs,
+                   bool save_output = true,
+                   bool print_output = true,
+                   const std::string& output_folder = ".",
+                   int n_threads = 1,
+                   OutputFormat format = OutputFormat::Yaml);
 
 #endif // ANALYSIS_H
@@ -0,0 +1,97 @@
+// BinaryIO.h
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Reading and writing of the fields shared by bark's own binary formats
+// (DataNode trees, partial results, checkpoints, the result cache, event
+// indices, columnar files). Values are stored in native byte order; strings
+// and vectors as a length followed by the elements. Readers throw
+// std::runtime_error on a short read. Internal to the library.
+namespace binaryio {
+
+template <typename T>
+void put(std::ostream& out, const T& v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <typename T>
+T get(std::istream& in) {
+    T v{};
+    in.read(reinterpret_cast<char*>(&v), sizeof(v));
+    if (!in) throw std::runtime_error("Truncated binary data");
+    return v;
+}
+
+// u32 length, bytes.
+inline void put_string(std::ostream& out, std::string_view s) {
+    put(out, static_cast<uint32_t>(s.size()));
+    out.write(s.data(), static_cast<std::streamsize>(s.size()));
+}
+
+inline std::string get_string(std::istream& in) {
+    const auto len = get<uint32_t>(in);
+    std::string s;
+    // Grow in steps, as get_vector does.
+    constexpr uint32_t step = 1 << 16;
+    for (uint32_t done = 0; done < len; ) {
+        const uint32_t k = std::min(step, len - done);
+        s.resize(done + k);
+        in.read(s.data() + done, k);
+        if (!in) throw std::runtime_error("Truncated binary data");
+        done += k;
+    }
+    return s;
+}
+
+// u64 length, elements (trivially copyable).
+template <typename Vector>
+void put_vector(std::ostream& out, const Vector& v) {
+    put(out, static_cast<uint64_t>(v.size()));
+    out.write(reinterpret_cast<const char*>(v.data()),
+              static_cast<std::streamsize>(v.size() * sizeof(v[0])));
+}
+
+template <typename T>
+std::vector<T> get_vector(std::istream& in) {
+    const auto n = get<uint64_t>(in);
+    std::vector<T> v;
+    // Grow in steps so a corrupt length can't trigger a huge allocation.
+    constexpr uint64_t step = 1 << 16;
+    for (uint64_t done = 0; done < n; ) {
+        const uint64_t k = std::min(step, n - done);
+        v.resize(done + k);
+        in.read(reinterpret_cast<char*>(v.data() + done), static_cast<std::streamsize>(k * sizeof(T)));
+        if (!in) throw std::runtime_error("Truncated binary data");
+        done += k;
+    }
+    return v;
+}
+
+// A temporary name next to `path`, unique per process and call.
+std::string unique_temp_path(const std::string& path);
+
+// Writes `path` by calling write(tmp) for a temporary file next to it and
+// renaming that over `path`. Readers only ever see the old or the complete
+// new file, and a job killed mid-write leaves the old one in place. The
+// temporary name is unique per process and call, so concurrent jobs and
+// threads writing the same path (a shared cache, index or checkpoint) never
+// write into one another's file. If `write` throws or the rename fails the
+// temporary is removed and the error propagates.
+void replace_file(const std::string& path, const std::function<void(const std::string&)>& write);
+
+// replace_file through a binary stream; throws if anything failed to write.
+void write_binary_file(const std::string& path, const std::function<void(std::ostream&)>& write);
+
+} // namespace binaryio
+
+#endif // BINARY_IO_H
@@ -12,12 +12,20 @@
 #include <cstring>
 #include <algorithm>
 #include <unordered_map>
+#include <limits>
 #include <memory>
+#include <span>
+
+#include "mappedfile.h"
+#include "readahead.h"
 
 // Enum classes and helper structures
 enum class Quantity {
     MASS, P0, PX, PY, PZ,
-    PDG, NCOLL, CHARGE
+    PDG, NCOLL, CHARGE,
+    T, X, Y, Z, ID,
+    FORM_TIME, XSECFAC, PROC_ID_ORIGIN, PROC_TYPE_ORIGIN, TIME_LAST_COLL,
+    PDG_MOTHER1, PDG_MOTHER2, BARYON_NUMBER, STRANGENESS
 };
 
 enum class QuantityType {
@@ -25,6 +33,33 @@ enum class QuantityType {
     Int32
 };
 
+// Number of Quantity enumerators; keep in sync with the enum.
+inline constexpr size_t quantity_count = static_cast<size_t>(Quantity::STRANGENESS) + 1;
+
+enum class ReadMode {
+    Stream,  // buffered std::ifstream, one copy per block
+    Mmap,    // blocks point straight into a read-only mapping of the file
+    ReadAhead // a background thread reads large buffers ahead of the parser
+};
+
+ReadMode parse_read_mode(const std::string& name);
+
+// Half-open range [first, last) of event numbers.
+struct EventRange {
+    int32_t first = 0;
+    int32_t last = std::numeric_limits<int32_t>::max();
+
+    bool contains(int64_t event) const { return event >= first && event < last; }
+    bool is_all() const { return first <= 0 && last == std::numeric_limits<int32_t>::max(); }
+};
+
+// "a:b", "a:" or ":b"
+EventRange parse_event_range(const std::string& spec);
+
+class EventIndex;
+class ColumnarFile;
+struct ParticleFilter;
+
 struct QuantityInfo {
     Quantity quantity;
     QuantityType type;
@@ -34,10 +69,24 @@ size_t type_size(QuantityType t);
 
 extern const std::unordered_map<std::string, QuantityInfo> quantity_string_map;
 
+// Reverse lookups of quantity_string_map.
+const std::string& quantity_name(Quantity q);
+QuantityType quantity_type(Quantity q);
+
 std::unordered_map<Quantity, size_t>
 compute_quantity_layout(const std::vector<std::string>& names);
+size_t compute_particle_size(const std::vector<std::string>& names);
+
+// SMASH binary format variants (Header::format_variant).
+enum class FormatVariant : uint16_t {
+    Default  = 0, // t x y z mass p0 px py pz pdg id charge
+    Extended = 1  // Default followed by ncoll, form_time, xsecfac,
+                  // proc_id_origin, proc_type_origin, time_last_coll,
+                  // pdg_mother1, pdg_mother2, baryon_number, strangeness
+};
 
 std::vector<char> read_chunk(std::ifstream& bfile, size_t size);
+const char* take_bytes(const char*& cursor, const char* end, size_t size);
 
 // Template helpers
 
@@ -49,10 +98,18 @@ T extract_and_advance(const std::vector<char>& buffer, size_t& offset) {
     return value;
 }
 
+template <typename T>
+T extract_and_advance(const char*& ptr) {
+    T value;
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return value;
+}
+
+// Looks up `name` in the layout and checks that it is stored as T.
 template<typename T>
-T get_quantity(const std::vector<char>& particle,
-               const std::string& name,
-               const std::unordered_map<Quantity, size_t>& layout)
+size_t quantity_offset(const std::string& name,
+                       const std::unordered_map<Quantity, size_t>& layout)
 {
     auto it_info = quantity_string_map.find(name);
     if (it_info == quantity_string_map.end())
@@ -67,9 +124,16 @@ T get_quantity(const std::vector<char>& particle,
     auto it = layout.find(q);
     if (it == layout.end())
         throw std::runtime_error("Quantity not in layout: " + name);
+    return it->second;
+}
 
+template<typename T>
+T get_quantity(const char* particle,
+               const std::string& name,
+               const std::unordered_map<Quantity, size_t>& layout)
+{
     T value;
-    std::memcpy(&value, particle.data() + it->second, sizeof(T));
+    std::memcpy(&value, particle + quantity_offset<T>(name, layout), sizeof(T));
     return value;
 }
 
@@ -80,10 +144,23 @@ struct Header {
     uint16_t format_variant = 0;
     std::string smash_version;
 
+    // magic number, format version, format variant, version string length
+    static constexpr size_t FIXED_SIZE = 4 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t);
+
     void read(std::ifstream& bfile);
+    void read(const char*& cursor, const char* end);
+    // Decodes the fixed part and returns the length of the version string that follows.
+    uint32_t read_fixed(const char* fixed);
     void print() const;
 };
 
+// On-disk quantity list of a particle record for the header's format variant.
+// Throws for variants whose layout can't be inferred.
+const std::vector<std::string>& smash_quantities(const Header& header);
+
+// Reads only the header of a binary file.
+Header read_file_header(const std::string& filename);
+
 struct EndBlock {
     uint32_t event_number;
     uint32_t ensamble_number;
@@ -92,15 +169,172 @@ struct EndBlock {
 
     static constexpr size_t SIZE = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(double) + sizeof(char);
     void read(std::ifstream& bfile);
+    void read(const char*& cursor, const char* end);
+};
+
+// Non-owning view of one packed particle record.
+class ParticleView {
+public:
+    ParticleView() = default;
+    explicit ParticleView(const char* record) : record_(record) {}
+
+    const char* data() const { return record_; }
+
+    template <typename T>
+    T get(size_t offset) const {
+        T value;
+        std::memcpy(&value, record_ + offset, sizeof(T));
+        return value;
+    }
+
+private:
+    const char* record_ = nullptr;
+};
+
+// Strided iterator over the records of a ParticleBlock.
+class ParticleIterator {
+public:
+    using value_type = ParticleView;
+    using difference_type = std::ptrdiff_t;
+
+    ParticleIterator() = default;
+    ParticleIterator(const char* pos, size_t stride) : pos_(pos), stride_(stride) {}
+
+    ParticleView operator*() const { return ParticleView(pos_); }
+    ParticleIterator& operator++() { pos_ += stride_; return *this; }
+    ParticleIterator operator++(int) { ParticleIterator old = *this; pos_ += stride_; return old; }
+
+    bool operator==(const ParticleIterator& other) const { return pos_ == other.pos_; }
+    bool operator!=(const ParticleIterator& other) const { return pos_ != other.pos_; }
+
+private:
+    const char* pos_ = nullptr;
+    size_t stride_ = 0;
 };
 
 struct ParticleBlock {
-    int32_t event_number;
-    int32_t ensamble_number;
-    uint32_t npart;
-    std::vector<std::vector<char>> particles;
+    int32_t event_number = 0;
+    int32_t ensamble_number = 0;
+    uint32_t npart = 0;
+    size_t particle_size = 0;
+    // npart packed records of particle_size bytes each. Points into `storage`
+    // when read from a stream, or straight into the reader's memory otherwise.
+    const char* data = nullptr;
+
+    // event number, ensemble number, npart
+    static constexpr size_t HEADER_SIZE = sizeof(int32_t) + sizeof(int32_t) + sizeof(uint32_t);
+
+    ParticleBlock() = default;
+    ParticleBlock(const ParticleBlock& other);             // copies always own their records
+    ParticleBlock& operator=(const ParticleBlock& other);
+    ParticleBlock(ParticleBlock&&) = default;
+    ParticleBlock& operator=(ParticleBlock&&) = default;
+
+    const char* particle(size_t i) const { return data + i * particle_size; }
+    ParticleView operator[](size_t i) const { return ParticleView(particle(i)); }
+    size_t size() const { return npart; }
+
+    ParticleIterator begin() const { return ParticleIterator(data, particle_size); }
+    ParticleIterator end() const { return ParticleIterator(data + npart * particle_size, particle_size); }
 
+    // All records as one contiguous byte range (stride = particle_size).
+    std::span<const char> records() const { return {data, npart * particle_size}; }
+
+    // False when the records live in reader memory rather than in this block.
+    bool owns_records() const { return data == storage.data(); }
+    // True when the records live in a file mapping that outlives the callback.
+    bool persistent_records() const { return persistent; }
+
+    // Keeps `other` beyond a reader callback. Records in a file mapping are
+    // referenced; anything else (the reader's reusable buffers) is copied into
+    // this block's storage, reusing its capacity.
+    void retain(const ParticleBlock& other);
+
+    // Reuses `storage` across calls, so a long-lived block allocates only when
+    // an event is larger than every previous one.
+    void read(std::ifstream& bfile, size_t particle_size);
+
+    // Zero-copy: decode the block header from memory and point at records
+    // owned by the reader.
+    void read_header(const char* header);
+    void set_records(const char* records, size_t particle_size, bool persistent);
+
+private:
+    std::vector<char> storage;
+    bool persistent = false;
+};
+
+// Contiguous run of packed particle records, e.g. the incoming particles of
+// an interaction.
+class ParticleRange {
+public:
+    ParticleRange() = default;
+    ParticleRange(const char* data, size_t count, size_t particle_size)
+        : data_(data), count_(count), particle_size_(particle_size) {}
+
+    const char* particle(size_t i) const { return data_ + i * particle_size_; }
+    ParticleView operator[](size_t i) const { return ParticleView(particle(i)); }
+    size_t size() const { return count_; }
+
+    ParticleIterator begin() const { return ParticleIterator(data_, particle_size_); }
+    ParticleIterator end() const { return ParticleIterator(data_ + count_ * particle_size_, particle_size_); }
+
+    std::span<const char> records() const { return {data_, count_ * particle_size_}; }
+
+private:
+    const char* data_ = nullptr;
+    size_t count_ = 0;
+    size_t particle_size_ = 0;
+};
+
+// One interaction ('i' block) of collision-history output: n_in incoming
+// followed by n_out outgoing particle records. Records are held like in
+// ParticleBlock: reused storage for streams, reader memory otherwise.
+struct InteractionBlock {
+    uint32_t n_in = 0;
+    uint32_t n_out = 0;
+    double density = 0.0;         // density at the interaction point
+    double total_weight = 0.0;    // total cross section [mb]
+    double partial_weight = 0.0;  // partial cross section of this process [mb]
+    uint32_t process_type = 0;
+    size_t particle_size = 0;
+    const char* data = nullptr;
+
+    // n_in, n_out, density, total weight, partial weight, process type
+    static constexpr size_t HEADER_SIZE = sizeof(uint32_t) + sizeof(uint32_t) +
+                                          3 * sizeof(double) + sizeof(uint32_t);
+
+    InteractionBlock() = default;
+    InteractionBlock(const InteractionBlock& other);        // copies always own their records
+    InteractionBlock& operator=(const InteractionBlock& other);
+    InteractionBlock(InteractionBlock&&) = default;
+    InteractionBlock& operator=(InteractionBlock&&) = default;
+
+    size_t size() const { return static_cast<size_t>(n_in) + n_out; }
+    ParticleRange incoming() const { return {data, n_in, particle_size}; }
+    ParticleRange outgoing() const { return {data + n_in * particle_size, n_out, particle_size}; }
+
+    // Same semantics as ParticleBlock::retain.
+    void retain(const InteractionBlock& other);
+
+    // Reuses `storage` across calls.
     void read(std::ifstream& bfile, size_t particle_size);
+    void read_header(const char* header);
+    void set_records(const char* records, size_t particle_size, bool persistent);
+
+private:
+    std::vector<char> storage;
+    bool persistent = false;
+};
+
+// A quantity resolved once against the active layout (see Accessor::resolve).
+// Reading it is a fixed-offset load with no name lookup or type check.
+template <typename T>
+struct QuantityHandle {
+    size_t offset = 0;
+
+    T operator()(ParticleView particle) const { return particle.get<T>(offset); }
+    T operator()(const ParticleBlock& block, size_t i) const { return block[i].get<T>(offset); }
 };
 
 // Accessor base class
@@ -108,15 +342,27 @@ class Accessor {
 public:
     virtual void on_particle_block(const ParticleBlock& block) {}
     virtual void on_end_block(const EndBlock& block) {}
+    // Collision-history output only. The block is valid during the call.
+    virtual void on_interaction_block(const InteractionBlock& /*block*/) {}
     virtual ~Accessor() = default;
 
     void set_layout(const std::unordered_map<Quantity, size_t>* layout_in);
+    const std::unordered_map<Quantity, size_t>& get_layout() const;
 
     template<typename T>
     T quantity(const std::string& name, const ParticleBlock& block, size_t particle_index) const;
+    template<typename T>
+    T quantity(const std::string& name, ParticleView particle) const;
 
     int32_t get_int(const std::string& name, const ParticleBlock& block, size_t i) const;
     double get_double(const std::string& name, const ParticleBlock& block, size_t i) const;
+    int32_t get_int(const std::string& name, ParticleView particle) const;
+    double get_double(const std::string& name, ParticleView particle) const;
+
+    // Resolve a quantity name into a handle. Valid until the layout changes,
+    // i.e. for the rest of the file being read.
+    template<typename T>
+    QuantityHandle<T> resolve(const std::string& name) const;
     virtual void on_header(Header& header_in){};
 protected:
     const std::unordered_map<Quantity, size_t>* layout = nullptr;
@@ -129,27 +375,74 @@ T Accessor::quantity(const std::string& name, const ParticleBlock& block, size_t
     if (!layout) {
         throw std::runtime_error("Layout not set in Accessor");
     }
-    if (particle_index >= block.particles.size()) {
+    if (particle_index >= block.npart) {
         throw std::out_of_range("Invalid particle index");
     }
-    return get_quantity<T>(block.particles[particle_index], name, *layout);
+    return get_quantity<T>(block.particle(particle_index), name, *layout);
+}
+
+template<typename T>
+T Accessor::quantity(const std::string& name, ParticleView particle) const {
+    if (!layout) {
+        throw std::runtime_error("Layout not set in Accessor");
+    }
+    return get_quantity<T>(particle.data(), name, *layout);
+}
+
+template<typename T>
+QuantityHandle<T> Accessor::resolve(const std::string& name) const {
+    if (!layout) {
+        throw std::runtime_error("Layout not set in Accessor");
+    }
+    return QuantityHandle<T>{quantity_offset<T>(name, *layout)};
 }
 
 // BinaryReader class
 class BinaryReader {
 public:
+    // `selected` lists the on-disk quantities of a particle record. When it
+    // is empty the layout is inferred from the header's format variant.
+    // Columnar caches (see ColumnarFile) are recognised by their magic and
+    // always mapped; there `selected` picks the columns to read (empty: all).
     BinaryReader(const std::string& filename,
                  const std::vector<std::string>& selected,
-                 std::shared_ptr<Accessor> accessor_in);
+                 std::shared_ptr<Accessor> accessor_in,
+                 ReadMode mode = ReadMode::Stream);
     void read();
 
+    // Only dispatch blocks of events in `range`. Events are stored in order,
+    // so reading stops at the first block past the range. With an index the
+    // reader seeks straight to the first block of the range; the index must
+    // outlive read(). Columnar caches skip whole chunks instead and ignore
+    // the index.
+    void set_event_range(EventRange range, const EventIndex* index = nullptr);
+
+    // Drop particles failing `filter` before blocks reach the accessor.
+    // Throws if the filter tests a quantity missing from the layout.
+    void set_filter(const ParticleFilter& filter);
+
+    size_t get_particle_size() const { return particle_size; }
+    bool is_columnar() const { return columnar != nullptr; }
+
 private:
     std::ifstream file;
+    std::unique_ptr<MappedFile> mapped;
     size_t particle_size = 0;
     Header header;
     std::shared_ptr<Accessor> accessor;
     std::unordered_map<Quantity, size_t> layout;
+    EventRange events;
+    const EventIndex* index = nullptr;
+    std::shared_ptr<ParticleFilter> filter;
+
+    std::unique_ptr<ReadAheadFile> readahead;
+    std::shared_ptr<ColumnarFile> columnar;
 
+    void read_stream();
+    void read_columnar();
+    // Framing loop for in-memory sources (mapped file, read-ahead buffers).
+    template <typename Source>
+    void read_blocks(Source& source);
     bool check_next(std::ifstream& bfile);
 };
 
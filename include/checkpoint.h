@@ -0,0 +1,37 @@
+// Checkpoint.h
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+
+// Snapshot of a run: the merged, not yet finalized results of every analysis
+// and the input files that went into them. Files are merged in input order,
+// so the completed files are always a prefix of the run's inputs.
+//
+// Layout (native byte order):
+//   "BKCP" u16 version  str config  u32 n_analyses n x str name
+//   u32 n_completed n x (str path, str meta)
+//   per analysis: entries (see PartialResult)
+// with str = u32 length + bytes.
+struct Checkpoint {
+    static constexpr char MAGIC[4] = {'B', 'K', 'C', 'P'};
+    static constexpr uint16_t VERSION = 1;
+
+    std::string config;  // run settings the results depend on
+    std::vector<std::string> analysis_names;
+    std::vector<std::pair<std::string, std::string>> completed;  // file, meta
+    std::vector<std::vector<Entry>> results;  // per analysis, sorted by key
+
+    // Replaces `path`; a job killed mid-write keeps the previous checkpoint.
+    void save(const std::string& path) const;
+
+    // Recreates the analyses through the registry. Throws if the file is not
+    // a readable checkpoint.
+    static Checkpoint load(const std::string& path);
+};
+
+#endif // CHECKPOINT_H
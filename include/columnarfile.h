@@ -0,0 +1,103 @@
+// ColumnarFile.h
+#ifndef COLUMNAR_FILE_H
+#define COLUMNAR_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "binaryreader.h"
+#include "mappedfile.h"
+
+// bark-native columnar cache of a SMASH binary file (<file>.bkc), written by
+// convert_to_columnar and read directly by BinaryReader.
+//
+// Events are grouped into chunks. Each chunk stores its block table (the
+// particle and end blocks in file order) and one contiguous array per
+// quantity, plus optional per-column min/max. The file is memory-mapped, so
+// only the pages of the columns an analysis reads are ever loaded, and chunks
+// whose statistics can't pass a ParticleFilter are skipped without touching
+// their columns.
+//
+// Layout (native byte order):
+//   "BKCL" u16 version
+//   SMASH header: magic[4] u16 format_version u16 format_variant u32 len version
+//   u8 has_stats  u32 n_columns  n_columns x (u32 len, name)
+//   u64 n_chunks  u64 directory_offset
+//   chunks: block table (n_items x ColumnarItem), then the columns, 8-byte aligned
+//   directory: per chunk u64 items_offset u32 n_items u64 n_particles
+//              i32 first_event i32 last_event, per column u64 offset f64 min f64 max
+struct ColumnarChunk {
+    uint64_t items_offset = 0;
+    uint32_t n_items = 0;
+    uint64_t n_particles = 0;
+    int32_t first_event = 0;
+    int32_t last_event = 0;
+    std::vector<uint64_t> column_offsets;
+    std::vector<double> min;
+    std::vector<double> max;
+};
+
+// One entry of a chunk's block table.
+struct ColumnarItem {
+    char kind;                // 'p' or 'f'
+    int32_t event_number;
+    int32_t ensamble_number;
+    uint32_t npart;           // particle blocks only
+    double impact_parameter;  // end blocks only
+    char empty;               // end blocks only: EndBlock::empty
+
+    // kind, event, ensemble, npart, impact parameter, empty
+    static constexpr size_t SIZE = 1 + sizeof(int32_t) + sizeof(int32_t) +
+                                   sizeof(uint32_t) + sizeof(double) + 1;
+    static ColumnarItem read(const char* p);
+};
+
+class ColumnarFile {
+public:
+    static constexpr char MAGIC[4] = {'B', 'K', 'C', 'L'};
+    static constexpr uint16_t VERSION = 2;
+
+    // True if `filename` starts with the columnar magic.
+    static bool is_columnar(const std::string& filename);
+
+    explicit ColumnarFile(const std::string& filename);
+
+    const Header& header() const { return header_; }
+    const std::vector<std::string>& column_names() const { return names_; }
+    const std::vector<ColumnarChunk>& chunks() const { return chunks_; }
+    bool has_stats() const { return has_stats_; }
+
+    // Index into column_names(), or -1 if the quantity isn't stored.
+    int column_index(Quantity q) const;
+
+    const char* items(const ColumnarChunk& chunk) const { return map_.data() + chunk.items_offset; }
+    const char* column(const ColumnarChunk& chunk, size_t col) const {
+        return map_.data() + chunk.column_offsets[col];
+    }
+
+private:
+    MappedFile map_;
+    Header header_;
+    bool has_stats_ = false;
+    std::vector<std::string> names_;
+    std::vector<Quantity> quantities_;
+    std::vector<ColumnarChunk> chunks_;
+};
+
+struct ConvertOptions {
+    uint32_t chunk_events = 64;  // events per chunk
+    bool stats = true;           // store per-chunk column min/max
+};
+
+// <file>.bin -> <file>.bkc
+std::string columnar_path(const std::string& filename);
+
+// Rewrites a SMASH binary file as a columnar cache. `quantities` is the
+// on-disk record layout (empty: inferred from the header). Interaction blocks
+// are not supported.
+void convert_to_columnar(const std::string& input, const std::string& output,
+                         const std::vector<std::string>& quantities,
+                         const ConvertOptions& options = {});
+
+#endif // COLUMNAR_FILE_H
@@ -0,0 +1,63 @@
+// ColumnBlock.h
+#ifndef COLUMN_BLOCK_H
+#define COLUMN_BLOCK_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "binaryreader.h"
+
+// Columnar (structure-of-arrays) copy of selected quantities of a
+// ParticleBlock: one contiguous array per quantity, e.g.
+//
+//   std::span<const double>  pz  = columns.doubles(Quantity::PZ);
+//   std::span<const int32_t> pdg = columns.ints(Quantity::PDG);
+//
+// Column buffers are kept between decode() calls, so a long-lived ColumnBlock
+// only allocates when an event is larger than every previous one.
+class ColumnBlock {
+public:
+    int32_t event_number = 0;
+    int32_t ensamble_number = 0;
+    uint32_t npart = 0;
+
+    // Decodes `quantities` of `block` (laid out as `layout`); other fields of
+    // the records are never read. Throws if a quantity is not part of the layout.
+    void decode(const ParticleBlock& block,
+                const std::unordered_map<Quantity, size_t>& layout,
+                const std::vector<Quantity>& quantities);
+
+    bool has(Quantity q) const { return columns[static_cast<size_t>(q)].present; }
+    size_t size() const { return npart; }
+
+    std::span<const double> doubles(Quantity q) const;
+    std::span<const int32_t> ints(Quantity q) const;
+
+    std::span<const double> doubles(const std::string& name) const;
+    std::span<const int32_t> ints(const std::string& name) const;
+
+private:
+    struct Column {
+        bool present = false;
+        std::vector<double> doubles;
+        std::vector<int32_t> ints;
+    };
+    std::array<Column, quantity_count> columns;
+
+    // Fields projected by the current decode(); only these are read from
+    // the records, everything else in a record is skipped.
+    struct Field {
+        size_t offset;
+        QuantityType type;
+        Column* column;
+    };
+    std::vector<Field> plan;
+
+    const Column& column(Quantity q, QuantityType type) const;
+};
+
+#endif // COLUMN_BLOCK_H
@@ -2,13 +2,21 @@
 #include <variant>
 #include <vector>
 #include <map>
+#include <memory_resource>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <iosfwd>
+#include "accumulators.h"
 #include "histogram1d.h"
 
 #include <yaml-cpp/yaml.h>
+// Leaf values. The accumulators (see accumulators.h) have a fixed size and
+// merge with +=, unlike the vectors, which merging concatenates.
 using Data = std::variant<std::monostate, int, double,
-                          std::vector<int>, std::vector<double>, Histogram1D>;
+                          std::vector<int>, std::vector<double>, Histogram1D,
+                          RunningMoments, MinMax, QuantileSketch, KahanSum>;
 void merge_values(Data& a, const Data& b, const std::string& path);
  // YAML serialization
 
@@ -16,52 +24,192 @@ void merge_values(Data& a, const Data& b, const std::string& path);
 
 // datanode.hpp (or wherever DataNode lives)
 
+// Typed reference to the value of a DataNode, resolved once (see
+// DataNode::handle) so hot loops skip the key lookups and std::get. Valid
+// while the node exists and keeps holding a T: merging into the tree keeps
+// it valid; assigning the node's value or calling add_child on the node
+// itself does not. Copies of the tree have their own values.
+template <typename T>
+class DataHandle {
+public:
+  DataHandle() = default;
+  explicit DataHandle(T& value) : value_(&value) {}
+
+  T& operator*()  const { return *value_; }
+  T* operator->() const { return value_; }
+  explicit operator bool() const { return value_ != nullptr; }
+
+private:
+  T* value_ = nullptr;
+};
+
+// Monotonic memory resource for result trees. Nodes, names and histogram
+// counts allocated from it sit next to each other, and are released all at
+// once with the arena (deallocation is a no-op). Allocation is serialised,
+// so a tree in an arena can still be merged from several threads.
+class DataArena : public std::pmr::memory_resource {
+public:
+  explicit DataArena(size_t initial_size = 64 * 1024) : arena_(initial_size) {}
+
+private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return arena_.allocate(bytes, alignment);
+  }
+  void do_deallocate(void*, size_t, size_t) override {}
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::mutex mutex_;
+  std::pmr::monotonic_buffer_resource arena_;
+};
+
+// Nodes are allocator-aware: children are allocated from their parent's
+// memory resource, so a tree rooted in a DataArena keeps its nodes, names and
+// histogram counts there; default-constructed trees use the heap. Plain
+// copies use the default resource. Moving or merging a node into a tree with
+// another resource copies what it has to, so no tree points into another's
+// arena.
 class DataNode {
 public:
-  DataNode() : name(""), value(std::monostate{}) {}
-  explicit DataNode(const std::string& name) : name(name) {}
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+  using Children = std::pmr::map<std::pmr::string, DataNode, std::less<>>;
+
+  DataNode() = default;
+  explicit DataNode(allocator_type alloc) : name(alloc), subdata(alloc) {}
+  explicit DataNode(std::string_view name, allocator_type alloc = {})
+    : name(name, alloc), subdata(alloc) {}
 
   template<typename T>
-  DataNode(const std::string& name, T&& value)
-  : name(name) {
-    static_assert(std::is_constructible_v<Data, T&&>,
-                  "Type not supported by Data variant");
-    this->value = Data(std::forward<T>(value));
+    requires std::is_constructible_v<Data, T&&>
+  DataNode(std::string_view name, T&& value, allocator_type alloc = {})
+    : name(name, alloc), value(make_data(std::forward<T>(value), alloc)), subdata(alloc) {}
+
+  DataNode(const DataNode&) = default;
+  DataNode(DataNode&&) = default;
+  DataNode(const DataNode& other, allocator_type alloc)
+    : name(other.name, alloc), value(copy_data(other.value, alloc)), subdata(other.subdata, alloc) {}
+  DataNode(DataNode&& other, allocator_type alloc)
+    : name(std::move(other.name), alloc), value(move_data(std::move(other.value), alloc)),
+      subdata(std::move(other.subdata), alloc) {}
+
+  // Assignment keeps this node's resource.
+  DataNode& operator=(const DataNode& other) {
+    if (this != &other) {
+      name = other.name;
+      value = copy_data(other.value, get_allocator());
+      subdata = other.subdata;
+    }
+    return *this;
+  }
+  DataNode& operator=(DataNode&& other) {
+    if (this != &other) {
+      name = std::move(other.name);
+      value = move_data(std::move(other.value), get_allocator());
+      subdata = std::move(other.subdata);
+    }
+    return *this;
   }
 
+  allocator_type get_allocator() const { return subdata.get_allocator(); }
+
   // Accessors (public)
-  const std::string& get_name() const { return name; }
+  const std::pmr::string& get_name() const { return name; }
   const Data& get_data() const { return value; }
   Data&       get_data()       { return value; }
-  DataNode& operator+=(const DataNode& other); 
+  // Merges `other` into this tree: leaves by merge_values, children by key.
+  // The rvalue version splices new subtrees and moves values instead of
+  // copying them, leaving `other` valid but unspecified.
+  DataNode& operator+=(const DataNode& other);
+  DataNode& operator+=(DataNode&& other);
 
-  std::map<std::string, DataNode>&       children()       { return subdata; }
-  const std::map<std::string, DataNode>& children() const { return subdata; }
+  Children&       children()       { return subdata; }
+  const Children& children() const { return subdata; }
 
  
-DataNode& add_child(const std::string& key) {
+DataNode& add_child(std::string_view key) {
     value = std::monostate{}; // clear any accidental scalar
-    auto [it, inserted] = subdata.emplace(key, DataNode(key));
+    auto it = subdata.lower_bound(key);
+    if (it == subdata.end() || it->first != key) {
+      it = subdata.emplace_hint(it, std::piecewise_construct,
+                                std::forward_as_tuple(key), std::forward_as_tuple(key));
+    }
     return it->second;
 }
 
  
 template <typename T>
-DataNode& add_child(const std::string& key, T&& value_in) {
-    auto [it, inserted] = subdata.emplace(key, DataNode(key, std::forward<T>(value_in)));
+DataNode& add_child(std::string_view key, T&& value_in) {
+    auto it = subdata.lower_bound(key);
+    if (it == subdata.end() || it->first != key) {
+      it = subdata.emplace_hint(it, std::piecewise_construct, std::forward_as_tuple(key),
+                                std::forward_as_tuple(key, std::forward<T>(value_in)));
+    }
     return it->second;
 }
+  // Descendant at `path` (keys separated by '/'), created as needed.
+  DataNode& add_path(std::string_view path);
+
+  // Resolves `path` once and returns a handle to its value, which is set to
+  // `init` unless it already holds a T.
+  template <typename T>
+  DataHandle<T> handle(std::string_view path, const T& init = T{}) {
+    static_assert(std::is_constructible_v<Data, const T&>,
+                  "Type not supported by Data variant");
+    DataNode& node = add_path(path);
+    if (!std::holds_alternative<T>(node.value)) node.value = make_data(init, node.get_allocator());
+    return DataHandle<T>(std::get<T>(node.value));
+  }
+
   bool has_value() const { return !std::holds_alternative<std::monostate>(value); }
   bool is_leaf()   const { return has_value() && subdata.empty(); }
   bool empty()     const { return !has_value() && subdata.empty(); } // convenience
 
 private:
-  std::string name = "";
+  friend struct DataNodeMerge;
+
+  // Data whose buffers come from `alloc` where the type supports it.
+  template <typename T>
+  static Data make_data(T&& v, allocator_type alloc) {
+    if constexpr (std::is_same_v<std::decay_t<T>, Histogram1D>) {
+      return Data(std::in_place_type<Histogram1D>, std::forward<T>(v), alloc);
+    } else {
+      return Data(std::forward<T>(v));
+    }
+  }
+  static Data copy_data(const Data& d, allocator_type alloc) {
+    if (auto* h = std::get_if<Histogram1D>(&d)) return make_data(*h, alloc);
+    return d;
+  }
+  static Data move_data(Data&& d, allocator_type alloc) {
+    if (auto* h = std::get_if<Histogram1D>(&d)) return make_data(std::move(*h), alloc);
+    return std::move(d);
+  }
+
+  std::pmr::string name;
   Data value{};
-  std::map<std::string, DataNode> subdata;
+  Children subdata;
 };
 
+// dst += *sources[0], *sources[1], ... (moved from), in that order. Disjoint
+// subtrees are merged on up to `n_threads` threads; every leaf still takes
+// its sources in order, so the result equals the serial merge bit for bit.
+void merge_trees(DataNode& dst, const std::vector<DataNode*>& sources, int n_threads);
+
 void to_yaml(YAML::Emitter& out, const Data& v);
 void to_yaml(YAML::Emitter& out, const DataNode& v);
+void to_yaml(YamlWriter& out, const Data& v);
+void to_yaml(YamlWriter& out, const DataNode& v);
+
+// Compact binary serialization of a tree (native byte order). Round trips
+// exactly, so merging stored partials gives the same result as merging the
+// same partials in memory. It need not equal one run over all their files:
+// that adds file by file, ((f1+f2)+f3)+f4, while merging partials of two
+// files each adds (f1+f2)+(f3+f4). The two agree exactly only for sums that
+// are exact, such as integer counts.
+void write_binary(std::ostream& out, const DataNode& node);
+// Throws std::runtime_error on truncated, unknown or implausibly deep input.
+DataNode read_binary(std::istream& in);
 
 
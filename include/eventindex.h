@@ -0,0 +1,74 @@
+// EventIndex.h
+#ifndef EVENT_INDEX_H
+#define EVENT_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "binaryreader.h"
+
+// One event of a binary file: its blocks from the first one after the
+// previous event's end block up to and including its own end block(s).
+// Blocks are assigned to events as BinaryReader does: particle and end
+// blocks by their event number, interaction blocks to the event of the
+// preceding particle block, or the one after the preceding end block.
+struct EventIndexEntry {
+    uint64_t offset;              // byte offset of the event's first block marker
+    uint64_t end;                 // one past its last block
+    int32_t event_number;
+    uint32_t particle_blocks;
+    uint32_t interaction_blocks;
+    uint32_t end_blocks;          // one per ensemble
+    uint64_t particles;           // records in its particle blocks
+};
+
+// Where every event of a file starts and ends, built by scanning the block
+// framing without decoding payloads. Covers particle output and collision
+// history alike. Stored next to the data as a sidecar (<file>.idx) so event
+// counts and seeks to event ranges are instant.
+class EventIndex {
+public:
+    static constexpr char MAGIC[4] = {'B', 'K', 'I', 'X'};
+    static constexpr uint16_t VERSION = 1;
+
+    // Scans `filename`; particle_size is the record size of the on-disk layout.
+    static EventIndex build(const std::string& filename, size_t particle_size);
+    static EventIndex load(const std::string& index_filename);
+    void save(const std::string& index_filename) const;
+
+    // Loads the sidecar of `filename` if it matches the file (size and
+    // modification time) and layout, otherwise rebuilds it and (if write_sidecar) tries to store it.
+    static EventIndex open(const std::string& filename, size_t particle_size,
+                           bool write_sidecar = true);
+
+    // One per event, in file order.
+    const std::vector<EventIndexEntry>& entries() const { return entries_; }
+    size_t size() const { return entries_.size(); }
+    uint64_t get_file_size() const { return file_size_; }
+    size_t get_particle_size() const { return particle_size_; }
+
+    size_t event_count() const { return entries_.size(); }
+    uint64_t particle_block_count() const;
+    uint64_t interaction_block_count() const;
+    uint64_t particle_count() const;
+
+    // First entry with event_number >= event (entries are in event order).
+    size_t lower_bound(int32_t event) const;
+
+    // Up to `parts` contiguous event ranges with roughly equal numbers of
+    // bytes, so particle and interaction blocks both count. Never splits an
+    // event.
+    std::vector<EventRange> split(size_t parts) const;
+
+private:
+    uint64_t file_size_ = 0;
+    int64_t file_mtime_ = 0;      // last_write_time ticks of the indexed file
+    size_t particle_size_ = 0;
+    std::vector<EventIndexEntry> entries_;
+};
+
+std::string index_path(const std::string& filename);
+
+#endif // EVENT_INDEX_H
@@ -1,30 +1,98 @@
 #ifndef HISTOGRAM1D_H
 #define HISTOGRAM1D_H
 
+#include <algorithm>
+#include <memory_resource>
 #include <vector>
 #include <iostream>
 #include <iomanip>
+#include <span>
 #include <stdexcept>
 
+#include "histogramfill.h"
+#include "yamlwriter.h"
+
 #include <yaml-cpp/yaml.h>
 class Histogram1D {
 public:
-    Histogram1D(double min, double max, size_t bins)
-        : min_(min), max_(max), bins_(bins), counts_(bins, 0.0) 
+    // Counts come from `alloc`'s memory resource (see DataArena); copies
+    // use the default resource unless given one.
+    using allocator_type = std::pmr::polymorphic_allocator<double>;
+
+    Histogram1D(double min, double max, size_t bins, allocator_type alloc = {})
+        : min_(min), max_(max), bins_(bins), counts_(bins, 0.0, alloc)
     {
         if (max <= min || bins == 0) {
             throw std::invalid_argument("Invalid histogram range or bin count.");
         }
         bin_width_ = (max - min) / bins;
+        inv_width_ = 1.0 / bin_width_;
+    }
+
+    // Rebuilds a histogram from stored bin contents.
+    Histogram1D(double min, double max, const std::vector<double>& counts, allocator_type alloc = {})
+        : Histogram1D(min, max, counts.size(), alloc)
+    {
+        std::copy(counts.begin(), counts.end(), counts_.begin());
     }
 
+    Histogram1D(const Histogram1D&) = default;
+    Histogram1D(Histogram1D&&) = default;
+    Histogram1D& operator=(const Histogram1D&) = default;
+    Histogram1D& operator=(Histogram1D&&) = default;
+
+    // Copy/move into `alloc`'s resource; the move only takes other's counts
+    // if they come from the same resource.
+    Histogram1D(const Histogram1D& other, allocator_type alloc)
+        : min_(other.min_), max_(other.max_), bin_width_(other.bin_width_),
+          inv_width_(other.inv_width_), bins_(other.bins_), counts_(other.counts_, alloc) {}
+    Histogram1D(Histogram1D&& other, allocator_type alloc)
+        : min_(other.min_), max_(other.max_), bin_width_(other.bin_width_),
+          inv_width_(other.inv_width_), bins_(other.bins_), counts_(std::move(other.counts_), alloc) {}
+
     
 bool fill(double value, double weight = 1.0) {
-    if (value < min_ || value >= max_) return false;
-    size_t bin = static_cast<size_t>((value - min_) / bin_width_);
+    // Written so that NaN fails the check too.
+    if (!(value >= min_ && value < max_)) return false;
+    // Rounding can put values just below max_ into bin `bins_`.
+    size_t bin = std::min(static_cast<size_t>((value - min_) / bin_width_), bins_ - 1);
     counts_[bin] += weight;
     return true;
 }
+
+    // Fills all `values`, each with its entry of `weights` (1 if empty), into
+    // the same bins as fill(). Bin indices are computed a tile at a time by
+    // the SIMD kernels of compute_bins; the counts are then added in input
+    // order, so repeated bins and weighted sums come out exactly as with
+    // fill(). Returns how many values were in range.
+    size_t fill(std::span<const double> values, std::span<const double> weights = {}) {
+        if (!weights.empty() && weights.size() != values.size()) {
+            throw std::invalid_argument("Histogram fill: values and weights differ in length.");
+        }
+        const BinSpec spec = bin_spec();
+        constexpr size_t tile = 256;
+        int32_t bins[tile];
+        size_t filled = 0;
+        for (size_t start = 0; start < values.size(); start += tile) {
+            const size_t n = std::min(tile, values.size() - start);
+            compute_bins(values.data() + start, n, spec, bins);
+            if (weights.empty()) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (bins[i] < 0) continue;
+                    counts_[bins[i]] += 1.0;
+                    ++filled;
+                }
+            } else {
+                for (size_t i = 0; i < n; ++i) {
+                    if (bins[i] < 0) continue;
+                    counts_[bins[i]] += weights[start + i];
+                    ++filled;
+                }
+            }
+        }
+        return filled;
+    }
+
     double bin_center(size_t i) const {
         if (i >= bins_) throw std::out_of_range("Invalid bin index");
         return min_ + (i + 0.5) * bin_width_;
@@ -40,6 +108,11 @@ double bin_edge(size_t i) const {
     return min_ + i * bin_width_;
 }
     size_t num_bins() const { return bins_; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+    const std::pmr::vector<double>& counts() const { return counts_; }
+    allocator_type get_allocator() const { return counts_.get_allocator(); }
+    BinSpec bin_spec() const { return {min_, max_, bin_width_, inv_width_, bins_}; }
 
     void print(std::ostream& out = std::cout) const {
         out << std::fixed << std::setprecision(4);
@@ -77,9 +150,9 @@ double bin_content(size_t i) const {
 
 
 private:
-    double min_, max_, bin_width_;
+    double min_, max_, bin_width_, inv_width_;
     size_t bins_;
-    std::vector<double> counts_;
+    std::pmr::vector<double> counts_;
 };
 
 inline bool operator==(const Histogram1D& lhs, const Histogram1D& rhs) {
@@ -105,5 +178,12 @@ inline void to_yaml(YAML::Emitter& out, const Histogram1D& h)
     out << YAML::EndMap;
 }
 
+inline void to_yaml(YamlWriter& out, const Histogram1D& h)
+{
+    out.begin_map();
+    out.key("counts").flow_seq(h.counts());
+    out.end_map();
+}
+
 
 #endif // HISTOGRAM1D_H
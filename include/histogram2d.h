@@ -1,11 +1,15 @@
 #ifndef HISTOGRAM2D_H
 #define HISTOGRAM2D_H
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include <iomanip>
+#include <span>
 #include <stdexcept>
 
+#include "histogramfill.h"
+
 class Histogram2D {
 public:
     Histogram2D(double x_min, double x_max, size_t x_bins,
@@ -19,15 +23,57 @@ public:
         }
         x_bin_width_ = (x_max - x_min) / x_bins;
         y_bin_width_ = (y_max - y_min) / y_bins;
+        x_inv_width_ = 1.0 / x_bin_width_;
+        y_inv_width_ = 1.0 / y_bin_width_;
+    }
+
+    // Rebuilds a histogram from stored bin contents (row-major, x_bins rows).
+    Histogram2D(double x_min, double x_max, size_t x_bins,
+                double y_min, double y_max, std::vector<double> counts)
+        : Histogram2D(x_min, x_max, x_bins, y_min, y_max,
+                      x_bins == 0 ? 0 : counts.size() / x_bins)
+    {
+        if (counts.size() != counts_.size()) {
+            throw std::invalid_argument("Histogram counts do not match the bin count.");
+        }
+        counts_ = std::move(counts);
     }
 
     void fill(double x, double y, double weight = 1.0) {
-        if (x < x_min_ || x >= x_max_ || y < y_min_ || y >= y_max_) return;
-        size_t x_bin = static_cast<size_t>((x - x_min_) / x_bin_width_);
-        size_t y_bin = static_cast<size_t>((y - y_min_) / y_bin_width_);
+        // Written so that NaN fails the check too.
+        if (!(x >= x_min_ && x < x_max_ && y >= y_min_ && y < y_max_)) return;
+        size_t x_bin = std::min(static_cast<size_t>((x - x_min_) / x_bin_width_), x_bins_ - 1);
+        size_t y_bin = std::min(static_cast<size_t>((y - y_min_) / y_bin_width_), y_bins_ - 1);
         counts_[x_bin * y_bins_ + y_bin] += weight;
     }
 
+    // Batch version of fill() for pairs (xs[i], ys[i]); see Histogram1D's.
+    // Returns how many pairs were in range.
+    size_t fill(std::span<const double> xs, std::span<const double> ys,
+                std::span<const double> weights = {}) {
+        if (xs.size() != ys.size() || (!weights.empty() && weights.size() != xs.size())) {
+            throw std::invalid_argument("Histogram fill: x, y and weights differ in length.");
+        }
+        const BinSpec x_spec = x_bin_spec();
+        const BinSpec y_spec = y_bin_spec();
+        constexpr size_t tile = 256;
+        int32_t x_bins[tile];
+        int32_t y_bins[tile];
+        size_t filled = 0;
+        for (size_t start = 0; start < xs.size(); start += tile) {
+            const size_t n = std::min(tile, xs.size() - start);
+            compute_bins(xs.data() + start, n, x_spec, x_bins);
+            compute_bins(ys.data() + start, n, y_spec, y_bins);
+            for (size_t i = 0; i < n; ++i) {
+                if (x_bins[i] < 0 || y_bins[i] < 0) continue;
+                counts_[static_cast<size_t>(x_bins[i]) * y_bins_ + y_bins[i]] +=
+                    weights.empty() ? 1.0 : weights[start + i];
+                ++filled;
+            }
+        }
+        return filled;
+    }
+
     double x_bin_center(size_t i) const {
         if (i >= x_bins_) throw std::out_of_range("Invalid x bin index");
         return x_min_ + (i + 0.5) * x_bin_width_;
@@ -45,6 +91,9 @@ public:
 
     size_t num_x_bins() const { return x_bins_; }
     size_t num_y_bins() const { return y_bins_; }
+    const std::vector<double>& counts() const { return counts_; }
+    BinSpec x_bin_spec() const { return {x_min_, x_max_, x_bin_width_, x_inv_width_, x_bins_}; }
+    BinSpec y_bin_spec() const { return {y_min_, y_max_, y_bin_width_, y_inv_width_, y_bins_}; }
 
     void print(std::ostream& out = std::cout) const {
         out << std::fixed << std::setprecision(4);
@@ -76,9 +125,10 @@ public:
     }
 
 private:
-    double x_min_, x_max_, x_bin_width_;
-    double y_min_, y_max_, y_bin_width_;
-    size_t x_bins_, y_bins_;
+    double x_min_, x_max_, x_bin_width_, x_inv_width_;
+    size_t x_bins_;
+    double y_min_, y_max_, y_bin_width_, y_inv_width_;
+    size_t y_bins_;
     std::vector<double> counts_;  // stored in row-major: [x][y]
 };
 
@@ -0,0 +1,47 @@
+// HistogramFill.h
+#ifndef HISTOGRAM_FILL_H
+#define HISTOGRAM_FILL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Binning of one histogram axis, with the reciprocal width precomputed for
+// the batch kernels.
+struct BinSpec {
+    double min;
+    double max;
+    double width;
+    double inv_width;
+    size_t bins;
+};
+
+// Bin of `value` as Histogram1D::fill computes it (by division), or -1
+// outside [min, max) and for NaN.
+inline int32_t bin_index(double value, const BinSpec& spec) {
+    if (!(value >= spec.min && value < spec.max)) return -1;
+    const size_t bin = static_cast<size_t>((value - spec.min) / spec.width);
+    return static_cast<int32_t>(bin < spec.bins - 1 ? bin : spec.bins - 1);
+}
+
+// out[i] = bin of values[i] as Histogram1D::fill computes it, or -1 outside
+// [min, max) (NaN included). Bins are found by multiplying with inv_width;
+// the few values within rounding distance of a bin edge are redone with the
+// division, so results match fill() exactly. Uses AVX-512 or AVX2 kernels
+// when the CPU supports them, a scalar loop otherwise.
+void compute_bins(const double* values, size_t n, const BinSpec& spec, int32_t* out);
+
+// "avx512", "avx2" or "scalar": the kernel compute_bins uses on this CPU.
+const char* bin_kernel_name();
+
+// The kernels of compute_bins, for running one of them explicitly.
+enum class BinKernel { Scalar, Avx2, Avx512 };
+
+// Whether this build and CPU can run `kernel`; Scalar always can.
+bool bin_kernel_supported(BinKernel kernel);
+
+// compute_bins with the given kernel instead of the one picked for the CPU,
+// so each can be checked on any machine that supports it. Throws
+// std::invalid_argument if the kernel is not supported.
+void compute_bins(const double* values, size_t n, const BinSpec& spec, int32_t* out, BinKernel kernel);
+
+#endif // HISTOGRAM_FILL_H
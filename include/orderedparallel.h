@@ -0,0 +1,79 @@
+// OrderedParallel.h
+#ifndef ORDERED_PARALLEL_H
+#define ORDERED_PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Runs produce(k) for k in [first, n) on up to `n_threads` threads and hands
+// the results to consume(k, result) strictly in order of k, so floating-point
+// sums and vector concatenations match a serial run bit for bit. Finished
+// items wait in `pending` until every item before them has been consumed; a
+// worker does not start an item more than `window` (0: 4 per thread) ahead
+// of the next one to consume, so a slow early item can't make results pile
+// up. The first exception, from produce or consume, stops the remaining work
+// and is rethrown once all threads have joined.
+template <typename Produce, typename Consume>
+void ordered_parallel(size_t first, size_t n, int n_threads, Produce produce, Consume consume,
+                      size_t window = 0) {
+    if (n_threads <= 1) {
+        for (size_t k = first; k < n; ++k) consume(k, produce(k));
+        return;
+    }
+
+    using Result = decltype(produce(first));
+    // Items in flight are within [next_consume, next_consume + window), so
+    // k % window gives each its own slot.
+    if (window == 0) window = 4 * static_cast<size_t>(n_threads);
+    std::vector<std::optional<Result>> pending(window);
+    std::atomic<size_t> next_item{first};
+    size_t next_consume = first;
+    std::mutex consume_mutex;
+    std::condition_variable consumed;
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};
+
+    auto worker = [&]() {
+        for (size_t k = next_item++; k < n && !failed; k = next_item++) {
+            try {
+                {
+                    // The item at next_consume is never held back by this, so
+                    // some worker always makes progress.
+                    std::unique_lock<std::mutex> lock(consume_mutex);
+                    consumed.wait(lock, [&] { return failed || k < next_consume + window; });
+                    if (failed) break;
+                }
+                Result result = produce(k);
+
+                std::lock_guard<std::mutex> lock(consume_mutex);
+                pending[k % window] = std::move(result);
+                const size_t before = next_consume;
+                while (next_consume < n && pending[next_consume % window]) {
+                    consume(next_consume, std::move(*pending[next_consume % window]));
+                    pending[next_consume % window].reset();
+                    ++next_consume;
+                }
+                if (next_consume != before) consumed.notify_all();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(consume_mutex);
+                if (!error) error = std::current_exception();
+                failed = true;
+                consumed.notify_all();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(n_threads);
+    for (int t = 0; t < n_threads; ++t) workers.emplace_back(worker);
+    for (auto& w : workers) w.join();
+    if (error) std::rethrow_exception(error);
+}
+
+#endif // ORDERED_PARALLEL_H
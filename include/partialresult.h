@@ -0,0 +1,59 @@
+// PartialResult.h
+#ifndef PARTIAL_RESULT_H
+#define PARTIAL_RESULT_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+
+// Which shards of a sharded run (--shard i/N) a partial result covers.
+struct ShardProvenance {
+    std::string run;               // id of the sharded run; empty: not sharded
+    uint32_t shard_count = 0;
+    std::vector<uint32_t> shards;  // sorted indices of the shards merged in
+
+    bool is_sharded() const { return !run.empty(); }
+    bool is_complete() const { return shards.size() == shard_count; }
+};
+
+// Merged but not finalized results of one analysis (<analysis>.bark). Unlike
+// the YAML export these can be merged again, so batch jobs write partials and
+// `merge` reduces them into the final output.
+//
+// Layout (native byte order):
+//   "BKPR" u16 version  str analysis_name
+//   str run  u32 shard_count  u32 n n x u32 shard
+//   str config  str analysis_config
+//   entries
+// entries := u32 n, n x (merge keys, str smash_version, DataNode)
+// merge keys := u32 n, n x (str name, u8 type, int32 | f64 | str)
+// with str = u32 length + bytes and DataNode as written by write_binary.
+struct PartialResult {
+    static constexpr char MAGIC[4] = {'B', 'K', 'P', 'R'};
+    static constexpr uint16_t VERSION = 1;
+
+    std::string analysis_name;
+    ShardProvenance provenance;
+    // The run settings (quantities, events, filter) and the analysis'
+    // config_id() the results were produced with. `merge` only combines
+    // partials that agree on both.
+    std::string config;
+    std::string analysis_config;
+    std::vector<Entry> entries;  // sorted by key
+
+    void save(const std::string& filename) const;
+
+    // Recreates the analysis through the registry for every entry.
+    // Without `entries` unless `with_entries`. Throws std::runtime_error for
+    // any other version.
+    static PartialResult load(const std::string& filename, bool with_entries = true);
+};
+
+// The entries section on its own, shared with Checkpoint.
+void write_entries(std::ostream& out, const std::vector<Entry>& entries);
+std::vector<Entry> read_entries(std::istream& in, const std::string& analysis_name);
+
+#endif // PARTIAL_RESULT_H
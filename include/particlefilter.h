@@ -0,0 +1,74 @@
+// ParticleFilter.h
+#ifndef PARTICLE_FILTER_H
+#define PARTICLE_FILTER_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "binaryreader.h"
+
+// Declarative per-particle pre-filter, evaluated by BinaryReader while it
+// frames a particle block. Analyses only see the particles that pass:
+//
+//   ParticleFilter f;
+//   f.pdgs = {211, -211, 2212};
+//   f.cuts.push_back({Quantity::PZ, 0.0, 1.0, true});   // |pz| in [0, 1)
+//   reader.set_filter(f);
+//
+// All conditions must hold. The tests run over one gathered column at a
+// time, so each is a flat compare loop the compiler vectorizes.
+struct ParticleFilter {
+    // Half-open [min, max) on a quantity (or its absolute value).
+    struct Cut {
+        Quantity quantity;
+        double min = -std::numeric_limits<double>::infinity();
+        double max = std::numeric_limits<double>::infinity();
+        bool absolute = false;
+    };
+
+    std::vector<int32_t> pdgs;     // empty: any species
+    std::vector<int32_t> charges;  // empty: any charge
+    std::vector<Cut> cuts;
+
+    bool empty() const { return pdgs.empty() && charges.empty() && cuts.empty(); }
+
+    // Quantities the filter reads; they must be part of the file's layout.
+    std::vector<Quantity> quantities() const;
+
+    // Resolves the offsets of all tested quantities. Throws if one is missing.
+    void bind(const std::unordered_map<Quantity, size_t>& layout);
+
+    // False if no particle whose values lie within `ranges` ([min, max] per
+    // quantity, e.g. chunk statistics) can pass. Quantities without a range
+    // are assumed to match.
+    bool may_match(const std::unordered_map<Quantity, std::pair<double, double>>& ranges) const;
+
+    // Drops failing particles from `block`. Survivors are packed into this
+    // filter's buffer, which `block` points at until the next apply().
+    void apply(ParticleBlock& block);
+
+private:
+    size_t pdg_offset = 0;
+    size_t charge_offset = 0;
+    std::vector<size_t> cut_offsets;
+    std::vector<QuantityType> cut_types;
+    bool bound = false;
+
+    // Reused between blocks.
+    std::vector<uint8_t> mask;
+    std::vector<int32_t> int_column;
+    std::vector<double> double_column;
+    std::vector<char> records;
+};
+
+// "<quantity>:<min>:<max>"; either bound may be empty.
+ParticleFilter::Cut parse_cut(const std::string& spec, bool absolute = false);
+
+// Comma-separated integers, e.g. "211,-211,2212".
+std::vector<int32_t> parse_int_list(const std::string& spec);
+
+#endif // PARTICLE_FILTER_H
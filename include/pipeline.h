@@ -0,0 +1,88 @@
+// Pipeline.h
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "analysis.h"
+#include "blockingqueue.h"
+
+// Accessor for analysing a single file on several cores. The thread running
+// BinaryReader::read() only frames blocks and collects them into batches;
+// batch k goes to worker k % N, and every worker feeds its own Analysis
+// instance. Batches are cut only between events, so all blocks of an event
+// (particle, interaction and end blocks) reach the same worker in file
+// order; a batch holds at least batch_size blocks unless the file ends, and
+// more if an event is larger.
+// finish() merges the instances in worker order, so a given
+// (batch_size, N) always produces the same result.
+//
+// Blocks from a mapped file are passed on without copying; the reader must
+// stay alive until finish() or abort() returns.
+class PipelinedAccessor : public Accessor {
+public:
+    // One list of analyses per worker; all lists hold the same analyses.
+    explicit PipelinedAccessor(std::vector<std::vector<std::shared_ptr<Analysis>>> analyses,
+                               size_t batch_size = 64);
+    ~PipelinedAccessor() override;
+
+    void on_header(Header& header) override;
+    void on_particle_block(const ParticleBlock& block) override;
+    void on_interaction_block(const InteractionBlock& block) override;
+    void on_end_block(const EndBlock& block) override;
+
+    // Flushes the last batch, joins the workers and returns the first
+    // worker's analyses with the other workers' merged into them.
+    // Rethrows worker errors.
+    std::vector<std::shared_ptr<Analysis>> finish();
+    // Stops the workers without merging (used when reading fails).
+    void abort();
+
+private:
+    // Blocks of all kinds, replayed by the worker in file order. Recycled,
+    // so block buffers are reused.
+    struct Batch {
+        std::vector<ParticleBlock> blocks;
+        std::vector<InteractionBlock> interactions;
+        std::vector<EndBlock> ends;
+        std::vector<char> order;  // 'p', 'i' or 'f' per block
+        size_t n_blocks = 0;
+        size_t n_interactions = 0;
+
+        size_t size() const { return order.size(); }
+        void clear() { order.clear(); ends.clear(); n_blocks = 0; n_interactions = 0; }
+    };
+
+    struct Worker {
+        std::vector<std::shared_ptr<Analysis>> analyses;
+        std::shared_ptr<DispatchingAccessor> dispatcher;
+        BlockingQueue<Batch> queue{4};
+        std::thread thread;
+    };
+
+    void begin_block(bool new_event);
+    void run_worker(Worker& worker);
+    void dispatch_batch();
+    void fail(std::exception_ptr e);
+    void stop();
+    void rethrow_if_failed();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    size_t batch_size;
+    size_t next_worker = 0;
+    Batch current;
+    int64_t last_event = -1;  // of the last particle or end block
+    bool after_end = false;   // the last block was an end block
+    BlockingQueue<Batch> free_batches;
+
+    std::atomic<bool> failed{false};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+};
+
+#endif // PIPELINE_H
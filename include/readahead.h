@@ -0,0 +1,80 @@
+// ReadAhead.h
+#ifndef READ_AHEAD_H
+#define READ_AHEAD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "blockingqueue.h"
+
+// Sequential file reader with a background thread that fills a small ring of
+// large page-aligned buffers (pread + POSIX_FADV_SEQUENTIAL) while the caller
+// parses the previous one, hiding I/O latency behind decoding.
+//
+// take(n) returns n contiguous bytes: a pointer into the current buffer, or
+// into a staging copy when the bytes straddle two buffers. The pointer stays
+// valid until the next call to take() or next(); peek() keeps it valid, so a
+// block's records can be used while checking for the block that follows.
+class ReadAheadFile {
+public:
+    // Records live in recycled buffers; keep a copy to use them after a callback.
+    static constexpr bool persistent = false;
+
+    explicit ReadAheadFile(const std::string& filename,
+                           size_t buffer_size = size_t{8} << 20,
+                           size_t n_buffers = 4);
+    ~ReadAheadFile();
+
+    ReadAheadFile(const ReadAheadFile&) = delete;
+    ReadAheadFile& operator=(const ReadAheadFile&) = delete;
+
+    // Consumes one byte; false at end of file.
+    bool next(char& c);
+    // Looks at the next byte without consuming it; false at end of file.
+    bool peek(char& c);
+    const char* take(size_t n);
+
+    // Restarts reading at an absolute file offset.
+    void seek(uint64_t offset);
+
+private:
+    struct Filled {
+        size_t slot;
+        size_t size;   // 0 marks end of file (or an error)
+    };
+
+    struct AlignedFree {
+        void operator()(char* p) const;
+    };
+
+    void start(uint64_t offset);
+    void stop();
+    void produce(uint64_t offset);
+    bool advance();
+    void release(size_t slot);
+
+    static constexpr size_t no_slot = static_cast<size_t>(-1);
+
+    int fd = -1;
+    std::string filename;
+    size_t buffer_size;
+    std::vector<std::unique_ptr<char, AlignedFree>> buffers;
+
+    std::unique_ptr<BlockingQueue<size_t>> free_slots;
+    std::unique_ptr<BlockingQueue<Filled>> filled;
+    std::thread producer;
+    int read_error = 0;  // errno of a failed pread, set before the end marker
+
+    size_t current = no_slot;
+    size_t current_size = 0;
+    size_t pos = 0;
+    size_t retired = no_slot;  // previous buffer, kept until the next block starts
+    bool eof = false;
+    std::vector<char> staging;
+};
+
+#endif // READ_AHEAD_H
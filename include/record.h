@@ -0,0 +1,206 @@
+// Record.h
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "binaryreader.h"
+
+// Compile-time view of a packed particle record. The quantities are listed in
+// on-disk order, so offsets and stride are constants the compiler can fold:
+//
+//   using PRecord = Record<Quantity::P0, Quantity::PZ, Quantity::PDG>;
+//   double pz = PRecord::get<Quantity::PZ>(particle.data());
+//
+// Use RecordDispatcher to pick a matching Record for the layout of a file.
+
+template <Quantity Q> struct QuantityTraits;
+template <> struct QuantityTraits<Quantity::MASS>   { using type = double;  };
+template <> struct QuantityTraits<Quantity::P0>     { using type = double;  };
+template <> struct QuantityTraits<Quantity::PX>     { using type = double;  };
+template <> struct QuantityTraits<Quantity::PY>     { using type = double;  };
+template <> struct QuantityTraits<Quantity::PZ>     { using type = double;  };
+template <> struct QuantityTraits<Quantity::PDG>    { using type = int32_t; };
+template <> struct QuantityTraits<Quantity::NCOLL>  { using type = int32_t; };
+template <> struct QuantityTraits<Quantity::CHARGE> { using type = int32_t; };
+template <> struct QuantityTraits<Quantity::T>      { using type = double;  };
+template <> struct QuantityTraits<Quantity::X>      { using type = double;  };
+template <> struct QuantityTraits<Quantity::Y>      { using type = double;  };
+template <> struct QuantityTraits<Quantity::Z>      { using type = double;  };
+template <> struct QuantityTraits<Quantity::ID>     { using type = int32_t; };
+template <> struct QuantityTraits<Quantity::FORM_TIME>        { using type = double;  };
+template <> struct QuantityTraits<Quantity::XSECFAC>          { using type = double;  };
+template <> struct QuantityTraits<Quantity::PROC_ID_ORIGIN>   { using type = int32_t; };
+template <> struct QuantityTraits<Quantity::PROC_TYPE_ORIGIN> { using type = int32_t; };
+template <> struct QuantityTraits<Quantity::TIME_LAST_COLL>   { using type = double;  };
+template <> struct QuantityTraits<Quantity::PDG_MOTHER1>      { using type = int32_t; };
+template <> struct QuantityTraits<Quantity::PDG_MOTHER2>      { using type = int32_t; };
+template <> struct QuantityTraits<Quantity::BARYON_NUMBER>    { using type = int32_t; };
+template <> struct QuantityTraits<Quantity::STRANGENESS>      { using type = int32_t; };
+
+template <Quantity Q>
+using quantity_t = typename QuantityTraits<Q>::type;
+
+template <Quantity... Qs> struct Record;
+
+// Full SMASH particle records (see FormatVariant).
+using SmashDefaultRecord = Record<
+    Quantity::T, Quantity::X, Quantity::Y, Quantity::Z, Quantity::MASS,
+    Quantity::P0, Quantity::PX, Quantity::PY, Quantity::PZ,
+    Quantity::PDG, Quantity::ID, Quantity::CHARGE>;
+using SmashExtendedRecord = Record<
+    Quantity::T, Quantity::X, Quantity::Y, Quantity::Z, Quantity::MASS,
+    Quantity::P0, Quantity::PX, Quantity::PY, Quantity::PZ,
+    Quantity::PDG, Quantity::ID, Quantity::CHARGE,
+    Quantity::NCOLL, Quantity::FORM_TIME, Quantity::XSECFAC,
+    Quantity::PROC_ID_ORIGIN, Quantity::PROC_TYPE_ORIGIN, Quantity::TIME_LAST_COLL,
+    Quantity::PDG_MOTHER1, Quantity::PDG_MOTHER2,
+    Quantity::BARYON_NUMBER, Quantity::STRANGENESS>;
+
+template <Quantity... Qs>
+struct Record {
+    static constexpr size_t size = (size_t{0} + ... + sizeof(quantity_t<Qs>));
+
+    template <Quantity Q>
+    static constexpr bool contains() { return ((Q == Qs) || ...); }
+
+    template <Quantity Q>
+    static constexpr size_t offset() {
+        static_assert(contains<Q>(), "Quantity is not part of this Record");
+        size_t off = 0;
+        bool found = false;
+        ((found = found || Q == Qs, off += found ? 0 : sizeof(quantity_t<Qs>)), ...);
+        return off;
+    }
+
+    static constexpr size_t stride() { return size; }
+
+    template <Quantity Q>
+    static quantity_t<Q> get(const char* record) {
+        quantity_t<Q> value;
+        std::memcpy(&value, record + offset<Q>(), sizeof(value));
+        return value;
+    }
+
+    // True if `layout` describes exactly this record.
+    static bool matches(const std::unordered_map<Quantity, size_t>& layout) {
+        if (layout.size() != sizeof...(Qs)) return false;
+        auto at = [&](Quantity q, size_t off) {
+            auto it = layout.find(q);
+            return it != layout.end() && it->second == off;
+        };
+        return (at(Qs, offset<Qs>()) && ...);
+    }
+};
+
+// Runtime fallback with the same interface as Record, for layouts that no
+// compiled-in Record matches. get throws std::runtime_error for a quantity
+// the layout lacks, where Record would not compile.
+class DynamicRecord {
+public:
+    DynamicRecord() { offsets_.fill(missing); }
+
+    DynamicRecord(const std::unordered_map<Quantity, size_t>& layout,
+                  std::initializer_list<Quantity> required)
+    {
+        offsets_.fill(missing);
+        size_ = 0;
+        for (const auto& [q, off] : layout) {
+            offsets_[static_cast<size_t>(q)] = off;
+        }
+        for (const auto& [name, info] : quantity_string_map) {
+            if (layout.count(info.quantity)) size_ += type_size(info.type);
+        }
+        for (Quantity q : required) {
+            if (offsets_[static_cast<size_t>(q)] == missing)
+                throw std::runtime_error("Quantity not in layout");
+        }
+    }
+
+    size_t stride() const { return size_; }
+
+    template <Quantity Q>
+    quantity_t<Q> get(const char* record) const {
+        const size_t off = offsets_[static_cast<size_t>(Q)];
+        if (off == missing)
+            throw std::runtime_error("Quantity not in layout: " + quantity_name(Q));
+        quantity_t<Q> value;
+        std::memcpy(&value, record + off, sizeof(value));
+        return value;
+    }
+
+private:
+    static constexpr size_t missing = std::numeric_limits<size_t>::max();
+    std::array<size_t, quantity_count> offsets_{};
+    size_t size_ = 0;
+};
+
+// Picks the first Record matching a file's layout once (bind), then hands it
+// to a generic callable per block (visit). Every Record must contain all
+// quantities the callable reads; unmatched layouts go through DynamicRecord.
+template <typename... Records>
+class RecordDispatcher {
+public:
+    void bind(const std::unordered_map<Quantity, size_t>& layout,
+              std::initializer_list<Quantity> required)
+    {
+        index_ = match(layout, std::index_sequence_for<Records...>{});
+        if (index_ < 0) dynamic_ = DynamicRecord(layout, required);
+    }
+
+    // -1 when the DynamicRecord fallback is active.
+    int matched_index() const { return index_; }
+
+    template <typename F>
+    void visit(F&& f) const {
+        if (index_ < 0) {
+            f(dynamic_);
+            return;
+        }
+        visit_impl(f, std::index_sequence_for<Records...>{});
+    }
+
+private:
+    template <size_t... Is>
+    static int match(const std::unordered_map<Quantity, size_t>& layout, std::index_sequence<Is...>) {
+        int found = -1;
+        ((found < 0 && Records::matches(layout) ? (found = static_cast<int>(Is)) : 0), ...);
+        return found;
+    }
+
+    template <typename F, size_t... Is>
+    void visit_impl(F& f, std::index_sequence<Is...>) const {
+        ((index_ == static_cast<int>(Is) ? (f(Records{}), 0) : 0), ...);
+    }
+
+    int index_ = -1;
+    DynamicRecord dynamic_;
+};
+
+// Calls f(const char* record) for every particle of the block, stepping by the
+// record's stride (a compile-time constant for Record<...>). A DynamicRecord
+// steps by the block's own particle_size, which is what the reader used.
+template <typename Rec, typename F>
+void for_each_record(const ParticleBlock& block, const Rec& rec, F&& f) {
+    const char* p = block.data;
+    size_t stride;
+    if constexpr (std::is_same_v<Rec, DynamicRecord>) {
+        stride = block.particle_size;
+    } else {
+        stride = rec.stride();
+    }
+    for (uint32_t i = 0; i < block.npart; ++i, p += stride) {
+        f(p);
+    }
+}
+
+#endif // RECORD_H
@@ -0,0 +1,50 @@
+// ResultCache.h
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "analysis.h"
+
+// Directory of per-file partial results, so reruns over a growing set of
+// inputs only analyse new or changed files. An entry is keyed by the input
+// file's fingerprint, the analysis name and configuration
+// (Analysis::config_id) and the run configuration (layout, event range,
+// filter); the full key is stored in the entry and checked on
+// load. Entries hold the analysis' DataNode before finalize() and are merged
+// through Analysis::operator+= like freshly computed partials.
+class ResultCache {
+public:
+    static constexpr char MAGIC[4] = {'B', 'K', 'R', 'C'};
+    static constexpr uint16_t VERSION = 1;
+
+    // Creates `directory` if needed.
+    explicit ResultCache(std::string directory);
+
+    // Size, modification time and a hash of the first and last MiB of the
+    // file. Cheap even for multi-GB files, and changes whenever SMASH appends
+    // or rewrites output.
+    static std::string file_fingerprint(const std::string& path);
+
+    // Full key of one (file, analysis, configuration) entry.
+    static std::string make_key(const std::string& fingerprint,
+                                const std::string& analysis_name,
+                                const std::string& analysis_config,
+                                const std::string& config);
+
+    // Merges the entry for `key` into `analysis` (a fresh instance).
+    // Returns false if there is no usable entry.
+    bool load(const std::string& key, Analysis& analysis) const;
+
+    // Stores `analysis`' partial result under `key`; concurrent runs may
+    // store the same key.
+    void store(const std::string& key, const Analysis& analysis) const;
+
+private:
+    std::string entry_path(const std::string& key) const;
+
+    std::string directory;
+};
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,265 @@
+// ShardedHistogram.h
+#ifndef SHARDED_HISTOGRAM_H
+#define SHARDED_HISTOGRAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "histogram1d.h"
+#include "histogram2d.h"
+#include "histogramfill.h"
+
+// Histograms that several threads fill at once without locks, reduced on
+// demand into a regular Histogram1D/Histogram2D (`hist += sharded`).
+//
+// ShardedHistogram1D/2D keep one count array per shard. Every array starts
+// on its own cache line and is padded to whole lines, so threads filling
+// different shards never write to the same line. A shard must only be filled
+// by one thread at a time (typically shard = worker index). Reduction sums
+// the shards in shard order, so the same assignment of values to shards
+// always gives the same result.
+//
+// AtomicHistogram1D/2D keep a single array and add with relaxed atomic
+// fetch_add: no memory per thread, which matters for big 2D histograms, but
+// every fill is a read-modify-write on shared lines. Use them when threads
+// rarely hit the same bins. Weighted sums depend on the order the adds land
+// in; unit weights are exact.
+//
+// Reductions read the counts without synchronisation: fills must have
+// finished (e.g. the filling threads joined) before reducing or clearing.
+
+// Per-shard count arrays, each aligned to and padded to cache lines.
+class ShardedCounts {
+public:
+    static constexpr size_t cache_line = 64;
+
+    ShardedCounts(size_t size, size_t shards)
+        : size_(size), shards_(shards),
+          stride_((size + per_line - 1) / per_line * per_line),
+          counts_(allocate(stride_ * shards))
+    {
+        if (shards == 0) throw std::invalid_argument("Sharded histogram needs at least one shard.");
+        clear();
+    }
+
+    ShardedCounts(ShardedCounts&&) noexcept = default;
+    ShardedCounts& operator=(ShardedCounts&&) noexcept = default;
+
+    size_t size() const { return size_; }
+    size_t shards() const { return shards_; }
+
+    double* shard(size_t s) {
+        if (s >= shards_) throw std::out_of_range("Invalid histogram shard");
+        return counts_.get() + s * stride_;
+    }
+
+    // out[i] = sum over shards of shard(s)[i], added in shard order.
+    void sum(double* out) const {
+        std::copy_n(counts_.get(), size_, out);
+        for (size_t s = 1; s < shards_; ++s) {
+            const double* counts = counts_.get() + s * stride_;
+            for (size_t i = 0; i < size_; ++i) out[i] += counts[i];
+        }
+    }
+
+    void clear() { std::fill_n(counts_.get(), stride_ * shards_, 0.0); }
+
+private:
+    static constexpr size_t per_line = cache_line / sizeof(double);
+
+    struct Free {
+        void operator()(double* p) const { ::operator delete[](p, std::align_val_t(cache_line)); }
+    };
+
+    static std::unique_ptr<double[], Free> allocate(size_t n) {
+        return std::unique_ptr<double[], Free>(static_cast<double*>(
+            ::operator new[](n * sizeof(double), std::align_val_t(cache_line))));
+    }
+
+    size_t size_;
+    size_t shards_;
+    size_t stride_;  // doubles per shard, a multiple of a cache line
+    std::unique_ptr<double[], Free> counts_;
+};
+
+class ShardedHistogram1D {
+public:
+    ShardedHistogram1D(double min, double max, size_t bins, size_t shards)
+        : ShardedHistogram1D(Histogram1D(min, max, bins), shards) {}
+
+    // Same binning as `like`; its counts are not copied.
+    ShardedHistogram1D(const Histogram1D& like, size_t shards)
+        : spec_(like.bin_spec()), counts_(spec_.bins, shards) {}
+
+    bool fill(size_t shard, double value, double weight = 1.0) {
+        const int32_t bin = bin_index(value, spec_);
+        if (bin < 0) return false;
+        counts_.shard(shard)[bin] += weight;
+        return true;
+    }
+
+    // Batch fill into one shard, as Histogram1D::fill(values, weights).
+    size_t fill(size_t shard, std::span<const double> values,
+                std::span<const double> weights = {}) {
+        if (!weights.empty() && weights.size() != values.size()) {
+            throw std::invalid_argument("Histogram fill: values and weights differ in length.");
+        }
+        double* counts = counts_.shard(shard);
+        constexpr size_t tile = 256;
+        int32_t bins[tile];
+        size_t filled = 0;
+        for (size_t start = 0; start < values.size(); start += tile) {
+            const size_t n = std::min(tile, values.size() - start);
+            compute_bins(values.data() + start, n, spec_, bins);
+            for (size_t i = 0; i < n; ++i) {
+                if (bins[i] < 0) continue;
+                counts[bins[i]] += weights.empty() ? 1.0 : weights[start + i];
+                ++filled;
+            }
+        }
+        return filled;
+    }
+
+    size_t shards() const { return counts_.shards(); }
+
+    Histogram1D reduce() const {
+        std::vector<double> counts(spec_.bins);
+        counts_.sum(counts.data());
+        return Histogram1D(spec_.min, spec_.max, std::move(counts));
+    }
+
+    void clear() { counts_.clear(); }
+
+private:
+    BinSpec spec_;
+    ShardedCounts counts_;
+};
+
+class ShardedHistogram2D {
+public:
+    ShardedHistogram2D(double x_min, double x_max, size_t x_bins,
+                       double y_min, double y_max, size_t y_bins, size_t shards)
+        : ShardedHistogram2D(Histogram2D(x_min, x_max, x_bins, y_min, y_max, y_bins), shards) {}
+
+    ShardedHistogram2D(const Histogram2D& like, size_t shards)
+        : x_spec_(like.x_bin_spec()), y_spec_(like.y_bin_spec()),
+          counts_(x_spec_.bins * y_spec_.bins, shards) {}
+
+    bool fill(size_t shard, double x, double y, double weight = 1.0) {
+        const int32_t x_bin = bin_index(x, x_spec_);
+        const int32_t y_bin = bin_index(y, y_spec_);
+        if (x_bin < 0 || y_bin < 0) return false;
+        counts_.shard(shard)[static_cast<size_t>(x_bin) * y_spec_.bins + y_bin] += weight;
+        return true;
+    }
+
+    size_t shards() const { return counts_.shards(); }
+
+    Histogram2D reduce() const {
+        std::vector<double> counts(counts_.size());
+        counts_.sum(counts.data());
+        return Histogram2D(x_spec_.min, x_spec_.max, x_spec_.bins,
+                           y_spec_.min, y_spec_.max, std::move(counts));
+    }
+
+    void clear() { counts_.clear(); }
+
+private:
+    BinSpec x_spec_, y_spec_;
+    ShardedCounts counts_;
+};
+
+class AtomicHistogram1D {
+public:
+    AtomicHistogram1D(double min, double max, size_t bins)
+        : AtomicHistogram1D(Histogram1D(min, max, bins)) {}
+
+    explicit AtomicHistogram1D(const Histogram1D& like)
+        : spec_(like.bin_spec()), counts_(spec_.bins) {}
+
+    bool fill(double value, double weight = 1.0) {
+        const int32_t bin = bin_index(value, spec_);
+        if (bin < 0) return false;
+        counts_[bin].fetch_add(weight, std::memory_order_relaxed);
+        return true;
+    }
+
+    Histogram1D reduce() const {
+        std::vector<double> counts(counts_.size());
+        for (size_t i = 0; i < counts.size(); ++i) {
+            counts[i] = counts_[i].load(std::memory_order_relaxed);
+        }
+        return Histogram1D(spec_.min, spec_.max, std::move(counts));
+    }
+
+    void clear() {
+        for (auto& c : counts_) c.store(0.0, std::memory_order_relaxed);
+    }
+
+private:
+    BinSpec spec_;
+    std::vector<std::atomic<double>> counts_;
+};
+
+class AtomicHistogram2D {
+public:
+    AtomicHistogram2D(double x_min, double x_max, size_t x_bins,
+                      double y_min, double y_max, size_t y_bins)
+        : AtomicHistogram2D(Histogram2D(x_min, x_max, x_bins, y_min, y_max, y_bins)) {}
+
+    explicit AtomicHistogram2D(const Histogram2D& like)
+        : x_spec_(like.x_bin_spec()), y_spec_(like.y_bin_spec()),
+          counts_(x_spec_.bins * y_spec_.bins) {}
+
+    bool fill(double x, double y, double weight = 1.0) {
+        const int32_t x_bin = bin_index(x, x_spec_);
+        const int32_t y_bin = bin_index(y, y_spec_);
+        if (x_bin < 0 || y_bin < 0) return false;
+        counts_[static_cast<size_t>(x_bin) * y_spec_.bins + y_bin]
+            .fetch_add(weight, std::memory_order_relaxed);
+        return true;
+    }
+
+    Histogram2D reduce() const {
+        std::vector<double> counts(counts_.size());
+        for (size_t i = 0; i < counts.size(); ++i) {
+            counts[i] = counts_[i].load(std::memory_order_relaxed);
+        }
+        return Histogram2D(x_spec_.min, x_spec_.max, x_spec_.bins,
+                           y_spec_.min, y_spec_.max, std::move(counts));
+    }
+
+    void clear() {
+        for (auto& c : counts_) c.store(0.0, std::memory_order_relaxed);
+    }
+
+private:
+    BinSpec x_spec_, y_spec_;
+    std::vector<std::atomic<double>> counts_;
+};
+
+// hist += sharded: adds the reduced counts; the binning must match.
+inline Histogram1D& operator+=(Histogram1D& hist, const ShardedHistogram1D& sharded) {
+    return hist += sharded.reduce();
+}
+
+inline Histogram2D& operator+=(Histogram2D& hist, const ShardedHistogram2D& sharded) {
+    return hist += sharded.reduce();
+}
+
+inline Histogram1D& operator+=(Histogram1D& hist, const AtomicHistogram1D& atomic) {
+    return hist += atomic.reduce();
+}
+
+inline Histogram2D& operator+=(Histogram2D& hist, const AtomicHistogram2D& atomic) {
+    return hist += atomic.reduce();
+}
+
+#endif // SHARDED_HISTOGRAM_H
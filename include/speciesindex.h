@@ -0,0 +1,69 @@
+// SpeciesIndex.h
+#ifndef SPECIES_INDEX_H
+#define SPECIES_INDEX_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+// Dense indices 0..size()-1 for a set of PDG codes, so per-species state
+// (histogram handles, buffers) can live in plain vectors. index() is a
+// table lookup for |pdg| < 2^14, which covers the common hadrons, and a hash
+// lookup beyond (nuclei, excited states).
+class SpeciesIndex {
+public:
+    SpeciesIndex() = default;
+    explicit SpeciesIndex(const std::vector<int>& pdgs) {
+        for (int pdg : pdgs) add(pdg);
+    }
+
+    // Index of `pdg`, added if new.
+    int add(int pdg) {
+        const int existing = index(pdg);
+        if (existing >= 0) return existing;
+        const int idx = static_cast<int>(pdgs_.size());
+        pdgs_.push_back(pdg);
+        const int magnitude = std::abs(pdg);
+        if (magnitude < direct_limit && idx <= INT16_MAX) {
+            if (direct_.empty() || magnitude > max_direct_) {
+                // Re-centre the table on 0 for the larger range.
+                std::vector<int16_t> grown(2 * static_cast<size_t>(magnitude) + 1, -1);
+                for (size_t i = 0; i < direct_.size(); ++i) {
+                    grown[i + magnitude - max_direct_] = direct_[i];
+                }
+                direct_ = std::move(grown);
+                max_direct_ = magnitude;
+            }
+            direct_[pdg + max_direct_] = static_cast<int16_t>(idx);
+        } else {
+            others_.emplace(pdg, idx);
+        }
+        return idx;
+    }
+
+    // Index of `pdg`, or -1 if it is not in the set.
+    int index(int pdg) const {
+        if (pdg >= -max_direct_ && pdg <= max_direct_ && !direct_.empty()) {
+            const int idx = direct_[pdg + max_direct_];
+            if (idx >= 0 || others_.empty()) return idx;
+        }
+        if (others_.empty()) return -1;
+        auto it = others_.find(pdg);
+        return it == others_.end() ? -1 : it->second;
+    }
+
+    int pdg(int idx) const { return pdgs_[idx]; }
+    const std::vector<int>& pdgs() const { return pdgs_; }
+    size_t size() const { return pdgs_.size(); }
+
+private:
+    static constexpr int direct_limit = 1 << 14;
+
+    std::vector<int> pdgs_;               // by index
+    std::vector<int16_t> direct_;         // pdg + max_direct_ -> index or -1
+    int max_direct_ = 0;
+    std::unordered_map<int, int> others_;
+};
+
+#endif // SPECIES_INDEX_H
@@ -0,0 +1,92 @@
+// YamlWriter.h
+#ifndef YAML_WRITER_H
+#define YAML_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Block-style YAML written straight to a file through a fixed-size buffer,
+// so the document never has to fit in memory. Produces the same bytes as
+// YAML::Emitter for the documents bark writes (block maps and sequences,
+// flow sequences of numbers, 17 significant digits for doubles); strings
+// that are not plain identifiers are quoted by yaml-cpp itself. Like
+// binaryio::replace_file, it writes to a temporary file next to the target
+// and renames it over the target in close(), so an exception or a killed
+// job leaves any previous file intact.
+//
+//   YamlWriter out("result.yaml");
+//   out.begin_map().key("counts").flow_seq(h.counts()).end_map();
+//   out.close();
+class YamlWriter {
+public:
+    explicit YamlWriter(const std::string& filename, size_t buffer_size = 1 << 20);
+    ~YamlWriter();  // without close(): removes the temporary, keeps the target
+
+    YamlWriter(const YamlWriter&) = delete;
+    YamlWriter& operator=(const YamlWriter&) = delete;
+
+    YamlWriter& begin_map();
+    YamlWriter& end_map();
+    YamlWriter& begin_seq();
+    YamlWriter& end_seq();
+
+    // Next key of the enclosing map; the following call writes its value.
+    YamlWriter& key(std::string_view k, bool double_quoted = false);
+
+    YamlWriter& value(int v);
+    YamlWriter& value(uint64_t v);
+    YamlWriter& value(double v);
+    YamlWriter& value(std::string_view v);
+
+    // [a, b, ...] on one line.
+    template <typename Range>
+    YamlWriter& flow_seq(const Range& values) {
+        begin_value();
+        buf_ += '[';
+        bool first = true;
+        for (const auto& v : values) {
+            if (!first) buf_ += ", ";
+            first = false;
+            put_number(v);
+        }
+        buf_ += ']';
+        return end_value();
+    }
+
+    // Writes out the buffer; throws if anything failed to write.
+    void flush();
+    // Flushes and renames the temporary over the target.
+    void close();
+
+private:
+    struct Level {
+        bool is_map;
+        int indent;
+        size_t count = 0;         // keys or items written
+        bool inline_first;        // starts right after "- "
+    };
+
+    void newline(int indent);
+    void seq_item(bool same_line = true);  // "- " (or "-" and a new line) of the next item
+    void begin_value();           // separator or "- " before a value
+    YamlWriter& end_value();
+    void end_collection(bool is_map);
+    void put_scalar(std::string_view s, bool double_quoted);
+    void put_number(int v);
+    void put_number(uint64_t v);
+    void put_number(double v);
+
+    std::string filename_;
+    std::string tmp_;             // written until close() renames it to filename_
+    std::ofstream out_;
+    std::string buf_;
+    size_t buffer_size_;
+    std::vector<Level> stack_;
+    bool at_start_ = true;        // nothing written yet
+};
+
+#endif // YAML_WRITER_H
@@ -6,8 +6,12 @@
 
 
 #include "binaryreader.h"
+#include "columnarfile.h"
+#include "columnblock.h"
 #include "analysis.h"
 #include "analysisregister.h"
+#include "eventindex.h"
+#include "particlefilter.h"
 
 
 
@@ -26,28 +30,36 @@ public:
     std::unordered_map<std::string, std::vector<double>> doubles;
     std::unordered_map<std::string, std::vector<int32_t>> ints;
     std::vector<int> event_sizes;
-    void on_particle_block(const ParticleBlock& block) override {
-        event_sizes.push_back(block.npart);
-        for (size_t i = 0; i < block.npart; ++i) {
-            for (const auto& [name, info] : quantity_string_map) {
-                if (!layout) throw std::runtime_error("Layout not set");
 
-                const auto& particle = block.particles[i];
-                Quantity q = info.quantity;
+    // Collects only `names` (all quantities of the layout when empty).
+    explicit CollectorAccessor(std::vector<std::string> names = {}) : projection(std::move(names)) {}
 
-                auto offset_it = layout->find(q);
-                if (offset_it == layout->end()) continue;
+    void on_particle_block(const ParticleBlock& block) override {
+        if (!layout) throw std::runtime_error("Layout not set");
+        event_sizes.push_back(block.npart);
 
-                size_t offset = offset_it->second;
-                if (info.type == QuantityType::Double) {
-                    double val;
-                    std::memcpy(&val, particle.data() + offset, sizeof(double));
-                    doubles[name].push_back(val);
-                } else if (info.type == QuantityType::Int32) {
-                    int32_t val;
-                    std::memcpy(&val, particle.data() + offset, sizeof(int32_t));
-                    ints[name].push_back(val);
-                }
+        quantities.clear();
+        if (projection.empty()) {
+            for (const auto& [q, offset] : *layout) quantities.push_back(q);
+        } else {
+            for (const auto& name : projection) {
+                auto it = quantity_string_map.find(name);
+                if (it == quantity_string_map.end()) throw std::runtime_error("Unknown quantity: " + name);
+                quantities.push_back(it->second.quantity);
+            }
+        }
+        columns.decode(block, *layout, quantities);
+
+        for (Quantity q : quantities) {
+            const std::string& name = quantity_name(q);
+            if (quantity_type(q) == QuantityType::Double) {
+                auto col = columns.doubles(q);
+                auto& out = doubles[name];
+                out.insert(out.end(), col.begin(), col.end());
+            } else {
+                auto col = columns.ints(q);
+                auto& out = ints[name];
+                out.insert(out.end(), col.begin(), col.end());
             }
         }
     }
@@ -61,6 +73,10 @@ public:
     }
     const std::vector<int>& get_event_sizes() const {return event_sizes;}
 
+private:
+    std::vector<std::string> projection;
+    ColumnBlock columns;
+    std::vector<Quantity> quantities;
 };
 
 
@@ -73,7 +89,7 @@ public:
         py::gil_scoped_acquire gil;
 
         for (size_t i = 0; i < block.npart; ++i) {
-            const auto& particle = block.particles[i];
+            const char* particle = block.particle(i);
             py::dict d;
 
             for (const auto& [quantity, offset] : *layout) {
@@ -90,11 +106,11 @@ public:
 
                 if (info.type == QuantityType::Double) {
                     double val;
-                    std::memcpy(&val, particle.data() + offset, sizeof(double));
+                    std::memcpy(&val, particle + offset, sizeof(double));
                     d[py::str(name)] = val;
                 } else if (info.type == QuantityType::Int32) {
                     int32_t val;
-                    std::memcpy(&val, particle.data() + offset, sizeof(int32_t));
+                    std::memcpy(&val, particle + offset, sizeof(int32_t));
                     d[py::str(name)] = val;
                 }
             }
@@ -128,44 +144,191 @@ public:
     void on_end_block(const EndBlock& block) override {
         PYBIND11_OVERRIDE(void, Accessor, on_end_block, block);
     }
+
+    void on_interaction_block(const InteractionBlock& block) override {
+        PYBIND11_OVERRIDE(void, Accessor, on_interaction_block, block);
+    }
 };
 
 PYBIND11_MODULE(bark, m) {
 
-m.def("run_analysis", &run_analysis,
+    py::enum_<ReadMode>(m, "ReadMode")
+        .value("Stream", ReadMode::Stream)
+        .value("Mmap", ReadMode::Mmap)
+        .value("ReadAhead", ReadMode::ReadAhead);
+
+    py::class_<EventRange>(m, "EventRange")
+        .def(py::init<>())
+        .def(py::init([](int32_t first, int32_t last) { return EventRange{first, last}; }),
+             py::arg("first"), py::arg("last"))
+        .def_readwrite("first", &EventRange::first)
+        .def_readwrite("last", &EventRange::last);
+
+    py::class_<ParticleFilter::Cut>(m, "Cut")
+        .def(py::init([](const std::string& quantity, double min, double max, bool absolute) {
+                 auto it = quantity_string_map.find(quantity);
+                 if (it == quantity_string_map.end()) throw std::runtime_error("Unknown quantity: " + quantity);
+                 return ParticleFilter::Cut{it->second.quantity, min, max, absolute};
+             }),
+             py::arg("quantity"),
+             py::arg("min") = -std::numeric_limits<double>::infinity(),
+             py::arg("max") = std::numeric_limits<double>::infinity(),
+             py::arg("absolute") = false)
+        .def_readwrite("min", &ParticleFilter::Cut::min)
+        .def_readwrite("max", &ParticleFilter::Cut::max)
+        .def_readwrite("absolute", &ParticleFilter::Cut::absolute);
+
+    py::class_<ParticleFilter>(m, "ParticleFilter")
+        .def(py::init<>())
+        .def_readwrite("pdgs", &ParticleFilter::pdgs)
+        .def_readwrite("charges", &ParticleFilter::charges)
+        .def_readwrite("cuts", &ParticleFilter::cuts);
+
+    py::class_<EventIndex>(m, "EventIndex")
+        .def_static("build", &EventIndex::build, py::arg("filename"), py::arg("particle_size"))
+        .def_static("load", &EventIndex::load, py::arg("index_filename"))
+        .def_static("open", &EventIndex::open,
+                    py::arg("filename"), py::arg("particle_size"), py::arg("write_sidecar") = true)
+        .def("save", &EventIndex::save, py::arg("index_filename"))
+        .def("event_count", &EventIndex::event_count)
+        .def("particle_block_count", &EventIndex::particle_block_count)
+        .def("interaction_block_count", &EventIndex::interaction_block_count)
+        .def("particle_count", &EventIndex::particle_count)
+        .def("split", &EventIndex::split, py::arg("parts"))
+        .def("__len__", &EventIndex::size);
+
+    m.def("compute_particle_size", &compute_particle_size, py::arg("quantities"));
+    py::class_<ConvertOptions>(m, "ConvertOptions")
+        .def(py::init<>())
+        .def_readwrite("chunk_events", &ConvertOptions::chunk_events)
+        .def_readwrite("stats", &ConvertOptions::stats);
+
+    m.def("columnar_path", &columnar_path, py::arg("filename"));
+    m.def("convert_to_columnar", &convert_to_columnar,
+          py::arg("input"), py::arg("output"),
+          py::arg("quantities") = std::vector<std::string>{},
+          py::arg("options") = ConvertOptions{},
+          py::call_guard<py::gil_scoped_release>());
+
+    m.def("file_quantities", [](const std::string& filename) {
+        return smash_quantities(read_file_header(filename));
+    }, py::arg("filename"));
+
+    py::enum_<OutputFormat>(m, "OutputFormat")
+        .value("Yaml", OutputFormat::Yaml)
+        .value("Binary", OutputFormat::Binary)
+        .value("Both", OutputFormat::Both);
+
+    py::class_<ShardSpec> shard_spec(m, "ShardSpec");
+    py::enum_<ShardSpec::Mode>(shard_spec, "Mode")
+        .value("Files", ShardSpec::Mode::Files)
+        .value("Events", ShardSpec::Mode::Events);
+    shard_spec
+        .def(py::init<>())
+        .def_readwrite("index", &ShardSpec::index)
+        .def_readwrite("count", &ShardSpec::count)
+        .def_readwrite("mode", &ShardSpec::mode);
+    m.def("parse_shard", &parse_shard, py::arg("spec"));
+
+    py::class_<CheckpointOptions>(m, "CheckpointOptions")
+        .def(py::init<>())
+        .def_readwrite("path", &CheckpointOptions::path)
+        .def_readwrite("interval", &CheckpointOptions::interval)
+        .def_readwrite("resume", &CheckpointOptions::resume);
+
+    using RunMany = void (*)(const std::vector<std::pair<std::string, std::string>>&,
+                             const std::vector<std::string>&, const std::vector<std::string>&,
+                             bool, bool, const std::string&, ReadMode, int, int, EventRange,
+                             const ParticleFilter&, const std::string&,
+                             const CheckpointOptions&, OutputFormat, const ShardSpec&);
+    using RunOne = void (*)(const std::vector<std::pair<std::string, std::string>>&,
+                            const std::string&, const std::vector<std::string>&,
+                            bool, bool, const std::string&, ReadMode, int, int, EventRange,
+                            const ParticleFilter&, const std::string&,
+                            const CheckpointOptions&, OutputFormat, const ShardSpec&);
+
+    m.def("run_analysis", static_cast<RunOne>(&run_analysis),
       py::arg("file_and_meta"),
       py::arg("analysis_name"),
       py::arg("quantities"),
       py::arg("save_output") = true,
       py::arg("print_output") = true,
-      py::arg("output_folder") = ".");
+      py::arg("output_folder") = ".",
+      py::arg("read_mode") = ReadMode::Stream,
+      py::arg("threads") = 1,
+      py::arg("block_workers") = 1,
+      py::arg("events") = EventRange{},
+      py::arg("filter") = ParticleFilter{},
+      py::arg("cache_dir") = "",
+      py::arg("checkpoint") = CheckpointOptions{},
+      py::arg("output_format") = OutputFormat::Yaml,
+      py::arg("shard") = ShardSpec{},
+      py::call_guard<py::gil_scoped_release>());
+
+    // Several analyses dispatched from a single read of each file.
+    m.def("run_analysis", static_cast<RunMany>(&run_analysis),
+      py::arg("file_and_meta"),
+      py::arg("analysis_names"),
+      py::arg("quantities"),
+      py::arg("save_output") = true,
+      py::arg("print_output") = true,
+      py::arg("output_folder") = ".",
+      py::arg("read_mode") = ReadMode::Stream,
+      py::arg("threads") = 1,
+      py::arg("block_workers") = 1,
+      py::arg("events") = EventRange{},
+      py::arg("filter") = ParticleFilter{},
+      py::arg("cache_dir") = "",
+      py::arg("checkpoint") = CheckpointOptions{},
+      py::arg("output_format") = OutputFormat::Yaml,
+      py::arg("shard") = ShardSpec{},
+      py::call_guard<py::gil_scoped_release>());
+
 
 
     py::class_<ParticleBlock>(m, "ParticleBlock")
         .def_readonly("event_number", &ParticleBlock::event_number)
         .def_readonly("ensamble_number", &ParticleBlock::ensamble_number)
-        .def_readonly("npart", &ParticleBlock::npart);
+        .def_readonly("npart", &ParticleBlock::npart)
+        .def_readonly("particle_size", &ParticleBlock::particle_size)
+        .def("__len__", &ParticleBlock::size);
 
     py::class_<EndBlock>(m, "EndBlock")
         .def_readonly("event_number", &EndBlock::event_number)
         .def_readonly("impact_parameter", &EndBlock::impact_parameter);
 
+    py::class_<InteractionBlock>(m, "InteractionBlock")
+        .def_readonly("n_in", &InteractionBlock::n_in)
+        .def_readonly("n_out", &InteractionBlock::n_out)
+        .def_readonly("density", &InteractionBlock::density)
+        .def_readonly("total_weight", &InteractionBlock::total_weight)
+        .def_readonly("partial_weight", &InteractionBlock::partial_weight)
+        .def_readonly("process_type", &InteractionBlock::process_type)
+        .def("__len__", &InteractionBlock::size);
+
     py::class_<Accessor, PyAccessor, std::shared_ptr<Accessor>>(m, "Accessor")
         .def(py::init<>())
         .def("on_particle_block", &Accessor::on_particle_block)
         .def("on_end_block", &Accessor::on_end_block)
+        .def("on_interaction_block", &Accessor::on_interaction_block)
         .def("get_int", &Accessor::get_int)
         .def("get_double", &Accessor::get_double);
     py::class_<BinaryReader>(m, "BinaryReader")
-        .def(py::init<const std::string&, const std::vector<std::string>&, std::shared_ptr<Accessor>>())
-        .def("read", &BinaryReader::read);
+        .def(py::init<const std::string&, const std::vector<std::string>&, std::shared_ptr<Accessor>, ReadMode>(),
+             py::arg("filename"), py::arg("quantities"), py::arg("accessor"),
+             py::arg("mode") = ReadMode::Stream)
+        .def("read", &BinaryReader::read)
+        .def("set_event_range", &BinaryReader::set_event_range,
+             py::arg("range"), py::arg("index") = nullptr,
+             py::keep_alive<1, 3>())
+        .def("set_filter", &BinaryReader::set_filter, py::arg("filter"));
 
   py::class_<DictCollectorAccessor, Accessor, std::shared_ptr<DictCollectorAccessor>>(m, "DictCollectorAccessor")
     .def(py::init<>())
     .def("get_particle_dicts", &DictCollectorAccessor::get_particle_dicts);
 
     py::class_<CollectorAccessor, Accessor, std::shared_ptr<CollectorAccessor>>(m, "CollectorAccessor")
-        .def(py::init<>())
+        .def(py::init<std::vector<std::string>>(), py::arg("quantities") = std::vector<std::string>{})
         .def("get_double_array", [](const CollectorAccessor& self, const std::string& name) {
             const auto& vec = self.get_double_array(name);
             return py::array(vec.size(), vec.data());
@@ -0,0 +1,200 @@
+#include "accumulators.h"
+
+#include <numbers>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+// k1 scale function of the t-digest and its inverse: centroids may span at
+// most one unit of k, which keeps them small near q = 0 and q = 1.
+double k_of_q(double q, double compression) {
+    q = std::clamp(q, 0.0, 1.0);
+    return compression / (2 * std::numbers::pi) * std::asin(2 * q - 1);
+}
+
+double q_of_k(double k, double compression) {
+    if (k >= compression / 4) return 1.0;
+    return (std::sin(k * 2 * std::numbers::pi / compression) + 1) / 2;
+}
+} // namespace
+
+QuantileSketch::QuantileSketch(double compression) : compression_(compression) {
+    if (!(compression > 0)) throw std::invalid_argument("Quantile sketch compression must be positive.");
+}
+
+QuantileSketch::QuantileSketch(double compression, double total_weight, double min, double max,
+                               std::vector<Centroid> centroids, std::vector<Centroid> buffer)
+    : QuantileSketch(compression)
+{
+    total_weight_ = total_weight;
+    min_ = min;
+    max_ = max;
+    centroids_ = std::move(centroids);
+    buffer_ = std::move(buffer);
+}
+
+void QuantileSketch::compress() {
+    if (buffer_.empty()) return;
+
+    std::vector<Centroid> all;
+    all.reserve(centroids_.size() + buffer_.size());
+    all.insert(all.end(), centroids_.begin(), centroids_.end());
+    all.insert(all.end(), buffer_.begin(), buffer_.end());
+    std::stable_sort(all.begin(), all.end(),
+                     [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+
+    double total = 0.0;
+    for (const Centroid& c : all) total += c.weight;
+
+    // Greedily merge neighbours while the centroid stays within one unit of k.
+    std::vector<Centroid> merged;
+    merged.reserve(static_cast<size_t>(compression_ * 2) + 8);
+    Centroid current = all.front();
+    double weight_so_far = 0.0;
+    double limit = total * q_of_k(k_of_q(0.0, compression_) + 1, compression_);
+    for (size_t i = 1; i < all.size(); ++i) {
+        const Centroid& c = all[i];
+        if (weight_so_far + current.weight + c.weight <= limit) {
+            current.weight += c.weight;
+            current.mean += (c.mean - current.mean) * c.weight / current.weight;
+        } else {
+            weight_so_far += current.weight;
+            merged.push_back(current);
+            limit = total * q_of_k(k_of_q(weight_so_far / total, compression_) + 1, compression_);
+            current = c;
+        }
+    }
+    merged.push_back(current);
+
+    centroids_ = std::move(merged);
+    buffer_.clear();
+}
+
+QuantileSketch& QuantileSketch::operator+=(const QuantileSketch& other) {
+    if (this == &other) {
+        const QuantileSketch copy(other);
+        return *this += copy;
+    }
+    if (other.centroids_.empty() && other.buffer_.empty()) return *this;
+    buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+    buffer_.insert(buffer_.end(), other.buffer_.begin(), other.buffer_.end());
+    total_weight_ += other.total_weight_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    compress();
+    return *this;
+}
+
+double QuantileSketch::quantile(double q) const {
+    if (!buffer_.empty()) {
+        QuantileSketch compressed(*this);
+        compressed.compress();
+        return compressed.quantile(q);
+    }
+    if (centroids_.empty()) return std::numeric_limits<double>::quiet_NaN();
+    if (q <= 0) return min_;
+    if (q >= 1) return max_;
+    if (centroids_.size() == 1) return centroids_.front().mean;
+
+    double total = 0.0;
+    for (const Centroid& c : centroids_) total += c.weight;
+    const double target = q * total;
+
+    // Each centroid's weight is centred on its mean; interpolate linearly
+    // between neighbouring centres, and towards min/max beyond the outer ones.
+    const Centroid& first = centroids_.front();
+    if (target < first.weight / 2) {
+        return min_ + (first.mean - min_) * target / (first.weight / 2);
+    }
+    double centre = first.weight / 2;
+    for (size_t i = 0; i + 1 < centroids_.size(); ++i) {
+        const double step = (centroids_[i].weight + centroids_[i + 1].weight) / 2;
+        if (target < centre + step) {
+            const double t = (target - centre) / step;
+            return centroids_[i].mean + t * (centroids_[i + 1].mean - centroids_[i].mean);
+        }
+        centre += step;
+    }
+    const Centroid& last = centroids_.back();
+    const double t = std::min(1.0, (target - centre) / (last.weight / 2));
+    return last.mean + t * (max_ - last.mean);
+}
+
+// ---- YAML ----
+void to_yaml(YAML::Emitter& out, const RunningMoments& m) {
+    out << YAML::BeginMap;
+    out << YAML::Key << "count"    << YAML::Value << m.count();
+    out << YAML::Key << "mean"     << YAML::Value << m.mean();
+    out << YAML::Key << "variance" << YAML::Value << m.variance();
+    out << YAML::EndMap;
+}
+
+void to_yaml(YAML::Emitter& out, const MinMax& m) {
+    out << YAML::BeginMap;
+    out << YAML::Key << "count" << YAML::Value << m.count();
+    out << YAML::Key << "min"   << YAML::Value << m.min();
+    out << YAML::Key << "max"   << YAML::Value << m.max();
+    out << YAML::EndMap;
+}
+
+void to_yaml(YAML::Emitter& out, const KahanSum& s) {
+    out << YAML::BeginMap;
+    out << YAML::Key << "count" << YAML::Value << s.count();
+    out << YAML::Key << "sum"   << YAML::Value << s.sum();
+    out << YAML::EndMap;
+}
+
+void to_yaml(YAML::Emitter& out, const QuantileSketch& s) {
+    QuantileSketch compressed(s);
+    compressed.compress();
+
+    out << YAML::BeginMap;
+    out << YAML::Key << "weight" << YAML::Value << s.total_weight();
+    out << YAML::Key << "min"    << YAML::Value << s.min();
+    out << YAML::Key << "max"    << YAML::Value << s.max();
+    out << YAML::Key << "levels" << YAML::Value << YAML::Flow << YAML::BeginSeq;
+    for (double q : sketch_yaml_levels) out << q;
+    out << YAML::EndSeq;
+    out << YAML::Key << "quantiles" << YAML::Value << YAML::Flow << YAML::BeginSeq;
+    for (double q : sketch_yaml_levels) out << compressed.quantile(q);
+    out << YAML::EndSeq;
+    out << YAML::EndMap;
+}
+
+void to_yaml(YamlWriter& out, const RunningMoments& m) {
+    out.begin_map();
+    out.key("count").value(m.count());
+    out.key("mean").value(m.mean());
+    out.key("variance").value(m.variance());
+    out.end_map();
+}
+
+void to_yaml(YamlWriter& out, const MinMax& m) {
+    out.begin_map();
+    out.key("count").value(m.count());
+    out.key("min").value(m.min());
+    out.key("max").value(m.max());
+    out.end_map();
+}
+
+void to_yaml(YamlWriter& out, const KahanSum& s) {
+    out.begin_map();
+    out.key("count").value(s.count());
+    out.key("sum").value(s.sum());
+    out.end_map();
+}
+
+void to_yaml(YamlWriter& out, const QuantileSketch& s) {
+    QuantileSketch compressed(s);
+    compressed.compress();
+    std::vector<double> quantiles;
+    for (double q : sketch_yaml_levels) quantiles.push_back(compressed.quantile(q));
+
+    out.begin_map();
+    out.key("weight").value(s.total_weight());
+    out.key("min").value(s.min());
+    out.key("max").value(s.max());
+    out.key("levels").flow_seq(sketch_yaml_levels);
+    out.key("quantiles").flow_seq(quantiles);
+    out.end_map();
+}
@@ -1,10 +1,24 @@
 #include "analysis.h"
 #include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include "analysisregister.h"
+#include "checkpoint.h"
+#include "columnarfile.h"
+#include "partialresult.h"
+#include "eventindex.h"
+#include "orderedparallel.h"
+#include "pipeline.h"
+#include "resultcache.h"
 
 // YAML serialization
 void to_yaml(YAML::Emitter& out, const MergeKeyValue& v) {
@@ -13,7 +27,17 @@ void to_yaml(YAML::Emitter& out, const MergeKeyValue& v) {
     }, v);
 }
 
+void to_yaml(YamlWriter& out, const MergeKeyValue& v) {
+    std::visit([&](const auto& val) {
+        out.value(val);
+    }, v);
+}
+
 // Analysis methods
+Analysis::Analysis(TreeAllocation allocation)
+    : arena(allocation == TreeAllocation::Arena ? std::make_unique<DataArena>() : nullptr),
+      dataNode(arena ? DataNode::allocator_type(arena.get()) : DataNode::allocator_type()) {}
+
 Analysis& Analysis::operator+=(const Analysis& other) {
     if (this->keys != other.get_merge_keys()) {
         throw std::runtime_error("Cannot merge Analysis objects: MergeKey mismatch.");
@@ -23,6 +47,27 @@ Analysis& Analysis::operator+=(const Analysis& other) {
     return *this;
 }
 
+Analysis& Analysis::operator+=(Analysis&& other) {
+    if (this->keys != other.get_merge_keys()) {
+        throw std::runtime_error("Cannot merge Analysis objects: MergeKey mismatch.");
+    }
+
+    this->dataNode += std::move(other.dataNode);
+    return *this;
+}
+
+void Analysis::merge_from(const std::vector<Analysis*>& others, int n_threads) {
+    std::vector<DataNode*> trees;
+    trees.reserve(others.size());
+    for (Analysis* other : others) {
+        if (this->keys != other->get_merge_keys()) {
+            throw std::runtime_error("Cannot merge Analysis objects: MergeKey mismatch.");
+        }
+        trees.push_back(&other->dataNode);
+    }
+    merge_trees(dataNode, trees, n_threads);
+}
+
 void Analysis::set_merge_keys(MergeKeySet k) {
     keys = std::move(k);
 }
@@ -35,34 +80,38 @@ void Analysis::on_header(Header& header) {
     smash_version = header.smash_version;
 }
 
+void Analysis::restore(const std::string& smash_version_in, const DataNode& data) {
+    smash_version = smash_version_in;
+    dataNode += data;
+}
+
 void Analysis::save_as_yaml(const std::string& filename) const {
-    YAML::Emitter out;
-    out << YAML::BeginMap;
-    out << YAML::Key << "smash_version" << YAML::Value << smash_version;
+    YamlWriter out(filename);
+    out.begin_map();
+    out.key("smash_version").value(smash_version);
 
-    out << YAML::Key << "merge_keys" << YAML::Value << YAML::BeginMap;
+    out.key("merge_keys").begin_map();
     for (const auto& [k, v] : keys) {
-        out << YAML::Key << k << YAML::Value;
+        out.key(k);
         to_yaml(out, v);
     }
-    out << YAML::EndMap;
+    out.end_map();
 
-    out << YAML::Key << "data" << YAML::Value;
-    if (dataNode.empty()) {
-        out << YAML::BeginMap << YAML::EndMap;
-    } else {
-        out << YAML::BeginMap;
-        for (const auto& [k, v] : dataNode.children()) {
-            out << YAML::Key << YAML::DoubleQuoted << k << YAML::Value;
-            to_yaml(out, v);
+    out.key("data").begin_map();
+    for (const auto& [k, v] : dataNode.children()) {
+        out.key(k, true);
+        if (v.is_leaf()) {
+            to_yaml(out, v.get_data());
+        } else {
+            out.begin_map();
+            for (const auto& [_, child] : v.children()) to_yaml(out, child);
+            out.end_map();
         }
-        out << YAML::EndMap;
     }
+    out.end_map();
 
-    out << YAML::EndMap;
-
-    std::ofstream fout(filename);
-    fout << out.c_str();
+    out.end_map();
+    out.close();
 }
 
 // DispatchingAccessor methods
@@ -71,8 +120,15 @@ void DispatchingAccessor::register_analysis(std::shared_ptr<Analysis> analysis)
 }
 
 void DispatchingAccessor::on_particle_block(const ParticleBlock& block) {
-    for (auto& a : analyses) {
-        a->analyze_particle_block(block, *this);
+    if (!column_union.empty()) {
+        column_block.decode(block, get_layout(), column_union);
+    }
+    for (size_t k = 0; k < analyses.size(); ++k) {
+        if (columnar[k]) {
+            analyses[k]->analyze_columns(column_block);
+        } else {
+            analyses[k]->analyze_particle_block(block, *this);
+        }
     }
 }
 
@@ -80,20 +136,372 @@ void DispatchingAccessor::on_end_block(const EndBlock&) {
     // optional
 }
 
+void DispatchingAccessor::on_interaction_block(const InteractionBlock& block) {
+    for (auto& a : analyses) a->analyze_interaction_block(block, *this);
+}
+
 void DispatchingAccessor::on_header(Header& header) {
-    for (auto& a : analyses) {
+    for (Quantity q : required_quantities()) {
+        if (!get_layout().count(q)) {
+            throw std::runtime_error("Quantity not in layout: " + quantity_name(q));
+        }
+    }
+
+    columnar.assign(analyses.size(), 0);
+    column_union.clear();
+    for (size_t k = 0; k < analyses.size(); ++k) {
+        auto& a = analyses[k];
         a->on_header(header);
+        a->on_layout(*this);
+
+        for (Quantity q : a->columns()) {
+            if (!get_layout().count(q)) {
+                throw std::runtime_error("Quantity not in layout: " + quantity_name(q));
+            }
+            columnar[k] = 1;
+            if (std::find(column_union.begin(), column_union.end(), q) == column_union.end()) {
+                column_union.push_back(q);
+            }
+        }
+    }
+}
+
+std::vector<Quantity> DispatchingAccessor::required_quantities() const {
+    std::vector<Quantity> all;
+    for (const auto& a : analyses) {
+        for (Quantity q : a->required_quantities()) {
+            if (std::find(all.begin(), all.end(), q) == all.end()) all.push_back(q);
+        }
+    }
+    return all;
+}
+
+namespace {
+// Restricts the reader to `events`, seeking through the file's event index
+// (loaded from or written to its sidecar).
+void apply_event_range(BinaryReader& reader, const std::string& path,
+                       const EventRange& events, std::optional<EventIndex>& index)
+{
+    if (events.is_all()) return;
+    if (reader.is_columnar()) {
+        reader.set_event_range(events);
+        return;
+    }
+    index = EventIndex::open(path, reader.get_particle_size());
+    reader.set_event_range(events, &*index);
+}
+
+std::vector<std::shared_ptr<Analysis>> create_analyses(const std::vector<std::string>& analysis_names,
+                                                       const MergeKeySet& key)
+{
+    std::vector<std::shared_ptr<Analysis>> analyses;
+    analyses.reserve(analysis_names.size());
+    for (const auto& name : analysis_names) {
+        auto analysis = AnalysisRegistry::instance().create(name);
+        if (!analysis) throw std::runtime_error("Unknown analysis: " + name);
+        analysis->set_merge_keys(key);
+        analyses.push_back(std::move(analysis));
+    }
+    return analyses;
+}
+
+std::vector<std::shared_ptr<Analysis>> analyze_file_pipelined(const std::string& path,
+                                                              const MergeKeySet& key,
+                                                              const std::vector<std::string>& analysis_names,
+                                                              const std::vector<std::string>& quantities,
+                                                              ReadMode read_mode,
+                                                              int block_workers,
+                                                              const EventRange& events,
+                                                              const ParticleFilter& filter)
+{
+    std::vector<std::vector<std::shared_ptr<Analysis>>> clones;
+    clones.reserve(block_workers);
+    for (int w = 0; w < block_workers; ++w) {
+        clones.push_back(create_analyses(analysis_names, key));
+    }
+
+    auto pipeline = std::make_shared<PipelinedAccessor>(std::move(clones));
+    BinaryReader reader(path, quantities, pipeline, read_mode);
+    std::optional<EventIndex> index;
+    apply_event_range(reader, path, events, index);
+    reader.set_filter(filter);
+    try {
+        reader.read();
+    } catch (...) {
+        pipeline->abort();
+        throw;
+    }
+    return pipeline->finish();
+}
+
+// Runs all analyses over one file in a single pass; one result per name.
+std::vector<std::shared_ptr<Analysis>> analyze_file(const std::string& path,
+                                                    const MergeKeySet& key,
+                                                    const std::vector<std::string>& analysis_names,
+                                                    const std::vector<std::string>& quantities,
+                                                    ReadMode read_mode,
+                                                    int block_workers,
+                                                    const EventRange& events,
+                                                    const ParticleFilter& filter)
+{
+    if (block_workers > 1) {
+        return analyze_file_pipelined(path, key, analysis_names, quantities, read_mode,
+                                      block_workers, events, filter);
+    }
+
+    auto analyses = create_analyses(analysis_names, key);
+
+    auto dispatcher = std::make_shared<DispatchingAccessor>();
+    for (auto& analysis : analyses) dispatcher->register_analysis(analysis);
+
+    BinaryReader reader(path, quantities, dispatcher, read_mode);
+    std::optional<EventIndex> index;
+    apply_event_range(reader, path, events, index);
+    reader.set_filter(filter);
+    reader.read();
+    return analyses;
+}
+
+// Everything besides the input file that changes a partial result.
+std::string cache_config(const std::vector<std::string>& quantities,
+                         const EventRange& events,
+                         const ParticleFilter& filter)
+{
+    std::ostringstream c;
+    c.precision(17);
+    c << "q=";
+    for (const auto& q : quantities) c << q << ',';
+    c << ";events=" << events.first << ':' << events.last << ";pdg=";
+    for (int32_t v : filter.pdgs) c << v << ',';
+    c << ";charge=";
+    for (int32_t v : filter.charges) c << v << ',';
+    c << ";cuts=";
+    for (const auto& cut : filter.cuts) {
+        c << quantity_name(cut.quantity) << (cut.absolute ? "|abs" : "")
+          << ':' << cut.min << ':' << cut.max << ',';
+    }
+    return c.str();
+}
+
+// config_id() of each analysis.
+std::vector<std::string> config_ids(const std::vector<std::string>& analysis_names) {
+    std::vector<std::string> ids;
+    for (const auto& analysis : create_analyses(analysis_names, {})) ids.push_back(analysis->config_id());
+    return ids;
+}
+
+// All config_id()s in one string, for what identifies a whole run.
+std::string analyses_config(const std::vector<std::string>& ids) {
+    std::string c = ";analyses=";
+    for (const auto& id : ids) {
+        c += id;
+        c += ',';
+    }
+    return c;
+}
+
+// analyze_file with cached partials: analyses with a cache entry for this
+// file are restored, only the rest read the file.
+std::vector<std::shared_ptr<Analysis>> analyze_file_cached(const ResultCache& cache,
+                                                           const std::string& config,
+                                                           const std::string& path,
+                                                           const MergeKeySet& key,
+                                                           const std::vector<std::string>& analysis_names,
+                                                           const std::vector<std::string>& quantities,
+                                                           ReadMode read_mode,
+                                                           int block_workers,
+                                                           const EventRange& events,
+                                                           const ParticleFilter& filter)
+{
+    const std::string fingerprint = ResultCache::file_fingerprint(path);
+    std::vector<std::shared_ptr<Analysis>> analyses = create_analyses(analysis_names, key);
+    std::vector<std::string> keys;
+    std::vector<std::string> missing;
+    std::vector<size_t> missing_index;
+    for (size_t a = 0; a < analysis_names.size(); ++a) {
+        keys.push_back(ResultCache::make_key(fingerprint, analysis_names[a],
+                                             analyses[a]->config_id(), config));
+        if (!cache.load(keys[a], *analyses[a])) {
+            missing.push_back(analysis_names[a]);
+            missing_index.push_back(a);
+        }
+    }
+    if (missing.empty()) return analyses;
+
+    auto fresh = analyze_file(path, key, missing, quantities, read_mode, block_workers, events, filter);
+    for (size_t m = 0; m < missing.size(); ++m) {
+        cache.store(keys[missing_index[m]], *fresh[m]);
+        analyses[missing_index[m]] = std::move(fresh[m]);
+    }
+    return analyses;
+}
+
+// Merges `analysis` into the entry for `key`, keeping `entries` sorted.
+void merge_entry(std::vector<Entry>& entries, const MergeKeySet& key, std::shared_ptr<Analysis> analysis) {
+    auto it = std::lower_bound(entries.begin(), entries.end(), key,
+        [](Entry const& e, MergeKeySet const& x){ return e.key < x; });
+    if (it == entries.end() || it->key < key || key < it->key) {
+        entries.insert(it, Entry{key, std::move(analysis)});
+    } else {
+        *it->analysis += std::move(*analysis);
     }
 }
 
+// <= 0: one per hardware thread; never more than there are items.
+int effective_threads(int n_threads, size_t n_items) {
+    if (n_threads <= 0) n_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    return static_cast<int>(std::min<size_t>(n_threads, std::max<size_t>(n_items, 1)));
+}
+
+// Writes the unfinalized partials, then finalizes, prints and exports YAML.
+// Each entry goes to the YAML file as soon as it is finalized. Output files
+// are named <analysis><tag>.{bark,yaml}. The partials record the run config
+// and config_id() given per analysis in `configs` and `ids`.
+void write_results(const std::vector<std::string>& analysis_names,
+                   std::vector<std::vector<Entry>>& results,
+                   const std::vector<ShardProvenance>& provenance,
+                   const std::vector<std::string>& configs,
+                   const std::vector<std::string>& ids,
+                   const std::string& tag,
+                   bool save_output,
+                   bool print_output,
+                   const std::string& output_folder,
+                   OutputFormat format)
+{
+    for (size_t a = 0; a < analysis_names.size(); ++a) {
+        const std::filesystem::path stem = std::filesystem::path(output_folder) / (analysis_names[a] + tag);
+        if (save_output && format != OutputFormat::Yaml) {
+            PartialResult{analysis_names[a], provenance[a], configs[a], ids[a], results[a]}
+                .save(stem.string() + ".bark");
+        }
+
+        std::optional<YamlWriter> yaml;
+        if (save_output && format != OutputFormat::Binary) {
+            yaml.emplace(stem.string() + ".yaml");
+            yaml->begin_map().key("results").begin_seq();
+        }
+
+        for (auto& e : results[a]) {
+            e.analysis->finalize();
+            if (print_output) {
+                const std::string label = label_from_keyset(e.key);
+                std::cout << "=== " << (analysis_names.size() > 1 ? analysis_names[a] + " result" : "Result")
+                          << " for " << (label.empty() ? "(no key)" : label) << " ===\n";
+                e.analysis->print_result_to(std::cout);
+            }
+            if (yaml) to_yaml(*yaml, e);
+        }
+
+        if (yaml) {
+            yaml->end_seq().end_map();
+            yaml->close();
+        }
+    }
+}
+
+// Identifies a sharded run: every task of a job array derives the same id
+// from the same inputs and settings.
+std::string shard_run_id(const std::vector<std::pair<std::string, std::string>>& file_and_meta,
+                         const std::string& config,
+                         const ShardSpec& shard)
+{
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&](const std::string& text) {
+        for (unsigned char c : text) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        h ^= 0xff;  // separator, so ("ab", "c") and ("a", "bc") differ
+        h *= 1099511628211ull;
+    };
+    for (const auto& [file, meta] : file_and_meta) {
+        mix(file);
+        mix(meta);
+    }
+    mix(config);
+    mix(std::to_string(shard.count) + (shard.mode == ShardSpec::Mode::Events ? "/events" : "/files"));
+
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return buf;
+}
+
+// This shard's events of `path` when sharding by events, or nothing if the
+// file has fewer events than there are shards.
+std::optional<EventRange> shard_event_range(const std::string& path,
+                                            const std::vector<std::string>& quantities,
+                                            const ShardSpec& shard)
+{
+    if (ColumnarFile::is_columnar(path)) {
+        throw std::runtime_error("Sharding by events needs an event index; shard columnar caches by file: " + path);
+    }
+    const Header header = read_file_header(path);
+    const size_t particle_size = compute_particle_size(
+        quantities.empty() ? smash_quantities(header) : quantities);
+    const EventIndex index = EventIndex::open(path, particle_size);
+    // Blocks after the header but no events: every shard would skip the
+    // file, so its data would silently go missing from the merged result.
+    if (index.event_count() == 0 &&
+        index.get_file_size() > Header::FIXED_SIZE + header.smash_version.size()) {
+        throw std::runtime_error("No events found to shard in " + path + "; shard it by file instead");
+    }
+    const auto ranges = index.split(shard.count);
+    if (shard.index >= ranges.size()) return std::nullopt;
+    return ranges[shard.index];
+}
+} // namespace
+
+ShardSpec parse_shard(const std::string& spec) {
+    const auto slash = spec.find('/');
+    if (slash == std::string::npos) throw std::runtime_error("Invalid shard (expected i/N): " + spec);
+    // All of each part must be the number: std::stoul would take "1x", " 1"
+    // and "-1".
+    auto number = [&](const std::string& digits) {
+        uint32_t value = 0;
+        const char* end = digits.data() + digits.size();
+        const auto [ptr, ec] = std::from_chars(digits.data(), end, value);
+        if (ec != std::errc() || ptr != end) throw std::runtime_error("Invalid shard (expected i/N): " + spec);
+        return value;
+    };
+    ShardSpec shard;
+    shard.index = number(spec.substr(0, slash));
+    shard.count = number(spec.substr(slash + 1));
+    if (shard.count == 0 || shard.index >= shard.count) {
+        throw std::runtime_error("Invalid shard (need 0 <= i < N): " + spec);
+    }
+    return shard;
+}
+
+OutputFormat parse_output_format(const std::string& name) {
+    if (name == "yaml") return OutputFormat::Yaml;
+    if (name == "binary") return OutputFormat::Binary;
+    if (name == "both") return OutputFormat::Both;
+    throw std::runtime_error("Unknown output format: " + name + " (expected yaml, binary or both)");
+}
+
 void run_analysis(const std::vector<std::pair<std::string, std::string>>& file_and_meta,
-                  const std::string& analysis_name,
+                  const std::vector<std::string>& analysis_names,
                   const std::vector<std::string>& quantities,
                   bool save_output,
                   bool print_output,
-                  const std::string& output_folder)
+                  const std::string& output_folder,
+                  ReadMode read_mode,
+                  int n_threads,
+                  int block_workers,
+                  EventRange events,
+                  const ParticleFilter& filter,
+                  const std::string& cache_dir,
+                  const CheckpointOptions& checkpoint,
+                  OutputFormat format,
+                  const ShardSpec& shard)
 {
-    if (quantities.empty()) throw std::runtime_error("No quantities provided");
+    if (analysis_names.empty()) throw std::runtime_error("No analysis provided");
+    for (size_t a = 0; a < analysis_names.size(); ++a) {
+        if (std::find(analysis_names.begin(), analysis_names.begin() + a, analysis_names[a])
+                != analysis_names.begin() + a) {
+            throw std::runtime_error("Analysis listed twice: " + analysis_names[a]);
+        }
+    }
 
     if (save_output) {
         std::error_code ec;
@@ -101,59 +509,257 @@ void run_analysis(const std::vector<std::pair<std::string, std::string>>& file_a
         if (ec) throw std::runtime_error("create_directories failed: " + ec.message());
     }
 
+    const std::string config = cache_config(quantities, events, filter);
+    // The cache folds in config_id() per analysis; shards and checkpoints
+    // cover all analyses at once.
+    const std::vector<std::string> ids = config_ids(analysis_names);
+    const std::string run_config = config + analyses_config(ids);
+
+    // The files this run reads, and what a sharded run records about itself.
+    std::vector<std::pair<std::string, std::string>> inputs = file_and_meta;
+    std::vector<ShardProvenance> provenance(analysis_names.size());
+    std::string tag;
+    const bool shard_events = shard.is_sharded() && shard.mode == ShardSpec::Mode::Events;
+    if (shard.is_sharded()) {
+        if (shard.index >= shard.count) throw std::runtime_error("Shard index out of range");
+        const ShardProvenance mine{shard_run_id(file_and_meta, run_config, shard), shard.count, {shard.index}};
+        provenance.assign(analysis_names.size(), mine);
+        tag = ".shard-" + std::to_string(shard.index) + "-of-" + std::to_string(shard.count);
+        if (shard.mode == ShardSpec::Mode::Files) {
+            const size_t n = file_and_meta.size();
+            inputs.assign(file_and_meta.begin() + n * shard.index / shard.count,
+                          file_and_meta.begin() + n * (shard.index + 1) / shard.count);
+        }
+        format = OutputFormat::Binary;  // a shard alone is not a final result
+    }
+
     std::vector<std::pair<std::string, MergeKeySet>> input_files;
-    input_files.reserve(file_and_meta.size());
-    for (const auto& [file, meta] : file_and_meta) {
+    input_files.reserve(inputs.size());
+    for (const auto& [file, meta] : inputs) {
         MergeKeySet ks = parse_merge_key(meta);
         sort_keyset(ks);
         input_files.emplace_back(file, std::move(ks));
     }
 
-    std::vector<Entry> results;
-    results.reserve(input_files.size());
+    std::optional<ResultCache> cache;
+    if (!cache_dir.empty()) cache.emplace(cache_dir);
+
+    auto process_file = [&](const std::string& path, const MergeKeySet& key)
+            -> std::vector<std::shared_ptr<Analysis>> {
+        EventRange file_events = events;
+        if (shard_events) {
+            const auto range = shard_event_range(path, quantities, shard);
+            if (!range) return {};
+            file_events.first = std::max(events.first, range->first);
+            file_events.last = std::min(events.last, range->last);
+            if (file_events.first >= file_events.last) return {};
+        }
+        if (cache) {
+            const std::string file_config =
+                shard_events ? cache_config(quantities, file_events, filter) : config;
+            return analyze_file_cached(*cache, file_config, path, key, analysis_names, quantities,
+                                       read_mode, block_workers, file_events, filter);
+        }
+        return analyze_file(path, key, analysis_names, quantities,
+                            read_mode, block_workers, file_events, filter);
+    };
+
+    // One sorted result list per analysis.
+    std::vector<std::vector<Entry>> results(analysis_names.size());
 
-    auto find_or_insert = [&](MergeKeySet k) -> std::shared_ptr<Analysis>& {
-        auto it = std::lower_bound(results.begin(), results.end(), k,
-            [](Entry const& e, MergeKeySet const& x){ return e.key < x; });
-        if (it == results.end() || it->key < k || k < it->key) {
-            it = results.insert(it, Entry{std::move(k), nullptr});
+    // Files before `first_file` were merged by an earlier run and are restored
+    // from its checkpoint.
+    size_t first_file = 0;
+    if (checkpoint.resume && !checkpoint.path.empty() && std::filesystem::exists(checkpoint.path)) {
+        Checkpoint cp = Checkpoint::load(checkpoint.path);
+        if (cp.config != run_config + tag || cp.analysis_names != analysis_names) {
+            throw std::runtime_error("Checkpoint " + checkpoint.path + " was written with different settings");
+        }
+        if (cp.completed.size() > inputs.size() ||
+            !std::equal(cp.completed.begin(), cp.completed.end(), inputs.begin())) {
+            throw std::runtime_error("Checkpoint " + checkpoint.path + " was written for different input files");
         }
-        return it->analysis;
+        results = std::move(cp.results);
+        first_file = cp.completed.size();
+    }
+
+    auto last_checkpoint = std::chrono::steady_clock::now();
+    auto save_checkpoint = [&](size_t n_merged) {
+        Checkpoint cp;
+        cp.config = run_config + tag;
+        cp.analysis_names = analysis_names;
+        cp.completed.assign(inputs.begin(), inputs.begin() + n_merged);
+        cp.results = results;
+        cp.save(checkpoint.path);
+        last_checkpoint = std::chrono::steady_clock::now();
+    };
+    auto maybe_checkpoint = [&](size_t n_merged) {
+        if (checkpoint.path.empty()) return;
+        const std::chrono::duration<double> since = std::chrono::steady_clock::now() - last_checkpoint;
+        if (since.count() >= checkpoint.interval) save_checkpoint(n_merged);
     };
 
-    for (auto& [path, key] : input_files) {
-        auto analysis = AnalysisRegistry::instance().create(analysis_name);
-        if (!analysis) throw std::runtime_error("Unknown analysis: " + analysis_name);
+    // Number of files merged into `results` so far, in input order.
+    size_t n_merged = first_file;
+    try {
+        ordered_parallel(first_file, input_files.size(), effective_threads(n_threads, input_files.size()),
+            [&](size_t k) {
+                return process_file(input_files[k].first, input_files[k].second);
+            },
+            [&](size_t k, std::vector<std::shared_ptr<Analysis>> analyses) {
+                for (size_t a = 0; a < analyses.size(); ++a) {
+                    merge_entry(results[a], input_files[k].second, std::move(analyses[a]));
+                }
+                n_merged = k + 1;
+                maybe_checkpoint(n_merged);
+            });
+    } catch (...) {
+        // Keep what was merged, so --resume only redoes the unfinished files.
+        if (!checkpoint.path.empty() && n_merged > first_file) save_checkpoint(n_merged);
+        throw;
+    }
 
-        analysis->set_merge_keys(key);
+    write_results(analysis_names, results, provenance,
+                  std::vector<std::string>(analysis_names.size(), config), ids,
+                  tag, save_output, print_output, output_folder, format);
 
-        auto dispatcher = std::make_shared<DispatchingAccessor>();
-        dispatcher->register_analysis(analysis);
+    if (!checkpoint.path.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(checkpoint.path, ec);
+    }
+}
 
-        BinaryReader reader(path, quantities, dispatcher);
-        reader.read();
+void run_analysis(const std::vector<std::pair<std::string, std::string>>& file_and_meta,
+                  const std::string& analysis_name,
+                  const std::vector<std::string>& quantities,
+                  bool save_output,
+                  bool print_output,
+                  const std::string& output_folder,
+                  ReadMode read_mode,
+                  int n_threads,
+                  int block_workers,
+                  EventRange events,
+                  const ParticleFilter& filter,
+                  const std::string& cache_dir,
+                  const CheckpointOptions& checkpoint,
+                  OutputFormat format,
+                  const ShardSpec& shard)
+{
+    run_analysis(file_and_meta, std::vector<std::string>{analysis_name}, quantities,
+                 save_output, print_output, output_folder, read_mode, n_threads,
+                 block_workers, events, filter, cache_dir, checkpoint, format, shard);
+}
+
+void merge_results(const std::vector<std::string>& inputs,
+                   bool save_output,
+                   bool print_output,
+                   const std::string& output_folder,
+                   int n_threads,
+                   OutputFormat format)
+{
+    if (inputs.empty()) throw std::runtime_error("No partial results provided");
+    if (save_output) {
+        std::error_code ec;
+        std::filesystem::create_directories(output_folder, ec);
+        if (ec) throw std::runtime_error("create_directories failed: " + ec.message());
+    }
 
-        auto& slot = find_or_insert(std::move(key));
-        if (slot) {
-            *slot += *analysis;
+    // Shards of the same run are merged in shard order, whatever order the
+    // files were given in; other inputs keep their order.
+    std::vector<PartialResult> headers;
+    headers.reserve(inputs.size());
+    for (const auto& input : inputs) headers.push_back(PartialResult::load(input, false));
+    std::vector<size_t> order(inputs.size());
+    for (size_t k = 0; k < order.size(); ++k) order[k] = k;
+    std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+        const auto& px = headers[x].provenance;
+        const auto& py = headers[y].provenance;
+        if (px.run != py.run) return px.run < py.run;
+        return (px.shards.empty() ? 0 : px.shards.front()) < (py.shards.empty() ? 0 : py.shards.front());
+    });
+
+    // Analyses in order of first appearance, each with the settings all its
+    // inputs were written with, its sorted results and the shards merged per
+    // sharded run.
+    std::vector<std::string> analysis_names;
+    std::vector<std::string> configs;
+    std::vector<std::string> ids;
+    std::vector<std::vector<Entry>> results;
+    std::vector<std::map<std::string, ShardProvenance>> runs;
+    std::vector<char> unsharded;  // any input without provenance
+
+    // Checked on the headers, before any entries are loaded: results of
+    // different cuts or binnings must not be summed.
+    for (size_t k = 0; k < headers.size(); ++k) {
+        const PartialResult& header = headers[order[k]];
+        auto it = std::find(analysis_names.begin(), analysis_names.end(), header.analysis_name);
+        if (it == analysis_names.end()) {
+            analysis_names.push_back(header.analysis_name);
+            configs.push_back(header.config);
+            ids.push_back(header.analysis_config);
+            results.emplace_back();
+            runs.emplace_back();
+            unsharded.push_back(0);
         } else {
-            slot = std::move(analysis);
+            const size_t a = it - analysis_names.begin();
+            if (header.config != configs[a] || header.analysis_config != ids[a]) {
+                throw std::runtime_error("Partial result " + inputs[order[k]] + " of " + header.analysis_name +
+                                         " was written with different settings");
+            }
         }
     }
 
-    for (auto& e : results) {
-        e.analysis->finalize();
-        if (print_output) {
-            const std::string label = label_from_keyset(e.key);
-            std::cout << "=== Result for " << (label.empty() ? "(no key)" : label) << " ===\n";
-            e.analysis->print_result_to(std::cout);
+    ordered_parallel(0, inputs.size(), effective_threads(n_threads, inputs.size()),
+        [&](size_t k) {
+            return PartialResult::load(inputs[order[k]]);
+        },
+        [&](size_t, PartialResult partial) {
+            const size_t a = std::find(analysis_names.begin(), analysis_names.end(), partial.analysis_name) -
+                             analysis_names.begin();
+
+            const ShardProvenance& from = partial.provenance;
+            if (from.is_sharded()) {
+                ShardProvenance& run = runs[a][from.run];
+                if (run.run.empty()) {
+                    run.run = from.run;
+                    run.shard_count = from.shard_count;
+                } else if (run.shard_count != from.shard_count) {
+                    throw std::runtime_error("Shard counts of " + partial.analysis_name + " inputs differ");
+                }
+                for (uint32_t shard : from.shards) {
+                    auto pos = std::lower_bound(run.shards.begin(), run.shards.end(), shard);
+                    if (pos != run.shards.end() && *pos == shard) {
+                        throw std::runtime_error("Shard " + std::to_string(shard) + "/" +
+                                                 std::to_string(run.shard_count) + " of " +
+                                                 partial.analysis_name + " given twice");
+                    }
+                    run.shards.insert(pos, shard);
+                }
+            } else {
+                unsharded[a] = 1;
+            }
+
+            for (auto& e : partial.entries) {
+                merge_entry(results[a], e.key, std::move(e.analysis));
+            }
+        });
+
+    // A single sharded run stays traceable through staged merges; final
+    // outputs need every shard.
+    std::vector<ShardProvenance> provenance(analysis_names.size());
+    for (size_t a = 0; a < analysis_names.size(); ++a) {
+        for (const auto& [id, run] : runs[a]) {
+            if (format != OutputFormat::Binary && !run.is_complete()) {
+                throw std::runtime_error("Missing " + std::to_string(run.shard_count - run.shards.size()) +
+                                         " of " + std::to_string(run.shard_count) + " shards of " +
+                                         analysis_names[a] + " (merge with --format binary to combine a subset)");
+            }
         }
+        if (runs[a].size() == 1 && !unsharded[a]) provenance[a] = runs[a].begin()->second;
     }
 
-    if (save_output) {
-        std::filesystem::path out = std::filesystem::path(output_folder) / (analysis_name + ".yaml");
-        save_all_to_yaml(out.string(), results);
-    }
+    write_results(analysis_names, results, provenance, configs, ids, "", save_output, print_output,
+                  output_folder, format);
 }
 
 MergeKeySet parse_merge_key(const std::string& meta) {
@@ -208,44 +814,33 @@ std::string label_from_keyset(const MergeKeySet& ks) {
     return oss.str();
 }
 
-void save_all_to_yaml(const std::string& filename,
-                      const std::vector<Entry>& results)
-{
-    YAML::Emitter out;
-    out << YAML::BeginMap;
-    out << YAML::Key << "results" << YAML::Value << YAML::BeginSeq;
+void to_yaml(YamlWriter& out, const Entry& e) {
+    out.begin_map();
 
-    for (const auto& e : results) {
-        out << YAML::BeginMap;
-
-        out << YAML::Key << "merge_keys" << YAML::Value << YAML::BeginMap;
-        for (const auto& kv : e.key) {
-            out << YAML::Key << kv.name << YAML::Value;
-            std::visit([&](auto const& x){ out << x; }, kv.value);
-        }
-        out << YAML::EndMap;
-
-        out << YAML::Key << "smash_version" << YAML::Value
-            << e.analysis->get_smash_version();
+    out.key("merge_keys").begin_map();
+    for (const auto& kv : e.key) {
+        out.key(kv.name);
+        to_yaml(out, kv.value);
+    }
+    out.end_map();
 
-        out << YAML::Key << "data" << YAML::Value;
-        if (e.analysis->get_data().empty()) {
-            out << YAML::BeginMap << YAML::EndMap;
-        } else {
-            out << YAML::BeginMap;
-            for (const auto& [k, v] : e.analysis->get_data().children()) {
-                to_yaml(out, v);
-            }
-            out << YAML::EndMap;
-        }
+    out.key("smash_version").value(e.analysis->get_smash_version());
 
-        out << YAML::EndMap;
+    out.key("data").begin_map();
+    for (const auto& [k, v] : e.analysis->get_data().children()) {
+        to_yaml(out, v);
     }
+    out.end_map();
 
-    out << YAML::EndSeq;
-    out << YAML::EndMap;
+    out.end_map();
+}
 
-    std::ofstream fout(filename);
-    if (!fout) throw std::runtime_error("Failed to open " + filename);
-    fout << out.c_str();
+void save_all_to_yaml(const std::string& filename,
+                      const std::vector<Entry>& results)
+{
+    YamlWriter out(filename);
+    out.begin_map().key("results").begin_seq();
+    for (const auto& e : results) to_yaml(out, e);
+    out.end_seq().end_map();
+    out.close();
 }
@@ -15,7 +15,9 @@ void AnalysisRegistry::register_factory(const std::string& name, Factory factory
 std::shared_ptr<Analysis> AnalysisRegistry::create(const std::string& name) const {
     auto it = factories_.find(name);
     if (it == factories_.end()) throw std::runtime_error("No such analysis: " + name);
-    return it->second();
+    auto analysis = it->second();
+    if (analysis) analysis->set_name(name);
+    return analysis;
 }
 
 std::vector<std::string> AnalysisRegistry::list_registered() const {
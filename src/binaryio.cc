@@ -0,0 +1,45 @@
+#include "binaryio.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+#include <unistd.h>
+
+namespace binaryio {
+
+// <path>.tmp.<pid>.<nonce>.<n>: the pid separates jobs on one host, the
+// nonce jobs on different hosts sharing a file system, n calls within one.
+std::string unique_temp_path(const std::string& path) {
+    static const unsigned nonce = std::random_device{}();
+    static std::atomic<uint64_t> counter{0};
+    return path + ".tmp." + std::to_string(::getpid()) + '.' + std::to_string(nonce) + '.' +
+           std::to_string(counter++);
+}
+
+void replace_file(const std::string& path, const std::function<void(const std::string&)>& write) {
+    const std::string tmp = unique_temp_path(path);
+    try {
+        write(tmp);
+    } catch (...) {
+        std::remove(tmp.c_str());
+        throw;
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+void write_binary_file(const std::string& path, const std::function<void(std::ostream&)>& write) {
+    replace_file(path, [&](const std::string& tmp) {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) throw std::runtime_error("Failed to open " + tmp);
+        write(out);
+        out.close();
+        if (!out) throw std::runtime_error("Failed to write " + path);
+    });
+}
+
+} // namespace binaryio
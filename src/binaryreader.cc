@@ -1,4 +1,7 @@
 #include "binaryreader.h"
+#include "columnarfile.h"
+#include "eventindex.h"
+#include "particlefilter.h"
 
 const std::unordered_map<std::string, QuantityInfo> quantity_string_map = {
     {"mass",   {Quantity::MASS,   QuantityType::Double}},
@@ -9,8 +12,76 @@ const std::unordered_map<std::string, QuantityInfo> quantity_string_map = {
     {"pdg",    {Quantity::PDG,    QuantityType::Int32}},
     {"ncoll",  {Quantity::NCOLL,  QuantityType::Int32}},
     {"charge", {Quantity::CHARGE, QuantityType::Int32}},
+    {"t",      {Quantity::T,      QuantityType::Double}},
+    {"x",      {Quantity::X,      QuantityType::Double}},
+    {"y",      {Quantity::Y,      QuantityType::Double}},
+    {"z",      {Quantity::Z,      QuantityType::Double}},
+    {"id",     {Quantity::ID,     QuantityType::Int32}},
+    {"form_time",        {Quantity::FORM_TIME,        QuantityType::Double}},
+    {"xsecfac",          {Quantity::XSECFAC,          QuantityType::Double}},
+    {"proc_id_origin",   {Quantity::PROC_ID_ORIGIN,   QuantityType::Int32}},
+    {"proc_type_origin", {Quantity::PROC_TYPE_ORIGIN, QuantityType::Int32}},
+    {"time_last_coll",   {Quantity::TIME_LAST_COLL,   QuantityType::Double}},
+    {"pdg_mother1",      {Quantity::PDG_MOTHER1,      QuantityType::Int32}},
+    {"pdg_mother2",      {Quantity::PDG_MOTHER2,      QuantityType::Int32}},
+    {"baryon_number",    {Quantity::BARYON_NUMBER,    QuantityType::Int32}},
+    {"strangeness",      {Quantity::STRANGENESS,      QuantityType::Int32}},
 };
 
+namespace {
+struct QuantityNames {
+    std::array<std::string, quantity_count> names;
+    std::array<QuantityType, quantity_count> types{};
+
+    QuantityNames() {
+        for (const auto& [name, info] : quantity_string_map) {
+            names[static_cast<size_t>(info.quantity)] = name;
+            types[static_cast<size_t>(info.quantity)] = info.type;
+        }
+    }
+};
+
+const QuantityNames& quantity_names() {
+    static const QuantityNames table;
+    return table;
+}
+} // namespace
+
+const std::string& quantity_name(Quantity q) {
+    return quantity_names().names[static_cast<size_t>(q)];
+}
+
+QuantityType quantity_type(Quantity q) {
+    return quantity_names().types[static_cast<size_t>(q)];
+}
+
+ReadMode parse_read_mode(const std::string& name) {
+    if (name == "stream") return ReadMode::Stream;
+    if (name == "mmap")   return ReadMode::Mmap;
+    if (name == "readahead") return ReadMode::ReadAhead;
+    throw std::runtime_error("Unknown read mode: " + name + " (expected stream, mmap or readahead)");
+}
+
+EventRange parse_event_range(const std::string& spec) {
+    auto colon = spec.find(':');
+    if (colon == std::string::npos) {
+        throw std::runtime_error("Invalid event range '" + spec + "' (expected a:b)");
+    }
+    EventRange range;
+    try {
+        std::string first = spec.substr(0, colon);
+        std::string last  = spec.substr(colon + 1);
+        if (!first.empty()) range.first = std::stoi(first);
+        if (!last.empty())  range.last  = std::stoi(last);
+    } catch (const std::exception&) {
+        throw std::runtime_error("Invalid event range '" + spec + "' (expected a:b)");
+    }
+    if (range.last < range.first) {
+        throw std::runtime_error("Invalid event range '" + spec + "': end before start");
+    }
+    return range;
+}
+
 size_t type_size(QuantityType t) {
     switch (t) {
         case QuantityType::Double: return sizeof(double);
@@ -36,6 +107,46 @@ compute_quantity_layout(const std::vector<std::string>& names) {
     return layout;
 }
 
+size_t compute_particle_size(const std::vector<std::string>& names) {
+    size_t size = 0;
+    for (const auto& name : names) {
+        auto it = quantity_string_map.find(name);
+        if (it == quantity_string_map.end())
+            throw std::runtime_error("Unknown quantity: " + name);
+        size += type_size(it->second.type);
+    }
+    return size;
+}
+
+const std::vector<std::string>& smash_quantities(const Header& header) {
+    static const std::vector<std::string> default_record = {
+        "t", "x", "y", "z", "mass", "p0", "px", "py", "pz", "pdg", "id", "charge"
+    };
+    static const std::vector<std::string> extended_record = [] {
+        std::vector<std::string> names = default_record;
+        names.insert(names.end(), {"ncoll", "form_time", "xsecfac",
+                                   "proc_id_origin", "proc_type_origin", "time_last_coll",
+                                   "pdg_mother1", "pdg_mother2", "baryon_number", "strangeness"});
+        return names;
+    }();
+
+    switch (static_cast<FormatVariant>(header.format_variant)) {
+        case FormatVariant::Default:  return default_record;
+        case FormatVariant::Extended: return extended_record;
+    }
+    throw std::runtime_error("Cannot infer particle layout for format variant " +
+                             std::to_string(header.format_variant) +
+                             "; list the quantities explicitly");
+}
+
+Header read_file_header(const std::string& filename) {
+    std::ifstream bfile(filename, std::ios::binary);
+    if (!bfile) throw std::runtime_error("Could not open file: " + filename);
+    Header header;
+    header.read(bfile);
+    return header;
+}
+
 std::vector<char> read_chunk(std::ifstream& bfile, size_t size) {
     std::vector<char> buffer(size);
     bfile.read(buffer.data(), size);
@@ -43,6 +154,13 @@ std::vector<char> read_chunk(std::ifstream& bfile, size_t size) {
     return buffer;
 }
 
+const char* take_bytes(const char*& cursor, const char* end, size_t size) {
+    if (static_cast<size_t>(end - cursor) < size) throw std::runtime_error("Read failed");
+    const char* chunk = cursor;
+    cursor += size;
+    return chunk;
+}
+
 void Header::read(std::ifstream& bfile) {
     bfile.read(magic_number, 4);
     magic_number[4] = '\0';
@@ -61,6 +179,29 @@ void Header::read(std::ifstream& bfile) {
     }
 }
 
+uint32_t Header::read_fixed(const char* fixed) {
+    std::memcpy(magic_number, fixed, 4);
+    magic_number[4] = '\0';
+    fixed += 4;
+
+    format_version = extract_and_advance<uint16_t>(fixed);
+    format_variant = extract_and_advance<uint16_t>(fixed);
+    return extract_and_advance<uint32_t>(fixed);
+}
+
+void Header::read(const char*& cursor, const char* end) {
+    if (static_cast<size_t>(end - cursor) < FIXED_SIZE) {
+        throw std::runtime_error("Failed to read header from binary file");
+    }
+    uint32_t len = read_fixed(cursor);
+    cursor += FIXED_SIZE;
+    if (static_cast<size_t>(end - cursor) < len) {
+        throw std::runtime_error("Failed to read header from binary file");
+    }
+    smash_version.assign(cursor, len);
+    cursor += len;
+}
+
 void Header::print() const {
     std::cout << "Magic Number:   " << magic_number << "\n";
     std::cout << "Format Version: " << format_version << "\n";
@@ -69,37 +210,164 @@ void Header::print() const {
 }
 
 void EndBlock::read(std::ifstream& bfile) {
-    std::vector<char> buffer = read_chunk(bfile, SIZE);
-    size_t offset = 0;
-    event_number     = extract_and_advance<uint32_t>(buffer, offset);
-    ensamble_number  = extract_and_advance<int32_t>(buffer, offset);
-    impact_parameter = extract_and_advance<double>(buffer, offset);
-    empty            = extract_and_advance<char>(buffer, offset);
+    char buffer[SIZE];
+    bfile.read(buffer, SIZE);
+    if (!bfile) throw std::runtime_error("Read failed");
+    const char* chunk = buffer;
+    event_number     = extract_and_advance<uint32_t>(chunk);
+    ensamble_number  = extract_and_advance<int32_t>(chunk);
+    impact_parameter = extract_and_advance<double>(chunk);
+    empty            = extract_and_advance<char>(chunk);
+}
+
+void EndBlock::read(const char*& cursor, const char* end) {
+    const char* chunk = take_bytes(cursor, end, SIZE);
+    event_number     = extract_and_advance<uint32_t>(chunk);
+    ensamble_number  = extract_and_advance<int32_t>(chunk);
+    impact_parameter = extract_and_advance<double>(chunk);
+    empty            = extract_and_advance<char>(chunk);
+}
+
+ParticleBlock::ParticleBlock(const ParticleBlock& other)
+    : event_number(other.event_number),
+      ensamble_number(other.ensamble_number),
+      npart(other.npart),
+      particle_size(other.particle_size),
+      storage(other.data, other.data + other.npart * other.particle_size),
+      persistent(false)
+{
+    data = storage.data();
+}
+
+ParticleBlock& ParticleBlock::operator=(const ParticleBlock& other) {
+    if (this != &other) {
+        ParticleBlock copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+void ParticleBlock::retain(const ParticleBlock& other) {
+    if (this == &other) return;
+    event_number    = other.event_number;
+    ensamble_number = other.ensamble_number;
+    npart           = other.npart;
+    particle_size   = other.particle_size;
+    if (other.persistent) {
+        data = other.data;
+        persistent = true;
+    } else {
+        storage.assign(other.data, other.data + other.npart * other.particle_size);
+        data = storage.data();
+        persistent = false;
+    }
 }
 
 void ParticleBlock::read(std::ifstream& bfile, size_t particle_size) {
-    constexpr size_t HEADER_SIZE = sizeof(int32_t) + sizeof(int32_t) + sizeof(uint32_t);
-    std::vector<char> buffer = read_chunk(bfile, HEADER_SIZE);
+    char buffer[HEADER_SIZE];
+    bfile.read(buffer, HEADER_SIZE);
+    if (!bfile) throw std::runtime_error("Read failed");
+    read_header(buffer);
 
-    size_t offset = 0;
-    event_number     = extract_and_advance<int32_t>(buffer, offset);
-    ensamble_number  = extract_and_advance<int32_t>(buffer, offset);
-    npart            = extract_and_advance<uint32_t>(buffer, offset);
+    this->particle_size = particle_size;
+    storage.resize(static_cast<size_t>(npart) * particle_size);
+    bfile.read(storage.data(), storage.size());
+    if (!bfile) throw std::runtime_error("Read failed");
+    data = storage.data();
+    persistent = false;
+}
+
+void ParticleBlock::read_header(const char* header) {
+    event_number     = extract_and_advance<int32_t>(header);
+    ensamble_number  = extract_and_advance<int32_t>(header);
+    npart            = extract_and_advance<uint32_t>(header);
+}
+
+void ParticleBlock::set_records(const char* records, size_t particle_size_in, bool persistent_in) {
+    particle_size = particle_size_in;
+    data = records;
+    persistent = persistent_in;
+}
 
-    std::vector<char> flat = read_chunk(bfile, npart * particle_size);
-    particles.resize(npart);
-    for (size_t i = 0; i < npart; ++i) {
-        particles[i].assign(
-            flat.begin() + i * particle_size,
-            flat.begin() + (i + 1) * particle_size
-        );
+InteractionBlock::InteractionBlock(const InteractionBlock& other)
+    : n_in(other.n_in),
+      n_out(other.n_out),
+      density(other.density),
+      total_weight(other.total_weight),
+      partial_weight(other.partial_weight),
+      process_type(other.process_type),
+      particle_size(other.particle_size),
+      storage(other.data, other.data + other.size() * other.particle_size),
+      persistent(false)
+{
+    data = storage.data();
+}
+
+InteractionBlock& InteractionBlock::operator=(const InteractionBlock& other) {
+    if (this != &other) {
+        InteractionBlock copy(other);
+        *this = std::move(copy);
     }
+    return *this;
+}
+
+void InteractionBlock::retain(const InteractionBlock& other) {
+    if (this == &other) return;
+    n_in           = other.n_in;
+    n_out          = other.n_out;
+    density        = other.density;
+    total_weight   = other.total_weight;
+    partial_weight = other.partial_weight;
+    process_type   = other.process_type;
+    particle_size  = other.particle_size;
+    if (other.persistent) {
+        data = other.data;
+        persistent = true;
+    } else {
+        storage.assign(other.data, other.data + other.size() * other.particle_size);
+        data = storage.data();
+        persistent = false;
+    }
+}
+
+void InteractionBlock::read(std::ifstream& bfile, size_t particle_size_in) {
+    char buffer[HEADER_SIZE];
+    bfile.read(buffer, HEADER_SIZE);
+    if (!bfile) throw std::runtime_error("Read failed");
+    read_header(buffer);
+
+    particle_size = particle_size_in;
+    storage.resize(size() * particle_size);
+    bfile.read(storage.data(), storage.size());
+    if (!bfile) throw std::runtime_error("Read failed");
+    data = storage.data();
+    persistent = false;
+}
+
+void InteractionBlock::read_header(const char* header) {
+    n_in           = extract_and_advance<uint32_t>(header);
+    n_out          = extract_and_advance<uint32_t>(header);
+    density        = extract_and_advance<double>(header);
+    total_weight   = extract_and_advance<double>(header);
+    partial_weight = extract_and_advance<double>(header);
+    process_type   = extract_and_advance<uint32_t>(header);
+}
+
+void InteractionBlock::set_records(const char* records, size_t particle_size_in, bool persistent_in) {
+    particle_size = particle_size_in;
+    data = records;
+    persistent = persistent_in;
 }
 
 void Accessor::set_layout(const std::unordered_map<Quantity, size_t>* layout_in) {
     layout = layout_in;
 }
 
+const std::unordered_map<Quantity, size_t>& Accessor::get_layout() const {
+    if (!layout) throw std::runtime_error("Layout not set in Accessor");
+    return *layout;
+}
+
 int32_t Accessor::get_int(const std::string& name, const ParticleBlock& block, size_t i) const {
     return quantity<int32_t>(name, block, i);
 }
@@ -108,52 +376,304 @@ double Accessor::get_double(const std::string& name, const ParticleBlock& block,
     return quantity<double>(name, block, i);
 }
 
+int32_t Accessor::get_int(const std::string& name, ParticleView particle) const {
+    return quantity<int32_t>(name, particle);
+}
+
+double Accessor::get_double(const std::string& name, ParticleView particle) const {
+    return quantity<double>(name, particle);
+}
+
+namespace {
+// In-memory source over a whole file mapping, for BinaryReader::read_blocks.
+class MappedSource {
+public:
+    static constexpr bool persistent = true;
+
+    explicit MappedSource(const MappedFile& map)
+        : begin(map.data()), cursor(map.data()), end(map.data() + map.size()) {}
+
+    bool next(char& c) {
+        if (cursor >= end) return false;
+        c = *cursor++;
+        return true;
+    }
+    bool peek(char& c) const {
+        if (cursor >= end) return false;
+        c = *cursor;
+        return true;
+    }
+    const char* take(size_t n) { return take_bytes(cursor, end, n); }
+    void seek(uint64_t offset) { cursor = begin + offset; }
+
+private:
+    const char* begin;
+    const char* cursor;
+    const char* end;
+};
+} // namespace
+
 BinaryReader::BinaryReader(const std::string& filename,
                            const std::vector<std::string>& selected,
-                           std::shared_ptr<Accessor> accessor_in)
-    : file(filename, std::ios::binary), accessor(std::move(accessor_in))
+                           std::shared_ptr<Accessor> accessor_in,
+                           ReadMode mode)
+    : accessor(std::move(accessor_in))
 {
-    if (!file) {
-        throw std::runtime_error("Could not open file: " + filename);
-    }
+    if (ColumnarFile::is_columnar(filename)) {
+        columnar = std::make_shared<ColumnarFile>(filename);
+        const auto& names = selected.empty() ? columnar->column_names() : selected;
+        for (const auto& name : names) {
+            auto it = quantity_string_map.find(name);
+            if (it != quantity_string_map.end() && columnar->column_index(it->second.quantity) < 0) {
+                throw std::runtime_error("Quantity not in columnar file: " + name);
+            }
+        }
+        layout = compute_quantity_layout(names);
+        particle_size = compute_particle_size(names);
 
-    layout = compute_quantity_layout(selected);
+        if (!accessor) throw std::runtime_error("An accessor is needed!");
+        accessor->set_layout(&layout);
+        return;
+    }
 
-    for (const std::string& name : selected) {
-        const auto& info = quantity_string_map.at(name);
-        particle_size += type_size(info.type);
+    if (mode == ReadMode::Mmap) {
+        mapped = std::make_unique<MappedFile>(filename);
+    } else if (mode == ReadMode::ReadAhead) {
+        readahead = std::make_unique<ReadAheadFile>(filename);
+    } else {
+        file.open(filename, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Could not open file: " + filename);
+        }
     }
 
+    const std::vector<std::string>& names =
+        selected.empty() ? smash_quantities(read_file_header(filename)) : selected;
+    layout = compute_quantity_layout(names);
+    particle_size = compute_particle_size(names);
+
     if (!accessor) throw std::runtime_error("An accessor is needed!");
     accessor->set_layout(&layout);
 }
 
+void BinaryReader::set_event_range(EventRange range, const EventIndex* index_in) {
+    events = range;
+    index = columnar ? nullptr : index_in;
+    if (index && index->get_particle_size() != particle_size) {
+        throw std::runtime_error("Event index was built for a different particle layout");
+    }
+}
+
+void BinaryReader::set_filter(const ParticleFilter& filter_in) {
+    if (filter_in.empty()) {
+        filter.reset();
+        return;
+    }
+    filter = std::make_shared<ParticleFilter>(filter_in);
+    filter->bind(layout);
+}
+
 void BinaryReader::read() {
+    if (columnar) {
+        read_columnar();
+    } else if (mapped) {
+        MappedSource source(*mapped);
+        read_blocks(source);
+    } else if (readahead) {
+        read_blocks(*readahead);
+    } else {
+        read_stream();
+    }
+}
+
+void BinaryReader::read_stream() {
     header.read(file);
     char blockType;
     if(accessor) accessor->on_header(header);
+    // Interaction blocks carry no event number; they belong to the event
+    // closed by the next end block.
+    int64_t current_event = 0;
+    if (index && index->size() > 0) {
+        size_t first = index->lower_bound(events.first);
+        if (first == index->size()) return;
+        file.seekg(static_cast<std::streamoff>(index->entries()[first].offset));
+        current_event = index->entries()[first].event_number;
+    }
+    // Reused across blocks so the record buffers are only reallocated when they grow.
+    ParticleBlock p_block;
+    InteractionBlock i_block;
     while (file.read(&blockType, sizeof(blockType))) {
         switch (blockType) {
             case 'p': {
-                ParticleBlock p_block;
                 p_block.read(file, particle_size);
-                if (accessor && check_next(file)) accessor->on_particle_block(p_block);
+                current_event = p_block.event_number;
+                if (p_block.event_number >= events.last) return;
+                if (accessor && check_next(file) && events.contains(p_block.event_number)) {
+                    if (filter) filter->apply(p_block);
+                    accessor->on_particle_block(p_block);
+                }
                 break;
             }
             case 'f': {
                 EndBlock e_block;
                 e_block.read(file);
-                if (accessor && check_next(file)) accessor->on_end_block(e_block);
+                if (static_cast<int64_t>(e_block.event_number) >= events.last) return;
+                if (accessor && check_next(file) && events.contains(e_block.event_number))
+                    accessor->on_end_block(e_block);
+                current_event = static_cast<int64_t>(e_block.event_number) + 1;
+                break;
+            }
+            case 'i': {
+                i_block.read(file, particle_size);
+                if (accessor && check_next(file) && events.contains(current_event))
+                    accessor->on_interaction_block(i_block);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+template <typename Source>
+void BinaryReader::read_blocks(Source& source) {
+    uint32_t len = header.read_fixed(source.take(Header::FIXED_SIZE));
+    header.smash_version.assign(source.take(len), len);
+    if (accessor) accessor->on_header(header);
+    int64_t current_event = 0;
+    if (index && index->size() > 0) {
+        size_t first = index->lower_bound(events.first);
+        if (first == index->size()) return;
+        source.seek(index->entries()[first].offset);
+        current_event = index->entries()[first].event_number;
+    }
+
+    // Same semantics as the stream version: a block only counts if another
+    // block follows it, and a stray byte is consumed.
+    auto check_next = [&]() {
+        char next;
+        if (!source.peek(next)) return false;
+        if (next == 'p' || next == 'f' || next == 'i') return true;
+        source.next(next);
+        return false;
+    };
+
+    // Reused across blocks; only the block header is decoded, records stay in
+    // the source's memory.
+    ParticleBlock p_block;
+    InteractionBlock i_block;
+    EndBlock e_block;
+    char blockType;
+    while (source.next(blockType)) {
+        switch (blockType) {
+            case 'p': {
+                p_block.read_header(source.take(ParticleBlock::HEADER_SIZE));
+                const size_t bytes = static_cast<size_t>(p_block.npart) * particle_size;
+                p_block.set_records(source.take(bytes), particle_size, Source::persistent);
+                current_event = p_block.event_number;
+                if (p_block.event_number >= events.last) return;
+                if (accessor && check_next() && events.contains(p_block.event_number)) {
+                    if (filter) filter->apply(p_block);
+                    accessor->on_particle_block(p_block);
+                }
+                break;
+            }
+            case 'f': {
+                const char* chunk = source.take(EndBlock::SIZE);
+                e_block.read(chunk, chunk + EndBlock::SIZE);
+                if (static_cast<int64_t>(e_block.event_number) >= events.last) return;
+                if (accessor && check_next() && events.contains(e_block.event_number))
+                    accessor->on_end_block(e_block);
+                current_event = static_cast<int64_t>(e_block.event_number) + 1;
                 break;
             }
-            case 'i':
+            case 'i': {
+                i_block.read_header(source.take(InteractionBlock::HEADER_SIZE));
+                const size_t bytes = i_block.size() * particle_size;
+                i_block.set_records(source.take(bytes), particle_size, Source::persistent);
+                if (accessor && check_next() && events.contains(current_event))
+                    accessor->on_interaction_block(i_block);
                 break;
+            }
             default:
                 break;
         }
     }
 }
 
+void BinaryReader::read_columnar() {
+    header = columnar->header();
+    if (accessor) accessor->on_header(header);
+
+    // Selected columns and where they go in the rebuilt record.
+    struct Field {
+        size_t column;
+        size_t size;
+        size_t offset;
+    };
+    std::vector<Field> fields;
+    for (const auto& [q, offset] : layout) {
+        fields.push_back({static_cast<size_t>(columnar->column_index(q)),
+                          type_size(quantity_type(q)), offset});
+    }
+
+    std::unordered_map<Quantity, std::pair<double, double>> ranges;
+    std::vector<char> rows;  // reused between blocks
+    ParticleBlock p_block;
+    EndBlock e_block{};
+    for (const auto& chunk : columnar->chunks()) {
+        if (chunk.first_event >= events.last) return;
+        if (chunk.last_event < events.first) continue;
+
+        // A chunk whose statistics fail the filter is never decoded; its
+        // blocks are still dispatched, empty.
+        bool skip = false;
+        if (filter && columnar->has_stats()) {
+            ranges.clear();
+            for (size_t c = 0; c < columnar->column_names().size(); ++c) {
+                Quantity q = quantity_string_map.at(columnar->column_names()[c]).quantity;
+                ranges[q] = {chunk.min[c], chunk.max[c]};
+            }
+            skip = !filter->may_match(ranges);
+        }
+
+        const char* item_ptr = columnar->items(chunk);
+        uint64_t first_particle = 0;
+        for (uint32_t k = 0; k < chunk.n_items; ++k, item_ptr += ColumnarItem::SIZE) {
+            const ColumnarItem item = ColumnarItem::read(item_ptr);
+            if (item.kind == 'p') {
+                if (item.event_number >= events.last) return;
+                if (accessor && events.contains(item.event_number)) {
+                    p_block.event_number = item.event_number;
+                    p_block.ensamble_number = item.ensamble_number;
+                    p_block.npart = skip ? 0 : item.npart;
+                    rows.resize(static_cast<size_t>(p_block.npart) * particle_size);
+                    for (const auto& f : fields) {
+                        const char* src = columnar->column(chunk, f.column) + first_particle * f.size;
+                        char* dst = rows.data() + f.offset;
+                        for (uint32_t i = 0; i < p_block.npart; ++i) {
+                            std::memcpy(dst + i * particle_size, src + i * f.size, f.size);
+                        }
+                    }
+                    p_block.set_records(rows.data(), particle_size, false);
+                    if (filter && !skip) filter->apply(p_block);
+                    accessor->on_particle_block(p_block);
+                }
+                first_particle += item.npart;
+            } else if (item.kind == 'f') {
+                if (item.event_number >= events.last) return;
+                if (accessor && events.contains(item.event_number)) {
+                    e_block.event_number = static_cast<uint32_t>(item.event_number);
+                    e_block.ensamble_number = static_cast<uint32_t>(item.ensamble_number);
+                    e_block.impact_parameter = item.impact_parameter;
+                    e_block.empty = item.empty;
+                    accessor->on_end_block(e_block);
+                }
+            }
+        }
+    }
+}
+
 bool BinaryReader::check_next(std::ifstream& bfile) {
     char blockType;
     bfile.read(reinterpret_cast<char*>(&blockType), sizeof(char));
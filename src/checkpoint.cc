@@ -0,0 +1,58 @@
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "binaryio.h"
+#include "partialresult.h"
+
+namespace {
+using binaryio::get;
+using binaryio::get_string;
+using binaryio::put;
+using binaryio::put_string;
+} // namespace
+
+void Checkpoint::save(const std::string& path) const {
+    binaryio::write_binary_file(path, [&](std::ostream& out) {
+        out.write(MAGIC, sizeof(MAGIC));
+        put(out, VERSION);
+        put_string(out, config);
+        put(out, static_cast<uint32_t>(analysis_names.size()));
+        for (const auto& name : analysis_names) put_string(out, name);
+        put(out, static_cast<uint32_t>(completed.size()));
+        for (const auto& [file, meta] : completed) {
+            put_string(out, file);
+            put_string(out, meta);
+        }
+        for (const auto& entries : results) write_entries(out, entries);
+    });
+}
+
+Checkpoint Checkpoint::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Could not open checkpoint: " + path);
+
+    char magic[sizeof(MAGIC)];
+    in.read(magic, sizeof(magic));
+    if (!in || !std::equal(magic, magic + sizeof(MAGIC), MAGIC)) {
+        throw std::runtime_error("Not a checkpoint: " + path);
+    }
+    if (get<uint16_t>(in) != VERSION) {
+        throw std::runtime_error("Unsupported checkpoint version: " + path);
+    }
+
+    Checkpoint cp;
+    cp.config = get_string(in);
+    const auto n_analyses = get<uint32_t>(in);
+    for (uint32_t a = 0; a < n_analyses; ++a) cp.analysis_names.push_back(get_string(in));
+    const auto n_completed = get<uint32_t>(in);
+    for (uint32_t f = 0; f < n_completed; ++f) {
+        std::string file = get_string(in);
+        cp.completed.emplace_back(std::move(file), get_string(in));
+    }
+
+    for (const auto& name : cp.analysis_names) cp.results.push_back(read_entries(in, name));
+    return cp;
+}
@@ -0,0 +1,312 @@
+#include "columnarfile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "binaryio.h"
+
+namespace {
+constexpr size_t column_alignment = 8;
+
+// Accessor that collects the blocks of a binary file into chunks and writes
+// them out in the columnar layout.
+class ColumnarWriter : public Accessor {
+public:
+    ColumnarWriter(const std::string& filename, const ConvertOptions& options_in)
+        : out(filename, std::ios::binary), options(options_in)
+    {
+        if (!out) throw std::runtime_error("Failed to open " + filename);
+        if (options.chunk_events == 0) options.chunk_events = 1;
+    }
+
+    void on_header(Header& header) override {
+        // Columns in on-disk order of the source record.
+        std::vector<std::pair<size_t, Quantity>> by_offset;
+        for (const auto& [q, offset] : get_layout()) by_offset.emplace_back(offset, q);
+        std::sort(by_offset.begin(), by_offset.end());
+        for (const auto& [offset, q] : by_offset) {
+            columns.push_back({q, offset, type_size(quantity_type(q))});
+        }
+        data.resize(columns.size());
+        reset_stats();
+
+        out.write(ColumnarFile::MAGIC, sizeof(ColumnarFile::MAGIC));
+        put(ColumnarFile::VERSION);
+        out.write(header.magic_number, 4);
+        put(header.format_version);
+        put(header.format_variant);
+        put(static_cast<uint32_t>(header.smash_version.size()));
+        out.write(header.smash_version.data(), header.smash_version.size());
+        put(static_cast<uint8_t>(options.stats ? 1 : 0));
+        put(static_cast<uint32_t>(columns.size()));
+        for (const auto& c : columns) {
+            const std::string& name = quantity_name(c.quantity);
+            put(static_cast<uint32_t>(name.size()));
+            out.write(name.data(), name.size());
+        }
+        directory_slot = out.tellp();
+        put(uint64_t{0});  // n_chunks, patched in finish()
+        put(uint64_t{0});  // directory offset
+    }
+
+    void on_particle_block(const ParticleBlock& block) override {
+        add_item('p', block.event_number, block.ensamble_number, block.npart, 0.0, 0);
+        for (size_t c = 0; c < columns.size(); ++c) {
+            const Column& col = columns[c];
+            auto& dst = data[c];
+            const size_t start = dst.size();
+            dst.resize(start + static_cast<size_t>(block.npart) * col.size);
+            const char* src = block.data + col.offset;
+            for (uint32_t i = 0; i < block.npart; ++i, src += block.particle_size) {
+                std::memcpy(dst.data() + start + i * col.size, src, col.size);
+            }
+            if (options.stats) update_stats(c, dst.data() + start, block.npart);
+        }
+        n_particles += block.npart;
+    }
+
+    void on_end_block(const EndBlock& block) override {
+        add_item('f', static_cast<int32_t>(block.event_number),
+                 static_cast<int32_t>(block.ensamble_number), 0, block.impact_parameter, block.empty);
+        if (++events_in_chunk >= options.chunk_events) flush_chunk();
+    }
+
+    void on_interaction_block(const InteractionBlock&) override {
+        throw std::runtime_error("Columnar cache does not support interaction blocks");
+    }
+
+    void finish() {
+        flush_chunk();
+        const uint64_t directory_offset = static_cast<uint64_t>(out.tellp());
+        for (const auto& chunk : chunks) {
+            put(chunk.items_offset);
+            put(chunk.n_items);
+            put(chunk.n_particles);
+            put(chunk.first_event);
+            put(chunk.last_event);
+            for (size_t c = 0; c < columns.size(); ++c) {
+                put(chunk.column_offsets[c]);
+                put(chunk.min[c]);
+                put(chunk.max[c]);
+            }
+        }
+        out.seekp(directory_slot);
+        put(static_cast<uint64_t>(chunks.size()));
+        put(directory_offset);
+        out.close();
+        if (!out) throw std::runtime_error("Failed to write columnar file");
+    }
+
+private:
+    struct Column {
+        Quantity quantity;
+        size_t offset;  // in the source record
+        size_t size;
+    };
+
+    template <typename T>
+    void put(const T& v) { binaryio::put(out, v); }
+
+    void add_item(char kind, int32_t event, int32_t ensemble, uint32_t npart, double impact,
+                  char empty) {
+        char buffer[ColumnarItem::SIZE];
+        char* p = buffer;
+        *p++ = kind;
+        std::memcpy(p, &event, sizeof(event));       p += sizeof(event);
+        std::memcpy(p, &ensemble, sizeof(ensemble)); p += sizeof(ensemble);
+        std::memcpy(p, &npart, sizeof(npart));       p += sizeof(npart);
+        std::memcpy(p, &impact, sizeof(impact));     p += sizeof(impact);
+        *p = empty;
+        items.insert(items.end(), buffer, buffer + ColumnarItem::SIZE);
+        if (n_items++ == 0) first_event = last_event = event;
+        first_event = std::min(first_event, event);
+        last_event = std::max(last_event, event);
+    }
+
+    void update_stats(size_t c, const char* values, uint32_t n) {
+        double lo = min[c], hi = max[c];
+        if (quantity_type(columns[c].quantity) == QuantityType::Double) {
+            for (uint32_t i = 0; i < n; ++i) {
+                double v;
+                std::memcpy(&v, values + i * sizeof(double), sizeof(v));
+                if (std::isnan(v)) continue;  // NaN fails every cut anyway
+                lo = std::min(lo, v);
+                hi = std::max(hi, v);
+            }
+        } else {
+            for (uint32_t i = 0; i < n; ++i) {
+                int32_t v;
+                std::memcpy(&v, values + i * sizeof(int32_t), sizeof(v));
+                lo = std::min(lo, static_cast<double>(v));
+                hi = std::max(hi, static_cast<double>(v));
+            }
+        }
+        min[c] = lo;
+        max[c] = hi;
+    }
+
+    void reset_stats() {
+        min.assign(columns.size(), options.stats ? std::numeric_limits<double>::infinity()
+                                                 : -std::numeric_limits<double>::infinity());
+        max.assign(columns.size(), options.stats ? -std::numeric_limits<double>::infinity()
+                                                 : std::numeric_limits<double>::infinity());
+    }
+
+    void pad() {
+        static const char zeros[column_alignment] = {};
+        const auto pos = static_cast<size_t>(out.tellp());
+        if (pos % column_alignment) out.write(zeros, column_alignment - pos % column_alignment);
+    }
+
+    void flush_chunk() {
+        if (n_items == 0) return;
+        ColumnarChunk chunk;
+        chunk.items_offset = static_cast<uint64_t>(out.tellp());
+        chunk.n_items = n_items;
+        chunk.n_particles = n_particles;
+        chunk.first_event = first_event;
+        chunk.last_event = last_event;
+        out.write(items.data(), items.size());
+        for (size_t c = 0; c < columns.size(); ++c) {
+            pad();
+            chunk.column_offsets.push_back(static_cast<uint64_t>(out.tellp()));
+            out.write(data[c].data(), data[c].size());
+            data[c].clear();
+        }
+        chunk.min = min;
+        chunk.max = max;
+        chunks.push_back(std::move(chunk));
+
+        items.clear();
+        n_items = 0;
+        n_particles = 0;
+        events_in_chunk = 0;
+        reset_stats();
+    }
+
+    std::ofstream out;
+    ConvertOptions options;
+    std::streampos directory_slot;
+    std::vector<Column> columns;
+    std::vector<ColumnarChunk> chunks;
+
+    // Current chunk.
+    std::vector<char> items;
+    std::vector<std::vector<char>> data;  // one byte array per column
+    std::vector<double> min, max;
+    uint32_t n_items = 0;
+    uint64_t n_particles = 0;
+    uint32_t events_in_chunk = 0;
+    int32_t first_event = 0;
+    int32_t last_event = 0;
+};
+} // namespace
+
+ColumnarItem ColumnarItem::read(const char* p) {
+    ColumnarItem item;
+    item.kind             = extract_and_advance<char>(p);
+    item.event_number     = extract_and_advance<int32_t>(p);
+    item.ensamble_number  = extract_and_advance<int32_t>(p);
+    item.npart            = extract_and_advance<uint32_t>(p);
+    item.impact_parameter = extract_and_advance<double>(p);
+    item.empty            = extract_and_advance<char>(p);
+    return item;
+}
+
+bool ColumnarFile::is_columnar(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    in.read(magic, sizeof(magic));
+    return in && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+ColumnarFile::ColumnarFile(const std::string& filename) : map_(filename) {
+    const char* begin = map_.data();
+    const char* cursor = begin;
+    const char* end = begin + map_.size();
+    auto fail = [&]() -> void {
+        throw std::runtime_error("Not a valid bark columnar file: " + filename);
+    };
+
+    if (map_.size() < sizeof(MAGIC) + sizeof(uint16_t) ||
+        std::memcmp(cursor, MAGIC, sizeof(MAGIC)) != 0) fail();
+    cursor += sizeof(MAGIC);
+    const char* version_bytes = take_bytes(cursor, end, sizeof(uint16_t));
+    if (extract_and_advance<uint16_t>(version_bytes) != VERSION) {
+        throw std::runtime_error("Columnar file " + filename +
+                                 " was written by another version of bark; convert it again");
+    }
+
+    header_.read(cursor, end);
+    const char* fixed = take_bytes(cursor, end, sizeof(uint8_t) + sizeof(uint32_t));
+    has_stats_ = extract_and_advance<uint8_t>(fixed) != 0;
+    const uint32_t n_columns = extract_and_advance<uint32_t>(fixed);
+    for (uint32_t c = 0; c < n_columns; ++c) {
+        const char* len_bytes = take_bytes(cursor, end, sizeof(uint32_t));
+        const uint32_t len = extract_and_advance<uint32_t>(len_bytes);
+        std::string name(take_bytes(cursor, end, len), len);
+        auto it = quantity_string_map.find(name);
+        if (it == quantity_string_map.end()) throw std::runtime_error("Unknown quantity: " + name);
+        names_.push_back(std::move(name));
+        quantities_.push_back(it->second.quantity);
+    }
+    const char* counts = take_bytes(cursor, end, 2 * sizeof(uint64_t));
+    const uint64_t n_chunks = extract_and_advance<uint64_t>(counts);
+    const uint64_t directory_offset = extract_and_advance<uint64_t>(counts);
+    if (directory_offset > map_.size()) fail();
+
+    const size_t entry_size = sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint64_t) +
+                              2 * sizeof(int32_t) +
+                              n_columns * (sizeof(uint64_t) + 2 * sizeof(double));
+    cursor = begin + directory_offset;
+    if (n_chunks > static_cast<uint64_t>(end - cursor) / entry_size) fail();
+    chunks_.resize(n_chunks);
+    for (auto& chunk : chunks_) {
+        const char* e = take_bytes(cursor, end, entry_size);
+        chunk.items_offset = extract_and_advance<uint64_t>(e);
+        chunk.n_items      = extract_and_advance<uint32_t>(e);
+        chunk.n_particles  = extract_and_advance<uint64_t>(e);
+        chunk.first_event  = extract_and_advance<int32_t>(e);
+        chunk.last_event   = extract_and_advance<int32_t>(e);
+        if (chunk.items_offset > map_.size() ||
+            chunk.n_items > (map_.size() - chunk.items_offset) / ColumnarItem::SIZE) fail();
+        for (uint32_t c = 0; c < n_columns; ++c) {
+            const uint64_t offset = extract_and_advance<uint64_t>(e);
+            const size_t size = type_size(quantity_type(quantities_[c]));
+            if (offset > map_.size() || chunk.n_particles > (map_.size() - offset) / size) fail();
+            chunk.column_offsets.push_back(offset);
+            chunk.min.push_back(extract_and_advance<double>(e));
+            chunk.max.push_back(extract_and_advance<double>(e));
+        }
+    }
+}
+
+int ColumnarFile::column_index(Quantity q) const {
+    auto it = std::find(quantities_.begin(), quantities_.end(), q);
+    return it == quantities_.end() ? -1 : static_cast<int>(it - quantities_.begin());
+}
+
+std::string columnar_path(const std::string& filename) {
+    const std::string ext = ".bin";
+    if (filename.size() >= ext.size() &&
+        filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0) {
+        return filename.substr(0, filename.size() - ext.size()) + ".bkc";
+    }
+    return filename + ".bkc";
+}
+
+void convert_to_columnar(const std::string& input, const std::string& output,
+                         const std::vector<std::string>& quantities,
+                         const ConvertOptions& options)
+{
+    binaryio::replace_file(output, [&](const std::string& tmp) {
+        auto writer = std::make_shared<ColumnarWriter>(tmp, options);
+        BinaryReader reader(input, quantities, writer, ReadMode::Mmap);
+        reader.read();
+        writer->finish();
+    });
+}
@@ -0,0 +1,95 @@
+#include "columnblock.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+// Records are gathered in tiles of this many particles, column by column, so
+// a tile of a wide record (e.g. the 136-byte extended SMASH record) is pulled
+// into cache once and all projected fields are taken from it before moving on.
+constexpr uint32_t tile_size = 256;
+
+// Strided gather of one field of records [begin, end) into out[begin, end).
+template <typename T>
+void gather(const ParticleBlock& block, size_t offset, uint32_t begin, uint32_t end, T* out) {
+    const size_t stride = block.particle_size;
+    const char* p = block.data + begin * stride + offset;
+    for (uint32_t i = begin; i < end; ++i, p += stride) {
+        std::memcpy(out + i, p, sizeof(T));
+    }
+}
+} // namespace
+
+void ColumnBlock::decode(const ParticleBlock& block,
+                         const std::unordered_map<Quantity, size_t>& layout,
+                         const std::vector<Quantity>& quantities)
+{
+    event_number = block.event_number;
+    ensamble_number = block.ensamble_number;
+    npart = block.npart;
+
+    for (auto& c : columns) c.present = false;
+
+    plan.clear();
+    for (Quantity q : quantities) {
+        auto it = layout.find(q);
+        if (it == layout.end()) {
+            throw std::runtime_error("Quantity not in layout: " + quantity_name(q));
+        }
+        Column& c = columns[static_cast<size_t>(q)];
+        if (quantity_type(q) == QuantityType::Double) {
+            c.doubles.resize(npart);
+        } else {
+            c.ints.resize(npart);
+        }
+        c.present = true;
+        plan.push_back({it->second, quantity_type(q), &c});
+    }
+
+    for (uint32_t begin = 0; begin < npart; begin += tile_size) {
+        const uint32_t end = std::min(npart, begin + tile_size);
+        for (const auto& field : plan) {
+            if (field.type == QuantityType::Double) {
+                gather(block, field.offset, begin, end, field.column->doubles.data());
+            } else {
+                gather(block, field.offset, begin, end, field.column->ints.data());
+            }
+        }
+    }
+}
+
+const ColumnBlock::Column& ColumnBlock::column(Quantity q, QuantityType type) const {
+    const Column& c = columns[static_cast<size_t>(q)];
+    if (!c.present) {
+        throw std::runtime_error("Column not decoded: " + quantity_name(q));
+    }
+    if (quantity_type(q) != type) {
+        throw std::runtime_error(type == QuantityType::Double
+            ? "Requested double, but quantity is not double"
+            : "Requested int32, but quantity is not int32");
+    }
+    return c;
+}
+
+std::span<const double> ColumnBlock::doubles(Quantity q) const {
+    const auto& v = column(q, QuantityType::Double).doubles;
+    return {v.data(), npart};
+}
+
+std::span<const int32_t> ColumnBlock::ints(Quantity q) const {
+    const auto& v = column(q, QuantityType::Int32).ints;
+    return {v.data(), npart};
+}
+
+std::span<const double> ColumnBlock::doubles(const std::string& name) const {
+    auto it = quantity_string_map.find(name);
+    if (it == quantity_string_map.end()) throw std::runtime_error("Unknown quantity: " + name);
+    return doubles(it->second.quantity);
+}
+
+std::span<const int32_t> ColumnBlock::ints(const std::string& name) const {
+    auto it = quantity_string_map.find(name);
+    if (it == quantity_string_map.end()) throw std::runtime_error("Unknown quantity: " + name);
+    return ints(it->second.quantity);
+}
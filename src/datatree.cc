@@ -1,10 +1,17 @@
 #include "datatree.h"
+#include "binaryio.h"
 
 #include <stdexcept>
 #include <sstream>
+#include <istream>
+#include <ostream>
+#include <cstdint>
 #include <cmath>
 #include <algorithm>
-#include <functional>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <utility>
 #include <string>
 #include <vector>
@@ -24,7 +31,11 @@ void to_yaml(YAML::Emitter& out, const Data& v)
       out << YAML::BeginSeq;
       for (const auto& e : x) out << e;
       out << YAML::EndSeq;
-    } else if constexpr (std::is_same_v<T, Histogram1D>) {
+    } else if constexpr (std::is_same_v<T, Histogram1D> ||
+                         std::is_same_v<T, RunningMoments> ||
+                         std::is_same_v<T, MinMax> ||
+                         std::is_same_v<T, QuantileSketch> ||
+                         std::is_same_v<T, KahanSum>) {
       to_yaml(out, x);
     } else {
       static_assert(sizeof(T) == 0, "Unhandled Data type in to_yaml(Data)");
@@ -51,10 +62,10 @@ void to_yaml(YAML::Emitter& out, const DataNode& node) {
    
 
 if (node.is_leaf()) {
-    out << YAML::Key << node.get_name();
+    out << YAML::Key << node.get_name().c_str();
     to_yaml(out, node.get_data());
 } else {
-    out << YAML::Key << node.get_name();
+    out << YAML::Key << node.get_name().c_str();
     out << YAML::Value << YAML::BeginMap;
     for (auto& [_, child] : node.children()) {
         to_yaml(out, child);
@@ -64,6 +75,181 @@ if (node.is_leaf()) {
 
 
 }
+// ---- Streaming YAML, same layout as the YAML::Emitter versions ----
+void to_yaml(YamlWriter& out, const Data& v)
+{
+  std::visit([&](const auto& x) {
+    using T = std::decay_t<decltype(x)>;
+    if constexpr (std::is_same_v<T, std::monostate>) {
+
+    } else if constexpr (std::is_same_v<T, int> ||
+                         std::is_same_v<T, double>) {
+      out.value(x);
+    } else if constexpr (std::is_same_v<T, std::vector<int>> ||
+                         std::is_same_v<T, std::vector<double>>) {
+      out.begin_seq();
+      for (const auto& e : x) out.value(e);
+      out.end_seq();
+    } else if constexpr (std::is_same_v<T, Histogram1D> ||
+                         std::is_same_v<T, RunningMoments> ||
+                         std::is_same_v<T, MinMax> ||
+                         std::is_same_v<T, QuantileSketch> ||
+                         std::is_same_v<T, KahanSum>) {
+      to_yaml(out, x);
+    } else {
+      static_assert(sizeof(T) == 0, "Unhandled Data type in to_yaml(Data)");
+    }
+  }, v);
+}
+
+void to_yaml(YamlWriter& out, const DataNode& node) {
+    if (node.get_name().empty()) {
+        // Root node: emit children only
+        out.begin_map();
+        for (const auto& [_, child] : node.children()) {
+            to_yaml(out, child);
+        }
+        out.end_map();
+        return;
+    }
+
+    out.key(node.get_name());
+    if (node.is_leaf()) {
+        to_yaml(out, node.get_data());
+    } else {
+        out.begin_map();
+        for (const auto& [_, child] : node.children()) {
+            to_yaml(out, child);
+        }
+        out.end_map();
+    }
+}
+
+// ---- binary serialization ----
+// node := u32 name_len, name, u8 variant index, payload, u32 n_children, node...
+namespace {
+using binaryio::get;
+using binaryio::get_vector;
+using binaryio::put;
+using binaryio::put_vector;
+
+void write_data(std::ostream& out, const Data& d) {
+  put(out, static_cast<uint8_t>(d.index()));
+  std::visit([&](const auto& x) {
+    using T = std::decay_t<decltype(x)>;
+    if constexpr (std::is_same_v<T, std::monostate>) {
+    } else if constexpr (std::is_same_v<T, int>) {
+      put(out, static_cast<int32_t>(x));
+    } else if constexpr (std::is_same_v<T, double>) {
+      put(out, x);
+    } else if constexpr (std::is_same_v<T, std::vector<int>>) {
+      put_vector(out, x);
+    } else if constexpr (std::is_same_v<T, std::vector<double>>) {
+      put_vector(out, x);
+    } else if constexpr (std::is_same_v<T, Histogram1D>) {
+      put(out, x.min());
+      put(out, x.max());
+      put_vector(out, x.counts());
+    } else if constexpr (std::is_same_v<T, RunningMoments>) {
+      put(out, x.count());
+      put(out, x.mean());
+      put(out, x.m2());
+    } else if constexpr (std::is_same_v<T, MinMax>) {
+      put(out, x.count());
+      put(out, x.min());
+      put(out, x.max());
+    } else if constexpr (std::is_same_v<T, QuantileSketch>) {
+      put(out, x.compression());
+      put(out, x.total_weight());
+      put(out, x.min());
+      put(out, x.max());
+      put_vector(out, x.centroids());
+      put_vector(out, x.buffer());
+    } else if constexpr (std::is_same_v<T, KahanSum>) {
+      put(out, x.count());
+      put(out, x.raw_sum());
+      put(out, x.compensation());
+    } else {
+      static_assert(sizeof(T) == 0, "Unhandled Data type in write_binary");
+    }
+  }, d);
+}
+
+Data read_data(std::istream& in) {
+  switch (get<uint8_t>(in)) {
+    case 0: return std::monostate{};
+    case 1: return static_cast<int>(get<int32_t>(in));
+    case 2: return get<double>(in);
+    case 3: return get_vector<int>(in);
+    case 4: return get_vector<double>(in);
+    case 5: {
+      const double min = get<double>(in);
+      const double max = get<double>(in);
+      return Histogram1D(min, max, get_vector<double>(in));
+    }
+    case 6: {
+      const auto count = get<uint64_t>(in);
+      const double mean = get<double>(in);
+      return RunningMoments(count, mean, get<double>(in));
+    }
+    case 7: {
+      const auto count = get<uint64_t>(in);
+      const double min = get<double>(in);
+      return MinMax(count, min, get<double>(in));
+    }
+    case 8: {
+      const double compression = get<double>(in);
+      const double total_weight = get<double>(in);
+      const double min = get<double>(in);
+      const double max = get<double>(in);
+      auto centroids = get_vector<QuantileSketch::Centroid>(in);
+      return QuantileSketch(compression, total_weight, min, max,
+                            std::move(centroids), get_vector<QuantileSketch::Centroid>(in));
+    }
+    case 9: {
+      const auto count = get<uint64_t>(in);
+      const double sum = get<double>(in);
+      return KahanSum(count, sum, get<double>(in));
+    }
+    default: throw std::runtime_error("Unknown Data type in DataNode stream");
+  }
+}
+
+} // namespace
+
+void write_binary(std::ostream& out, const DataNode& node) {
+  binaryio::put_string(out, node.get_name());
+  write_data(out, node.get_data());
+  put(out, static_cast<uint32_t>(node.children().size()));
+  for (const auto& [key, child] : node.children()) {
+    write_binary(out, child);
+  }
+}
+
+namespace {
+// Result trees are a few levels deep. Anything deeper is taken as corrupt
+// input, since reading it (and later writing or destroying it, which also
+// recurse) could overflow the stack instead of throwing.
+constexpr size_t MAX_TREE_DEPTH = 256;
+
+DataNode read_node(std::istream& in, size_t depth) {
+  if (depth > MAX_TREE_DEPTH) throw std::runtime_error("DataNode stream nested too deeply");
+  DataNode node(binaryio::get_string(in));
+  node.get_data() = read_data(in);
+  const auto n_children = get<uint32_t>(in);
+  for (uint32_t i = 0; i < n_children; ++i) {
+    DataNode child = read_node(in, depth + 1);
+    const std::pmr::string key = child.get_name();
+    node.children().emplace(key, std::move(child));
+  }
+  return node;
+}
+} // namespace
+
+DataNode read_binary(std::istream& in) {
+  return read_node(in, 0);
+}
+
 namespace {
 // tolerances for doubles
 struct Tol { double rtol = 1e-6; double atol = 1e-9; };
@@ -78,10 +264,10 @@ inline bool approx_equal(double a, double b, const Tol& t) {
 template<class... Ts> struct overloaded : Ts... { using Ts::operator()...; };
 template<class... Ts> overloaded(Ts...) -> overloaded<Ts...>;
 
-inline std::string path_join(const std::string& p, const std::string& k) {
-  if (p.empty()) return k;
+inline std::string path_join(const std::string& p, std::string_view k) {
+  if (p.empty()) return std::string(k);
   if (k.empty()) return p;
-  return p + "/" + k;
+  return p + "/" + std::string(k);
 }
 } // namespace
 
@@ -115,6 +301,12 @@ void merge_values(Data& a, const Data& b, const std::string& path) {
       av += bv;
     },
 
+    // accumulators: +=
+    [&](RunningMoments& av, const RunningMoments& bv) { av += bv; },
+    [&](MinMax& av, const MinMax& bv) { av += bv; },
+    [&](QuantileSketch& av, const QuantileSketch& bv) { av += bv; },
+    [&](KahanSum& av, const KahanSum& bv) { av += bv; },
+
     // disallowed mixes (no int<->double or vec<int><->vec<double>)
     [&](int&, double) { throw std::runtime_error("type mix int/double at '" + path + "'"); },
     [&](double&, int) { throw std::runtime_error("type mix double/int at '" + path + "'"); },
@@ -132,42 +324,192 @@ void merge_values(Data& a, const Data& b, const std::string& path) {
   }, a, b);
 }
 
+DataNode& DataNode::add_path(std::string_view path) {
+  DataNode* node = this;
+  while (!path.empty()) {
+    const size_t slash = path.find('/');
+    const std::string_view key = path.substr(0, slash);
+    if (!key.empty()) {
+      auto it = node->subdata.find(key);
+      node = it != node->subdata.end() ? &it->second : &node->add_child(key);
+    }
+    if (slash == std::string_view::npos) break;
+    path.remove_prefix(slash + 1);
+  }
+  return *node;
+}
 
+// Iterative tree merge, copying from a const source or moving from an rvalue.
+struct DataNodeMerge {
+  template <bool Move>
+  using Source = std::conditional_t<Move, DataNode, const DataNode>;
 
-DataNode& DataNode::operator+=(const DataNode& other) {
-  // Recursive node merge
-  std::function<void(DataNode&, const DataNode&, const std::string&)> merge_nodes;
-
-  merge_nodes = [&](DataNode& dst, const DataNode& src, const std::string& path) {
-    const bool dv = dst.has_value();
-    const bool sv = src.has_value();
-    const bool dc = !dst.subdata.empty();
-    const bool sc = !src.subdata.empty();
-
-    // schema sanity
-    if (dv && dc) throw std::runtime_error("invalid schema at '" + path + "': both value and children");
-    if (sv && sc) throw std::runtime_error("invalid source schema at '" + path + "': both value and children");
-
-    // leaf vs internal is a hard conflict
-    if ((dv && sc) || (dc && sv)) throw std::runtime_error("schema conflict at '" + path + "'");
-
-    // leaf + leaf → delegate to free merge_values
-    if (dv && sv) {
-      ::merge_values(dst.value, src.value, path);
-      return;
-    }
-
-    // internal + internal → merge children by key
-    for (const auto& [k, schild] : src.subdata) {
-      auto it = dst.subdata.find(k);
-      if (it == dst.subdata.end()) {
-        dst.subdata.emplace(k, schild); // copy subtree
-      } else {
-        merge_nodes(it->second, schild, path_join(path, k));
+  template <bool Move>
+  static void merge(DataNode& dst, Source<Move>& src, const std::string& root) {
+    // Breadth-first over node pairs; parent/key let errors name the path
+    // without building a string per node.
+    struct Item {
+      DataNode* dst;
+      Source<Move>* src;
+      size_t parent;
+      const std::pmr::string* key;
+    };
+    std::vector<Item> items{{&dst, &src, 0, nullptr}};
+    auto path_of = [&](size_t i) {
+      std::vector<const std::pmr::string*> keys;
+      for (; i != 0; i = items[i].parent) keys.push_back(items[i].key);
+      std::string path = root;
+      for (auto it = keys.rbegin(); it != keys.rend(); ++it) path = path_join(path, **it);
+      return path;
+    };
+
+    for (size_t i = 0; i < items.size(); ++i) {
+      DataNode& d = *items[i].dst;
+      Source<Move>& s = *items[i].src;
+      const bool dv = d.has_value();
+      const bool sv = s.has_value();
+      const bool dc = !d.subdata.empty();
+      const bool sc = !s.subdata.empty();
+
+      // schema sanity
+      if (dv && dc) throw std::runtime_error("invalid schema at '" + path_of(i) + "': both value and children");
+      if (sv && sc) throw std::runtime_error("invalid source schema at '" + path_of(i) + "': both value and children");
+
+      // leaf vs internal is a hard conflict
+      if ((dv && sc) || (dc && sv)) throw std::runtime_error("schema conflict at '" + path_of(i) + "'");
+
+      // an empty destination takes the source as a whole (copying what
+      // lives in another resource)
+      if (!dv && !dc) {
+        if constexpr (Move) {
+          d.value = DataNode::move_data(std::move(s.value), d.get_allocator());
+          d.subdata = std::move(s.subdata);
+        } else {
+          d.value = DataNode::copy_data(s.value, d.get_allocator());
+          d.subdata = s.subdata;
+        }
+        continue;
+      }
+
+      // leaf + leaf → delegate to free merge_values; the path is only
+      // needed for its type-mismatch errors
+      if (dv && sv) {
+        ::merge_values(d.value, s.value,
+                       d.value.index() == s.value.index() ? std::string() : path_of(i));
+        continue;
+      }
+
+      // internal + internal → merge children by key, walking both sorted
+      // maps in step; new keys are copied, or spliced over from an rvalue
+      // source
+      auto dit = d.subdata.begin();
+      for (auto it = s.subdata.begin(); it != s.subdata.end();) {
+        auto next = std::next(it);
+        int order = 1;
+        while (dit != d.subdata.end() && (order = dit->first.compare(it->first)) < 0) ++dit;
+        if (dit == d.subdata.end() || order > 0) {
+          if constexpr (Move) {
+            // map nodes can only change owner within one resource
+            if (d.get_allocator() == s.get_allocator()) {
+              d.subdata.insert(dit, s.subdata.extract(it));
+            } else {
+              d.subdata.emplace_hint(dit, it->first, std::move(it->second));
+            }
+          } else {
+            d.subdata.emplace_hint(dit, it->first, it->second);
+          }
+        } else {
+          items.push_back({&dit->second, &it->second, i, &dit->first});
+          ++dit;
+        }
+        it = next;
       }
     }
+  }
+
+  // One part of merge_trees: sources merged into dst in order.
+  struct Group {
+    DataNode* dst;
+    std::vector<DataNode*> sources;
+    std::string path;
   };
 
-  merge_nodes(*this, other, name.empty() ? std::string{"<root>"} : name);
+  // Splits the merge into groups with disjoint destinations by descending
+  // through nodes that only have children, until there are enough groups.
+  static std::vector<Group> split(DataNode& dst, const std::vector<DataNode*>& sources,
+                                  const std::string& root, size_t target) {
+    std::vector<Group> groups{{&dst, sources, root}};
+    for (int depth = 0; depth < 8 && groups.size() < target; ++depth) {
+      std::vector<Group> next;
+      bool split_any = false;
+      for (auto& g : groups) {
+        bool internal = !g.dst->has_value();
+        for (const DataNode* src : g.sources) internal = internal && !src->has_value();
+        if (!internal) {
+          next.push_back(std::move(g));
+          continue;
+        }
+        split_any = true;
+        // Children keep their sources in source order; destinations that
+        // are missing start empty and take their first source as a whole.
+        std::map<const std::pmr::string*, size_t> group_of;
+        for (DataNode* src : g.sources) {
+          for (auto& [key, child] : src->subdata) {
+            auto dit = g.dst->subdata.try_emplace(key, std::string_view(key)).first;
+            auto [slot, inserted] = group_of.try_emplace(&dit->first, next.size());
+            if (inserted) next.push_back({&dit->second, {}, path_join(g.path, key)});
+            next[slot->second].sources.push_back(&child);
+          }
+        }
+      }
+      groups = std::move(next);
+      if (!split_any) break;
+    }
+    return groups;
+  }
+};
+
+DataNode& DataNode::operator+=(const DataNode& other) {
+  DataNodeMerge::merge<false>(*this, other, name.empty() ? std::string{"<root>"} : std::string(name));
   return *this;
 }
+
+DataNode& DataNode::operator+=(DataNode&& other) {
+  DataNodeMerge::merge<true>(*this, other, name.empty() ? std::string{"<root>"} : std::string(name));
+  return *this;
+}
+
+void merge_trees(DataNode& dst, const std::vector<DataNode*>& sources, int n_threads) {
+  const std::string root = dst.get_name().empty() ? std::string{"<root>"} : std::string(dst.get_name());
+  if (n_threads <= 1 || sources.size() < 2) {
+    for (DataNode* src : sources) DataNodeMerge::merge<true>(dst, *src, root);
+    return;
+  }
+
+  auto groups = DataNodeMerge::split(dst, sources, root, 4 * static_cast<size_t>(n_threads));
+  std::atomic<size_t> next_group{0};
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&]() {
+    for (size_t g = next_group++; g < groups.size() && !failed; g = next_group++) {
+      try {
+        for (DataNode* src : groups[g].sources) {
+          DataNodeMerge::merge<true>(*groups[g].dst, *src, groups[g].path);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = std::current_exception();
+        failed = true;
+      }
+    }
+  };
+
+  const size_t n = std::min(static_cast<size_t>(n_threads), groups.size());
+  std::vector<std::thread> threads;
+  threads.reserve(n);
+  for (size_t t = 1; t < n; ++t) threads.emplace_back(worker);
+  worker();
+  for (auto& t : threads) t.join();
+  if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,234 @@
+#include "eventindex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "binaryio.h"
+#include "mappedfile.h"
+
+namespace {
+// Modification time in clock ticks, 0 if it can't be read.
+int64_t file_mtime(const std::string& filename) {
+    std::error_code ec;
+    const auto mtime = std::filesystem::last_write_time(filename, ec);
+    return ec ? 0 : static_cast<int64_t>(mtime.time_since_epoch().count());
+}
+} // namespace
+
+std::string index_path(const std::string& filename) {
+    return filename + ".idx";
+}
+
+EventIndex EventIndex::build(const std::string& filename, size_t particle_size) {
+    // Taken before the scan, so a file rewritten meanwhile looks stale later.
+    const int64_t mtime = file_mtime(filename);
+    MappedFile map(filename);
+    const char* begin = map.data();
+    const char* cursor = begin;
+    const char* end = begin + map.size();
+
+    EventIndex index;
+    index.file_size_ = map.size();
+    index.file_mtime_ = mtime;
+    index.particle_size_ = particle_size;
+
+    Header header;
+    header.read(cursor, end);
+
+    // Mirrors BinaryReader: a block only counts if another block follows it.
+    auto next_is_block = [&]() {
+        if (cursor >= end) return false;
+        char next = *cursor;
+        if (next == 'p' || next == 'f' || next == 'i') return true;
+        ++cursor;
+        return false;
+    };
+
+    // Entry of the event `number`, which the block at `marker` belongs to.
+    auto entry_for = [&](int64_t number, const char* marker) -> EventIndexEntry& {
+        auto& entries = index.entries_;
+        if (entries.empty() || entries.back().event_number != number) {
+            EventIndexEntry e{};
+            e.offset = static_cast<uint64_t>(marker - begin);
+            e.event_number = static_cast<int32_t>(number);
+            entries.push_back(e);
+        }
+        return entries.back();
+    };
+
+    int64_t current_event = 0;
+    while (cursor < end) {
+        const char* marker = cursor;
+        char blockType = *cursor++;
+        switch (blockType) {
+            case 'p': {
+                ParticleBlock block;
+                block.read_header(take_bytes(cursor, end, ParticleBlock::HEADER_SIZE));
+                take_bytes(cursor, end, static_cast<size_t>(block.npart) * particle_size);
+                current_event = block.event_number;
+                if (next_is_block()) {
+                    EventIndexEntry& e = entry_for(current_event, marker);
+                    ++e.particle_blocks;
+                    e.particles += block.npart;
+                    e.end = static_cast<uint64_t>(cursor - begin);
+                }
+                break;
+            }
+            case 'f': {
+                EndBlock block;
+                block.read(cursor, end);
+                if (next_is_block()) {
+                    EventIndexEntry& e = entry_for(block.event_number, marker);
+                    ++e.end_blocks;
+                    e.end = static_cast<uint64_t>(cursor - begin);
+                }
+                current_event = static_cast<int64_t>(block.event_number) + 1;
+                break;
+            }
+            case 'i': {
+                InteractionBlock interaction;
+                interaction.read_header(take_bytes(cursor, end, InteractionBlock::HEADER_SIZE));
+                take_bytes(cursor, end, interaction.size() * particle_size);
+                if (next_is_block()) {
+                    EventIndexEntry& e = entry_for(current_event, marker);
+                    ++e.interaction_blocks;
+                    e.end = static_cast<uint64_t>(cursor - begin);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return index;
+}
+
+void EventIndex::save(const std::string& index_filename) const {
+    binaryio::write_binary_file(index_filename, [&](std::ostream& out) {
+        using binaryio::put;
+        out.write(MAGIC, sizeof(MAGIC));
+        put(out, VERSION);
+        put(out, file_size_);
+        put(out, file_mtime_);
+        put(out, static_cast<uint64_t>(particle_size_));
+        put(out, static_cast<uint64_t>(entries_.size()));
+        for (const auto& e : entries_) {
+            put(out, e.offset);
+            put(out, e.end);
+            put(out, e.event_number);
+            put(out, e.particle_blocks);
+            put(out, e.interaction_blocks);
+            put(out, e.end_blocks);
+            put(out, e.particles);
+        }
+    });
+}
+
+EventIndex EventIndex::load(const std::string& index_filename) {
+    std::ifstream in(index_filename, std::ios::binary);
+    if (!in) throw std::runtime_error("Could not open index: " + index_filename);
+
+    using binaryio::get;
+    char magic[4];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || get<uint16_t>(in) != VERSION) {
+        throw std::runtime_error("Not a bark event index: " + index_filename);
+    }
+
+    EventIndex index;
+    index.file_size_ = get<uint64_t>(in);
+    index.file_mtime_ = get<int64_t>(in);
+    index.particle_size_ = get<uint64_t>(in);
+    const auto count = get<uint64_t>(in);
+    for (uint64_t i = 0; i < count; ++i) {
+        EventIndexEntry e;
+        e.offset = get<uint64_t>(in);
+        e.end = get<uint64_t>(in);
+        e.event_number = get<int32_t>(in);
+        e.particle_blocks = get<uint32_t>(in);
+        e.interaction_blocks = get<uint32_t>(in);
+        e.end_blocks = get<uint32_t>(in);
+        e.particles = get<uint64_t>(in);
+        index.entries_.push_back(e);
+    }
+    return index;
+}
+
+EventIndex EventIndex::open(const std::string& filename, size_t particle_size, bool write_sidecar) {
+    const std::string sidecar = index_path(filename);
+    std::error_code ec;
+    const auto file_size = std::filesystem::file_size(filename, ec);
+    if (ec) throw std::runtime_error("Could not open file: " + filename);
+
+    if (std::filesystem::exists(sidecar, ec)) {
+        try {
+            EventIndex index = load(sidecar);
+            if (index.file_size_ == file_size && index.file_mtime_ == file_mtime(filename) &&
+                index.particle_size_ == particle_size) {
+                return index;
+            }
+        } catch (const std::exception&) {
+            // stale or corrupt sidecar: rebuild below
+        }
+    }
+
+    EventIndex index = build(filename, particle_size);
+    if (write_sidecar) {
+        try {
+            index.save(sidecar);
+        } catch (const std::exception&) {
+            // read-only location: the index still works in memory
+        }
+    }
+    return index;
+}
+
+uint64_t EventIndex::particle_block_count() const {
+    uint64_t count = 0;
+    for (const auto& e : entries_) count += e.particle_blocks;
+    return count;
+}
+
+uint64_t EventIndex::interaction_block_count() const {
+    uint64_t count = 0;
+    for (const auto& e : entries_) count += e.interaction_blocks;
+    return count;
+}
+
+uint64_t EventIndex::particle_count() const {
+    uint64_t count = 0;
+    for (const auto& e : entries_) count += e.particles;
+    return count;
+}
+
+size_t EventIndex::lower_bound(int32_t event) const {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), event,
+        [](const EventIndexEntry& e, int32_t ev) { return e.event_number < ev; });
+    return static_cast<size_t>(it - entries_.begin());
+}
+
+std::vector<EventRange> EventIndex::split(size_t parts) const {
+    std::vector<EventRange> ranges;
+    if (entries_.empty() || parts == 0) return ranges;
+
+    uint64_t total = 0;
+    for (const auto& e : entries_) total += e.end - e.offset;
+    uint64_t seen = 0;
+    size_t part = 1;
+    int32_t start = entries_.front().event_number;
+    for (size_t i = 0; i + 1 < entries_.size() && part < parts; ++i) {
+        seen += entries_[i].end - entries_[i].offset;
+        if (seen * parts >= total * part) {
+            const int32_t next = entries_[i + 1].event_number;
+            ranges.push_back({start, next});
+            start = next;
+            ++part;
+        }
+    }
+    ranges.push_back({start, std::numeric_limits<int32_t>::max()});
+    return ranges;
+}
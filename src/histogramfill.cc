@@ -0,0 +1,159 @@
+#include "histogramfill.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define BARK_X86_KERNELS 1
+#endif
+
+namespace {
+// q = (v - min) * inv_width differs from (v - min) / width by a few ulp at
+// most; only if an integer is this close (relative to q) can the bins differ.
+constexpr double edge_tolerance = 0x1p-48;
+
+void bins_scalar(const double* values, size_t n, const BinSpec& s, int32_t* out) {
+    const double last = static_cast<double>(s.bins - 1);
+    for (size_t i = 0; i < n; ++i) {
+        const double v = values[i];
+        if (!(v >= s.min && v < s.max)) {
+            out[i] = -1;
+            continue;
+        }
+        const double q = (v - s.min) * s.inv_width;  // >= 0 in range: truncation is floor
+        const double f = static_cast<double>(static_cast<int64_t>(q));
+        const double frac = q - f;
+        const double tol = (q + 1.0) * edge_tolerance;
+        out[i] = (frac <= tol || 1.0 - frac <= tol)
+                     ? bin_index(v, s)
+                     : static_cast<int32_t>(std::min(f, last));
+    }
+}
+
+#ifdef BARK_X86_KERNELS
+// Lanes outside the range or near an edge are patched from the bit masks.
+inline void fix_lanes(const double* values, unsigned in, unsigned edge, unsigned lanes,
+                      const BinSpec& s, int32_t* out) {
+    for (unsigned k = 0; k < lanes; ++k) {
+        if (!(in >> k & 1u)) {
+            out[k] = -1;
+        } else if (edge >> k & 1u) {
+            out[k] = bin_index(values[k], s);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+void bins_avx2(const double* values, size_t n, const BinSpec& s, int32_t* out) {
+    const __m256d vmin = _mm256_set1_pd(s.min);
+    const __m256d vmax = _mm256_set1_pd(s.max);
+    const __m256d inv = _mm256_set1_pd(s.inv_width);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d tol = _mm256_set1_pd(edge_tolerance);
+    const __m256d last = _mm256_set1_pd(static_cast<double>(s.bins - 1));
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d v = _mm256_loadu_pd(values + i);
+        const __m256d in = _mm256_and_pd(_mm256_cmp_pd(v, vmin, _CMP_GE_OQ),
+                                         _mm256_cmp_pd(v, vmax, _CMP_LT_OQ));
+        const __m256d q = _mm256_mul_pd(_mm256_sub_pd(v, vmin), inv);
+        const __m256d f = _mm256_floor_pd(q);
+        const __m256d frac = _mm256_sub_pd(q, f);
+        const __m256d t = _mm256_mul_pd(_mm256_add_pd(q, one), tol);
+        const __m256d edge = _mm256_or_pd(_mm256_cmp_pd(frac, t, _CMP_LE_OQ),
+                                          _mm256_cmp_pd(_mm256_sub_pd(one, frac), t, _CMP_LE_OQ));
+        // Out-of-range lanes convert to garbage here and are overwritten below.
+        const __m128i bins = _mm256_cvttpd_epi32(_mm256_min_pd(f, last));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bins);
+
+        const unsigned in_mask = static_cast<unsigned>(_mm256_movemask_pd(in));
+        const unsigned edge_mask = static_cast<unsigned>(_mm256_movemask_pd(edge)) & in_mask;
+        if (in_mask != 0xFu || edge_mask) fix_lanes(values + i, in_mask, edge_mask, 4, s, out + i);
+    }
+    bins_scalar(values + i, n - i, s, out + i);
+}
+
+__attribute__((target("avx512f")))
+void bins_avx512(const double* values, size_t n, const BinSpec& s, int32_t* out) {
+    const __m512d vmin = _mm512_set1_pd(s.min);
+    const __m512d vmax = _mm512_set1_pd(s.max);
+    const __m512d inv = _mm512_set1_pd(s.inv_width);
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d tol = _mm512_set1_pd(edge_tolerance);
+    const __m512d last = _mm512_set1_pd(static_cast<double>(s.bins - 1));
+    const __m256i outside = _mm256_set1_epi32(-1);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m512d v = _mm512_loadu_pd(values + i);
+        const __mmask8 in = _mm512_cmp_pd_mask(v, vmin, _CMP_GE_OQ) &
+                            _mm512_cmp_pd_mask(v, vmax, _CMP_LT_OQ);
+        const __m512d q = _mm512_mul_pd(_mm512_sub_pd(v, vmin), inv);
+        // Masked forms with an explicit passthrough; the unmasked ones trip
+        // -Wmaybe-uninitialized inside GCC 12's headers.
+        const __m512d f = _mm512_mask_roundscale_pd(q, 0xFF, q, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+        const __m512d frac = _mm512_sub_pd(q, f);
+        const __m512d t = _mm512_mul_pd(_mm512_add_pd(q, one), tol);
+        const __mmask8 edge = in & (_mm512_cmp_pd_mask(frac, t, _CMP_LE_OQ) |
+                                    _mm512_cmp_pd_mask(_mm512_sub_pd(one, frac), t, _CMP_LE_OQ));
+        const __m256i bins = _mm512_mask_cvttpd_epi32(outside, in, _mm512_mask_min_pd(f, 0xFF, f, last));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), bins);
+        if (edge) fix_lanes(values + i, in, edge, 8, s, out + i);
+    }
+    bins_scalar(values + i, n - i, s, out + i);
+}
+#endif
+
+using Kernel = void (*)(const double*, size_t, const BinSpec&, int32_t*);
+
+struct KernelChoice {
+    Kernel kernel;
+    const char* name;
+};
+
+KernelChoice select_kernel() {
+#ifdef BARK_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return {bins_avx512, "avx512"};
+    if (__builtin_cpu_supports("avx2")) return {bins_avx2, "avx2"};
+#endif
+    return {bins_scalar, "scalar"};
+}
+
+const KernelChoice& kernel() {
+    static const KernelChoice choice = select_kernel();
+    return choice;
+}
+} // namespace
+
+void compute_bins(const double* values, size_t n, const BinSpec& spec, int32_t* out) {
+    kernel().kernel(values, n, spec, out);
+}
+
+const char* bin_kernel_name() {
+    return kernel().name;
+}
+
+bool bin_kernel_supported(BinKernel kernel) {
+    switch (kernel) {
+        case BinKernel::Scalar: return true;
+#ifdef BARK_X86_KERNELS
+        case BinKernel::Avx2: __builtin_cpu_init(); return __builtin_cpu_supports("avx2");
+        case BinKernel::Avx512: __builtin_cpu_init(); return __builtin_cpu_supports("avx512f");
+#endif
+        default: return false;
+    }
+}
+
+void compute_bins(const double* values, size_t n, const BinSpec& spec, int32_t* out, BinKernel kernel) {
+    if (!bin_kernel_supported(kernel)) throw std::invalid_argument("Bin kernel not supported on this CPU");
+    switch (kernel) {
+#ifdef BARK_X86_KERNELS
+        case BinKernel::Avx2: bins_avx2(values, n, spec, out); return;
+        case BinKernel::Avx512: bins_avx512(values, n, spec, out); return;
+#endif
+        default: bins_scalar(values, n, spec, out); return;
+    }
+}
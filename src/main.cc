@@ -2,10 +2,159 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <sstream>
 
-#include "analysis.h"          // run_analysis(...)
+#include "analysis.h"          // run_analysis(...), merge_results(...)
                                 // parse_merge_key is called inside run_analysis
 #include "analysisregister.h"  // for list_registered()
+#include "columnarfile.h"
+#include "eventindex.h"
+
+namespace {
+// binary_reader index <file.bin>... [quantities...]
+int run_index(int argc, char* argv[]) {
+    std::vector<std::string> files;
+    std::vector<std::string> quantities;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (ends_with(arg, ".bin")) {
+            files.push_back(std::move(arg));
+        } else {
+            quantities.push_back(std::move(arg));
+        }
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0] << " index <file.bin>... [quantities...]\n";
+        return 1;
+    }
+
+    try {
+        for (const auto& file : files) {
+            // Without a quantity list the layout comes from the file's header.
+            const size_t particle_size = compute_particle_size(
+                quantities.empty() ? smash_quantities(read_file_header(file)) : quantities);
+            EventIndex index = EventIndex::build(file, particle_size);
+            index.save(index_path(file));
+            std::cout << file << ": " << index.event_count() << " events, "
+                      << index.particle_block_count() << " particle blocks, "
+                      << index.interaction_block_count() << " interaction blocks, "
+                      << index.particle_count() << " particles\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "index failed: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// binary_reader convert <file.bin>... [quantities...] [--chunk-events N] [--no-stats]
+int run_convert(int argc, char* argv[]) {
+    std::vector<std::string> files;
+    std::vector<std::string> quantities;
+    ConvertOptions options;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--no-stats") {
+            options.stats = false;
+        } else if (arg == "--chunk-events") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --chunk-events requires a number.\n";
+                return 1;
+            }
+            try {
+                options.chunk_events = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid --chunk-events value: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (ends_with(arg, ".bin")) {
+            files.push_back(std::move(arg));
+        } else {
+            quantities.push_back(std::move(arg));
+        }
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " convert <file.bin>... [quantities...] [--chunk-events N] [--no-stats]\n";
+        return 1;
+    }
+
+    try {
+        for (const auto& file : files) {
+            const std::string out = columnar_path(file);
+            convert_to_columnar(file, out, quantities, options);
+            std::cout << file << " -> " << out << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "convert failed: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// binary_reader merge <file.bark>... [--threads N] [--output-folder <path>]
+//                     [--format <yaml|binary|both>] [--no-save] [--no-print]
+int run_merge(int argc, char* argv[]) {
+    std::vector<std::string> inputs;
+    bool save_output = true;
+    bool print_output = true;
+    std::filesystem::path output_folder = ".";
+    int n_threads = 1;
+    OutputFormat format = OutputFormat::Yaml;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--no-save") {
+            save_output = false;
+        } else if (arg == "--no-print") {
+            print_output = false;
+        } else if (arg == "--output-folder") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --output-folder requires a path argument.\n";
+                return 1;
+            }
+            output_folder = argv[++i];
+        } else if (arg == "--threads") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --threads requires a number (0 = all cores).\n";
+                return 1;
+            }
+            try {
+                n_threads = std::stoi(argv[++i]);
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid --threads value: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--format") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --format requires yaml, binary or both.\n";
+                return 1;
+            }
+            try {
+                format = parse_output_format(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return 1;
+            }
+        } else {
+            inputs.push_back(std::move(arg));
+        }
+    }
+    if (inputs.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " merge <file.bark>... [--threads N] [--output-folder <path>]"
+                  << " [--format <yaml|binary|both>] [--no-save] [--no-print]\n";
+        return 1;
+    }
+
+    try {
+        merge_results(inputs, save_output, print_output, output_folder.string(), n_threads, format);
+    } catch (const std::exception& e) {
+        std::cerr << "merge failed: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+} // namespace
 
 int main(int argc, char* argv[]) {
     if (argc > 1 && std::string(argv[1]) == "--list-analyses") {
@@ -17,10 +166,36 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-    if (argc < 4) {
+    if (argc > 1 && std::string(argv[1]) == "index") {
+        return run_index(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "convert") {
+        return run_convert(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "merge") {
+        return run_merge(argc, argv);
+    }
+
+    if (argc < 3) {
         std::cerr << "Usage: " << argv[0]
-                  << " <file[:key=val,...]>... <analysis> <quantities...>"
-                  << " [--no-save] [--no-print] [--output-folder <path>]\n"
+                  << " <file[:key=val,...]>... <analysis[,analysis...]> [quantities...]"
+                  << " [--no-save] [--no-print] [--output-folder <path>]"
+                  << " [--read-mode <stream|mmap|readahead>] [--threads <N>]"
+                  << " [--block-workers <N>] [--events <first:last>]"
+                  << " [--pdg <pdg,...>] [--charge <q,...>]"
+                  << " [--cut <quantity:min:max>] [--abs-cut <quantity:min:max>]"
+                  << " [--cache <dir>]"
+                  << " [--checkpoint <file>] [--checkpoint-every <seconds>] [--resume]"
+                  << " [--format <yaml|binary|both>]"
+                  << " [--shard <i/N>] [--shard-by <files|events>]\n"
+                  << "       or: " << argv[0] << " index <file.bin>... [quantities...]\n"
+                  << "       or: " << argv[0]
+                  << " convert <file.bin>... [quantities...] [--chunk-events N] [--no-stats]\n"
+                  << "       or: " << argv[0]
+                  << " merge <file.bark>... [--threads N] [--output-folder <path>]"
+                  << " [--format <yaml|binary|both>] [--no-save] [--no-print]\n"
                   << "       or: " << argv[0] << " --list-analyses\n";
         return 1;
     }
@@ -31,8 +206,8 @@ int main(int argc, char* argv[]) {
     int i = 1;
     for (; i < argc; ++i) {
         std::string arg = argv[i];
-        // treat anything with ":" or ending in ".bin" as an input spec
-        if (ends_with(arg, ".bin") || arg.find(':') != std::string::npos) {
+        // treat anything with ":" or ending in ".bin"/".bkc" as an input spec
+        if (ends_with(arg, ".bin") || ends_with(arg, ".bkc") || arg.find(':') != std::string::npos) {
             auto pos = arg.find(':');
             if (pos == std::string::npos) {
                 file_and_meta.emplace_back(arg, std::string{});
@@ -48,12 +223,30 @@ int main(int argc, char* argv[]) {
         std::cerr << "Error: No analysis specified.\n";
         return 1;
     }
-    const std::string analysis_name = argv[i++];
+    // A comma-separated list runs several analyses in a single pass.
+    std::vector<std::string> analysis_names;
+    {
+        std::stringstream ss(argv[i++]);
+        std::string name;
+        while (std::getline(ss, name, ',')) {
+            if (!name.empty()) analysis_names.push_back(name);
+        }
+    }
 
     // Flags and quantities
     bool save_output = true;
     bool print_output = true;
     std::filesystem::path output_folder = ".";
+    ReadMode read_mode = ReadMode::Stream;
+    int n_threads = 1;
+    int block_workers = 1;
+    EventRange events;
+    ParticleFilter filter;
+    std::string cache_dir;
+    CheckpointOptions checkpoint;
+    OutputFormat format = OutputFormat::Yaml;
+    ShardSpec shard;
+    ShardSpec::Mode shard_mode = ShardSpec::Mode::Files;
     std::vector<std::string> quantities;
 
     for (; i < argc; ++i) {
@@ -68,18 +261,159 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
             output_folder = argv[++i];
+        } else if (arg == "--read-mode") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --read-mode requires stream, mmap or readahead.\n";
+                return 1;
+            }
+            try {
+                read_mode = parse_read_mode(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return 1;
+            }
+        } else if (arg == "--threads") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --threads requires a number (0 = all cores).\n";
+                return 1;
+            }
+            try {
+                n_threads = std::stoi(argv[++i]);
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid --threads value: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--block-workers") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --block-workers requires a number.\n";
+                return 1;
+            }
+            try {
+                block_workers = std::stoi(argv[++i]);
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid --block-workers value: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--events") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --events requires a range first:last.\n";
+                return 1;
+            }
+            try {
+                events = parse_event_range(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return 1;
+            }
+        } else if (arg == "--cache") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --cache requires a directory.\n";
+                return 1;
+            }
+            cache_dir = argv[++i];
+        } else if (arg == "--checkpoint") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --checkpoint requires a file.\n";
+                return 1;
+            }
+            checkpoint.path = argv[++i];
+        } else if (arg == "--checkpoint-every") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --checkpoint-every requires a number of seconds.\n";
+                return 1;
+            }
+            try {
+                checkpoint.interval = std::stod(argv[++i]);
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid --checkpoint-every value: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--resume") {
+            checkpoint.resume = true;
+        } else if (arg == "--format") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --format requires yaml, binary or both.\n";
+                return 1;
+            }
+            try {
+                format = parse_output_format(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return 1;
+            }
+        } else if (arg == "--shard") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --shard requires i/N.\n";
+                return 1;
+            }
+            try {
+                shard = parse_shard(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return 1;
+            }
+        } else if (arg == "--shard-by") {
+            const std::string by = i + 1 < argc ? argv[++i] : "";
+            if (by == "files") {
+                shard_mode = ShardSpec::Mode::Files;
+            } else if (by == "events") {
+                shard_mode = ShardSpec::Mode::Events;
+            } else {
+                std::cerr << "Error: --shard-by requires files or events.\n";
+                return 1;
+            }
+        } else if (arg == "--pdg" || arg == "--charge") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << arg << " requires a comma-separated list.\n";
+                return 1;
+            }
+            try {
+                auto values = parse_int_list(argv[++i]);
+                auto& into = arg == "--pdg" ? filter.pdgs : filter.charges;
+                into.insert(into.end(), values.begin(), values.end());
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return 1;
+            }
+        } else if (arg == "--cut" || arg == "--abs-cut") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << arg << " requires quantity:min:max.\n";
+                return 1;
+            }
+            try {
+                filter.cuts.push_back(parse_cut(argv[++i], arg == "--abs-cut"));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return 1;
+            }
         } else {
             quantities.push_back(std::move(arg));
         }
     }
 
+    if (checkpoint.resume && checkpoint.path.empty()) {
+        std::cerr << "Error: --resume requires --checkpoint <file>.\n";
+        return 1;
+    }
+
+    shard.mode = shard_mode;
+
     try {
         run_analysis(file_and_meta,
-                     analysis_name,
+                     analysis_names,
                      quantities,
                      save_output,
                      print_output,
-                     output_folder.string());
+                     output_folder.string(),
+                     read_mode,
+                     n_threads,
+                     block_workers,
+                     events,
+                     filter,
+                     cache_dir,
+                     checkpoint,
+                     format,
+                     shard);
     } catch (const std::exception& e) {
         std::cerr << "run_analysis failed: " << e.what() << "\n";
         return 1;
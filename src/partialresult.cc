@@ -0,0 +1,112 @@
+#include "partialresult.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "binaryio.h"
+#include "analysisregister.h"
+
+namespace {
+using binaryio::get;
+using binaryio::get_string;
+using binaryio::put;
+using binaryio::put_string;
+
+void put_keys(std::ostream& out, const MergeKeySet& keys) {
+    put(out, static_cast<uint32_t>(keys.size()));
+    for (const auto& k : keys) {
+        put_string(out, k.name);
+        put(out, static_cast<uint8_t>(k.value.index()));
+        std::visit([&](const auto& v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, std::string>) {
+                put_string(out, v);
+            } else if constexpr (std::is_same_v<T, int>) {
+                put(out, static_cast<int32_t>(v));
+            } else {
+                put(out, v);
+            }
+        }, k.value);
+    }
+}
+
+MergeKeySet get_keys(std::istream& in) {
+    MergeKeySet keys;
+    const auto n = get<uint32_t>(in);
+    for (uint32_t i = 0; i < n; ++i) {
+        std::string name = get_string(in);
+        switch (get<uint8_t>(in)) {
+            case 0: keys.emplace_back(std::move(name), static_cast<int>(get<int32_t>(in))); break;
+            case 1: keys.emplace_back(std::move(name), get<double>(in)); break;
+            case 2: keys.emplace_back(std::move(name), get_string(in)); break;
+            default: throw std::runtime_error("Unknown merge key type in result stream");
+        }
+    }
+    return keys;
+}
+} // namespace
+
+void write_entries(std::ostream& out, const std::vector<Entry>& entries) {
+    put(out, static_cast<uint32_t>(entries.size()));
+    for (const auto& e : entries) {
+        put_keys(out, e.key);
+        put_string(out, e.analysis->get_smash_version());
+        write_binary(out, e.analysis->get_data());
+    }
+}
+
+std::vector<Entry> read_entries(std::istream& in, const std::string& analysis_name) {
+    std::vector<Entry> entries;
+    const auto n = get<uint32_t>(in);
+    for (uint32_t k = 0; k < n; ++k) {
+        MergeKeySet key = get_keys(in);
+        const std::string smash_version = get_string(in);
+        auto analysis = AnalysisRegistry::instance().create(analysis_name);
+        if (!analysis) throw std::runtime_error("Unknown analysis: " + analysis_name);
+        analysis->set_merge_keys(key);
+        analysis->restore(smash_version, read_binary(in));
+        entries.push_back(Entry{std::move(key), std::move(analysis)});
+    }
+    return entries;
+}
+
+void PartialResult::save(const std::string& filename) const {
+    binaryio::write_binary_file(filename, [&](std::ostream& out) {
+        out.write(MAGIC, sizeof(MAGIC));
+        put(out, VERSION);
+        put_string(out, analysis_name);
+        put_string(out, provenance.run);
+        put(out, provenance.shard_count);
+        put(out, static_cast<uint32_t>(provenance.shards.size()));
+        for (uint32_t shard : provenance.shards) put(out, shard);
+        put_string(out, config);
+        put_string(out, analysis_config);
+        write_entries(out, entries);
+    });
+}
+
+PartialResult PartialResult::load(const std::string& filename, bool with_entries) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) throw std::runtime_error("Could not open file: " + filename);
+
+    char magic[sizeof(MAGIC)];
+    in.read(magic, sizeof(magic));
+    if (!in || !std::equal(magic, magic + sizeof(MAGIC), MAGIC)) {
+        throw std::runtime_error("Not a partial result file: " + filename);
+    }
+    if (get<uint16_t>(in) != VERSION) {
+        throw std::runtime_error("Unsupported partial result version: " + filename);
+    }
+
+    PartialResult result;
+    result.analysis_name = get_string(in);
+    result.provenance.run = get_string(in);
+    result.provenance.shard_count = get<uint32_t>(in);
+    const auto n = get<uint32_t>(in);
+    for (uint32_t k = 0; k < n; ++k) result.provenance.shards.push_back(get<uint32_t>(in));
+    result.config = get_string(in);
+    result.analysis_config = get_string(in);
+    if (with_entries) result.entries = read_entries(in, result.analysis_name);
+    return result;
+}
@@ -0,0 +1,189 @@
+#include "particlefilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+size_t offset_of(const std::unordered_map<Quantity, size_t>& layout, Quantity q) {
+    auto it = layout.find(q);
+    if (it == layout.end()) {
+        throw std::runtime_error("Filter quantity not in layout: " + quantity_name(q));
+    }
+    return it->second;
+}
+
+// Strided gather of one field of every record into a contiguous array.
+template <typename T>
+void gather(const ParticleBlock& block, size_t offset, std::vector<T>& out) {
+    out.resize(block.npart);
+    const char* p = block.data + offset;
+    const size_t stride = block.particle_size;
+    T* dst = out.data();
+    for (uint32_t i = 0; i < block.npart; ++i, p += stride) {
+        std::memcpy(dst + i, p, sizeof(T));
+    }
+}
+
+// mask[i] &= column[i] is one of `values`.
+void keep_matching(std::vector<uint8_t>& mask, const std::vector<int32_t>& column,
+                   const std::vector<int32_t>& values)
+{
+    const size_t n = column.size();
+    const int32_t* col = column.data();
+    uint8_t* m = mask.data();
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t hit = 0;
+        for (int32_t v : values) hit |= static_cast<uint8_t>(col[i] == v);
+        m[i] &= hit;
+    }
+}
+
+void keep_in_range(std::vector<uint8_t>& mask, const std::vector<double>& column,
+                   const ParticleFilter::Cut& cut)
+{
+    const size_t n = column.size();
+    const double* col = column.data();
+    uint8_t* m = mask.data();
+    if (cut.absolute) {
+        for (size_t i = 0; i < n; ++i) {
+            const double v = std::fabs(col[i]);
+            m[i] &= static_cast<uint8_t>((v >= cut.min) & (v < cut.max));
+        }
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            const double v = col[i];
+            m[i] &= static_cast<uint8_t>((v >= cut.min) & (v < cut.max));
+        }
+    }
+}
+} // namespace
+
+std::vector<Quantity> ParticleFilter::quantities() const {
+    std::vector<Quantity> qs;
+    if (!pdgs.empty()) qs.push_back(Quantity::PDG);
+    if (!charges.empty()) qs.push_back(Quantity::CHARGE);
+    for (const auto& cut : cuts) qs.push_back(cut.quantity);
+    return qs;
+}
+
+bool ParticleFilter::may_match(
+    const std::unordered_map<Quantity, std::pair<double, double>>& ranges) const
+{
+    auto any_in = [&](Quantity q, const std::vector<int32_t>& values) {
+        auto it = ranges.find(q);
+        if (values.empty() || it == ranges.end()) return true;
+        const auto [lo, hi] = it->second;
+        return std::any_of(values.begin(), values.end(),
+                           [&](int32_t v) { return v >= lo && v <= hi; });
+    };
+    if (!any_in(Quantity::PDG, pdgs) || !any_in(Quantity::CHARGE, charges)) return false;
+
+    for (const auto& cut : cuts) {
+        auto it = ranges.find(cut.quantity);
+        if (it == ranges.end()) continue;
+        double lo = it->second.first, hi = it->second.second;
+        if (lo > hi) return false;  // no values at all
+        if (cut.absolute) {
+            const double a = std::fabs(lo), b = std::fabs(hi);
+            lo = (lo <= 0.0 && hi >= 0.0) ? 0.0 : std::min(a, b);
+            hi = std::max(a, b);
+        }
+        if (hi < cut.min || lo >= cut.max) return false;
+    }
+    return true;
+}
+
+void ParticleFilter::bind(const std::unordered_map<Quantity, size_t>& layout) {
+    if (!pdgs.empty()) pdg_offset = offset_of(layout, Quantity::PDG);
+    if (!charges.empty()) charge_offset = offset_of(layout, Quantity::CHARGE);
+    cut_offsets.clear();
+    cut_types.clear();
+    for (const auto& cut : cuts) {
+        cut_offsets.push_back(offset_of(layout, cut.quantity));
+        cut_types.push_back(quantity_type(cut.quantity));
+    }
+    bound = true;
+}
+
+void ParticleFilter::apply(ParticleBlock& block) {
+    if (!bound) throw std::runtime_error("ParticleFilter used before bind()");
+    const uint32_t n = block.npart;
+    mask.assign(n, 1);
+
+    if (!pdgs.empty()) {
+        gather(block, pdg_offset, int_column);
+        keep_matching(mask, int_column, pdgs);
+    }
+    if (!charges.empty()) {
+        gather(block, charge_offset, int_column);
+        keep_matching(mask, int_column, charges);
+    }
+    for (size_t c = 0; c < cuts.size(); ++c) {
+        if (cut_types[c] == QuantityType::Double) {
+            gather(block, cut_offsets[c], double_column);
+        } else {
+            gather(block, cut_offsets[c], int_column);
+            double_column.assign(int_column.begin(), int_column.end());
+        }
+        keep_in_range(mask, double_column, cuts[c]);
+    }
+
+    uint32_t survivors = 0;
+    for (uint32_t i = 0; i < n; ++i) survivors += mask[i];
+    if (survivors == n) return;
+
+    // Pack the survivors; their order is kept.
+    const size_t ps = block.particle_size;
+    records.resize(static_cast<size_t>(survivors) * ps);
+    char* out = records.data();
+    const char* in = block.data;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < n; ++i, in += ps) {
+        if (!mask[i]) continue;
+        std::memcpy(out + static_cast<size_t>(kept) * ps, in, ps);
+        ++kept;
+    }
+    block.npart = kept;
+    block.set_records(records.data(), ps, false);
+}
+
+ParticleFilter::Cut parse_cut(const std::string& spec, bool absolute) {
+    const auto first = spec.find(':');
+    const auto second = first == std::string::npos ? first : spec.find(':', first + 1);
+    if (second == std::string::npos) {
+        throw std::runtime_error("Invalid cut '" + spec + "' (expected quantity:min:max)");
+    }
+    const std::string name = spec.substr(0, first);
+    auto it = quantity_string_map.find(name);
+    if (it == quantity_string_map.end()) throw std::runtime_error("Unknown quantity: " + name);
+
+    ParticleFilter::Cut cut{it->second.quantity};
+    cut.absolute = absolute;
+    try {
+        const std::string lo = spec.substr(first + 1, second - first - 1);
+        const std::string hi = spec.substr(second + 1);
+        if (!lo.empty()) cut.min = std::stod(lo);
+        if (!hi.empty()) cut.max = std::stod(hi);
+    } catch (const std::exception&) {
+        throw std::runtime_error("Invalid cut '" + spec + "' (expected quantity:min:max)");
+    }
+    return cut;
+}
+
+std::vector<int32_t> parse_int_list(const std::string& spec) {
+    std::vector<int32_t> values;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        try {
+            values.push_back(std::stoi(item));
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid integer '" + item + "' in '" + spec + "'");
+        }
+    }
+    return values;
+}
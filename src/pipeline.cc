@@ -0,0 +1,148 @@
+#include "pipeline.h"
+
+#include <stdexcept>
+
+PipelinedAccessor::PipelinedAccessor(std::vector<std::vector<std::shared_ptr<Analysis>>> analyses,
+                                     size_t batch_size_in)
+    : batch_size(batch_size_in == 0 ? 1 : batch_size_in)
+{
+    if (analyses.empty()) throw std::runtime_error("PipelinedAccessor needs at least one worker");
+    const size_t per_worker = analyses.front().size();
+    for (auto& list : analyses) {
+        if (list.size() != per_worker) {
+            throw std::runtime_error("PipelinedAccessor workers need the same analyses");
+        }
+        auto w = std::make_unique<Worker>();
+        w->analyses = std::move(list);
+        w->dispatcher = std::make_shared<DispatchingAccessor>();
+        for (auto& a : w->analyses) w->dispatcher->register_analysis(a);
+        workers.push_back(std::move(w));
+    }
+}
+
+PipelinedAccessor::~PipelinedAccessor() {
+    stop();
+}
+
+void PipelinedAccessor::on_header(Header& header) {
+    for (auto& w : workers) {
+        w->dispatcher->set_layout(layout);
+        w->dispatcher->on_header(header);
+    }
+    for (auto& w : workers) {
+        if (!w->thread.joinable()) {
+            Worker* worker = w.get();
+            w->thread = std::thread([this, worker] { run_worker(*worker); });
+        }
+    }
+}
+
+// A full batch is handed on when the next event starts, never in the
+// middle of one. Particle and end blocks carry their event number; with
+// ensembles an event has one of each per ensemble. Interaction blocks carry
+// none, so one right after an end block is taken to start the next event.
+void PipelinedAccessor::begin_block(bool new_event) {
+    rethrow_if_failed();
+    if (new_event && current.size() >= batch_size) dispatch_batch();
+}
+
+void PipelinedAccessor::on_particle_block(const ParticleBlock& block) {
+    begin_block(block.event_number != last_event);
+    last_event = block.event_number;
+    after_end = false;
+    if (current.n_blocks == current.blocks.size()) current.blocks.emplace_back();
+    current.blocks[current.n_blocks++].retain(block);
+    current.order.push_back('p');
+}
+
+void PipelinedAccessor::on_interaction_block(const InteractionBlock& block) {
+    begin_block(after_end);
+    after_end = false;
+    if (current.n_interactions == current.interactions.size()) current.interactions.emplace_back();
+    current.interactions[current.n_interactions++].retain(block);
+    current.order.push_back('i');
+}
+
+void PipelinedAccessor::on_end_block(const EndBlock& block) {
+    begin_block(static_cast<int64_t>(block.event_number) != last_event);
+    last_event = block.event_number;
+    after_end = true;
+    current.ends.push_back(block);
+    current.order.push_back('f');
+}
+
+void PipelinedAccessor::dispatch_batch() {
+    if (current.size() == 0) return;
+    Worker& w = *workers[next_worker];
+    next_worker = (next_worker + 1) % workers.size();
+    if (!w.queue.push(std::move(current))) rethrow_if_failed();
+    if (!free_batches.try_pop(current)) current = Batch{};
+}
+
+void PipelinedAccessor::run_worker(Worker& worker) {
+    Batch batch;
+    while (worker.queue.pop(batch)) {
+        if (!failed) {
+            try {
+                size_t p = 0, i = 0, f = 0;
+                for (char kind : batch.order) {
+                    if (kind == 'p') {
+                        worker.dispatcher->on_particle_block(batch.blocks[p++]);
+                    } else if (kind == 'i') {
+                        worker.dispatcher->on_interaction_block(batch.interactions[i++]);
+                    } else {
+                        worker.dispatcher->on_end_block(batch.ends[f++]);
+                    }
+                }
+            } catch (...) {
+                fail(std::current_exception());
+            }
+        }
+        batch.clear();
+        free_batches.push(std::move(batch));
+    }
+}
+
+void PipelinedAccessor::fail(std::exception_ptr e) {
+    {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = e;
+    }
+    failed = true;
+    for (auto& w : workers) w->queue.close();
+}
+
+void PipelinedAccessor::rethrow_if_failed() {
+    if (!failed) return;
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if (error) std::rethrow_exception(error);
+    throw std::runtime_error("Block worker failed");
+}
+
+void PipelinedAccessor::stop() {
+    for (auto& w : workers) w->queue.close();
+    for (auto& w : workers) {
+        if (w->thread.joinable()) w->thread.join();
+    }
+}
+
+std::vector<std::shared_ptr<Analysis>> PipelinedAccessor::finish() {
+    if (!failed) dispatch_batch();
+    stop();
+    rethrow_if_failed();
+
+    // The workers are done, so their threads' worth of cores merge the
+    // trees (see merge_trees; the result matches merging in worker order).
+    std::vector<std::shared_ptr<Analysis>> result = workers.front()->analyses;
+    for (size_t a = 0; a < result.size(); ++a) {
+        std::vector<Analysis*> others;
+        for (size_t k = 1; k < workers.size(); ++k) others.push_back(workers[k]->analyses[a].get());
+        result[a]->merge_from(others, static_cast<int>(workers.size()));
+    }
+    return result;
+}
+
+void PipelinedAccessor::abort() {
+    fail(nullptr);
+    stop();
+}
@@ -0,0 +1,162 @@
+#include "readahead.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+constexpr size_t BUFFER_ALIGNMENT = 4096;
+}
+
+void ReadAheadFile::AlignedFree::operator()(char* p) const {
+    std::free(p);
+}
+
+ReadAheadFile::ReadAheadFile(const std::string& filename_in, size_t buffer_size_in, size_t n_buffers)
+    : filename(filename_in),
+      buffer_size((std::max(buffer_size_in, BUFFER_ALIGNMENT) + BUFFER_ALIGNMENT - 1)
+                  / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT)
+{
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    // One buffer is parsed, one may be retired, the rest are in flight.
+    n_buffers = std::max<size_t>(n_buffers, 3);
+    for (size_t i = 0; i < n_buffers; ++i) {
+        char* p = static_cast<char*>(std::aligned_alloc(BUFFER_ALIGNMENT, buffer_size));
+        if (!p) {
+            ::close(fd);
+            throw std::bad_alloc();
+        }
+        buffers.emplace_back(p);
+    }
+    start(0);
+}
+
+ReadAheadFile::~ReadAheadFile() {
+    stop();
+    if (fd >= 0) ::close(fd);
+}
+
+void ReadAheadFile::start(uint64_t offset) {
+    free_slots = std::make_unique<BlockingQueue<size_t>>();
+    filled = std::make_unique<BlockingQueue<Filled>>();
+    for (size_t i = 0; i < buffers.size(); ++i) free_slots->push(i);
+
+    current = no_slot;
+    current_size = 0;
+    pos = 0;
+    retired = no_slot;
+    eof = false;
+    read_error = 0;
+
+    producer = std::thread([this, offset] { produce(offset); });
+}
+
+void ReadAheadFile::stop() {
+    if (free_slots) free_slots->close();
+    if (filled) filled->close();
+    if (producer.joinable()) producer.join();
+}
+
+void ReadAheadFile::seek(uint64_t offset) {
+    stop();
+    start(offset);
+}
+
+void ReadAheadFile::produce(uint64_t offset) {
+    size_t slot;
+    while (free_slots->pop(slot)) {
+        char* buf = buffers[slot].get();
+        size_t got = 0;
+        while (got < buffer_size) {
+            ssize_t n = ::pread(fd, buf + got, buffer_size - got, static_cast<off_t>(offset + got));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                read_error = errno;
+                filled->push({slot, 0});
+                return;
+            }
+            if (n == 0) break;
+            got += static_cast<size_t>(n);
+        }
+        offset += got;
+        if (!filled->push({slot, got})) return;
+        if (got == 0) return;
+    }
+}
+
+void ReadAheadFile::release(size_t slot) {
+    if (slot != no_slot) free_slots->push(slot);
+}
+
+bool ReadAheadFile::advance() {
+    if (eof) return false;
+    release(retired);
+    retired = current;
+    current = no_slot;
+    current_size = 0;
+    pos = 0;
+
+    Filled f;
+    if (!filled->pop(f)) {
+        eof = true;
+        return false;
+    }
+    if (f.size == 0) {
+        release(f.slot);
+        eof = true;
+        if (read_error) {
+            throw std::runtime_error("Read failed for " + filename + ": " + std::strerror(read_error));
+        }
+        return false;
+    }
+    current = f.slot;
+    current_size = f.size;
+    return true;
+}
+
+bool ReadAheadFile::next(char& c) {
+    // The previous block has been handed out and processed.
+    release(retired);
+    retired = no_slot;
+    if (pos == current_size && !advance()) return false;
+    c = buffers[current].get()[pos++];
+    return true;
+}
+
+bool ReadAheadFile::peek(char& c) {
+    if (pos == current_size && !advance()) return false;
+    c = buffers[current].get()[pos];
+    return true;
+}
+
+const char* ReadAheadFile::take(size_t n) {
+    if (current != no_slot && current_size - pos >= n) {
+        const char* p = buffers[current].get() + pos;
+        pos += n;
+        return p;
+    }
+
+    // Straddles a buffer boundary: gather into the staging copy.
+    staging.resize(n);
+    size_t got = 0;
+    while (got < n) {
+        if (pos == current_size && !advance()) throw std::runtime_error("Read failed");
+        size_t k = std::min(n - got, current_size - pos);
+        std::memcpy(staging.data() + got, buffers[current].get() + pos, k);
+        got += k;
+        pos += k;
+    }
+    return staging.data();
+}
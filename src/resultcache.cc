@@ -0,0 +1,101 @@
+#include "resultcache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "binaryio.h"
+
+namespace {
+constexpr uint64_t fnv_offset = 14695981039346656037ull;
+constexpr uint64_t fnv_prime = 1099511628211ull;
+
+uint64_t fnv1a(const char* data, size_t n, uint64_t h = fnv_offset) {
+    for (size_t i = 0; i < n; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= fnv_prime;
+    }
+    return h;
+}
+
+std::string hex(uint64_t v) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+    return buf;
+}
+} // namespace
+
+ResultCache::ResultCache(std::string directory_in) : directory(std::move(directory_in)) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) throw std::runtime_error("Could not create cache directory " + directory + ": " + ec.message());
+}
+
+std::string ResultCache::file_fingerprint(const std::string& path) {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(path, ec);
+    if (ec) throw std::runtime_error("Could not open file: " + path);
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) throw std::runtime_error("Could not stat file: " + path);
+
+    constexpr size_t sample = 1 << 20;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Could not open file: " + path);
+    std::vector<char> buffer(std::min<uintmax_t>(sample, size));
+    in.read(buffer.data(), buffer.size());
+    uint64_t h = fnv1a(buffer.data(), buffer.size());
+    if (size > sample) {
+        in.seekg(static_cast<std::streamoff>(size - buffer.size()));
+        in.read(buffer.data(), buffer.size());
+        h = fnv1a(buffer.data(), buffer.size(), h);
+    }
+    if (!in) throw std::runtime_error("Read failed: " + path);
+
+    std::ostringstream fp;
+    fp << size << ':' << mtime.time_since_epoch().count() << ':' << hex(h);
+    return fp.str();
+}
+
+std::string ResultCache::make_key(const std::string& fingerprint,
+                                  const std::string& analysis_name,
+                                  const std::string& analysis_config,
+                                  const std::string& config)
+{
+    return analysis_name + '|' + fingerprint + '|' + analysis_config + '|' + config;
+}
+
+std::string ResultCache::entry_path(const std::string& key) const {
+    const std::string name = key.substr(0, key.find('|'));
+    return (std::filesystem::path(directory) /
+            (name + '-' + hex(fnv1a(key.data(), key.size())) + ".bkr")).string();
+}
+
+bool ResultCache::load(const std::string& key, Analysis& analysis) const {
+    std::ifstream in(entry_path(key), std::ios::binary);
+    if (!in) return false;
+    try {
+        char magic[sizeof(MAGIC)];
+        in.read(magic, sizeof(magic));
+        if (!in || !std::equal(magic, magic + sizeof(MAGIC), MAGIC)) return false;
+        if (binaryio::get<uint16_t>(in) != VERSION) return false;
+        // The file name is a hash of the key; a different stored key is a collision.
+        if (binaryio::get_string(in) != key) return false;
+        const std::string smash_version = binaryio::get_string(in);
+        analysis.restore(smash_version, read_binary(in));
+        return true;
+    } catch (const std::exception&) {
+        return false;  // unreadable entry: recompute and overwrite it
+    }
+}
+
+void ResultCache::store(const std::string& key, const Analysis& analysis) const {
+    binaryio::write_binary_file(entry_path(key), [&](std::ostream& out) {
+        out.write(MAGIC, sizeof(MAGIC));
+        binaryio::put(out, VERSION);
+        binaryio::put_string(out, key);
+        binaryio::put_string(out, analysis.get_smash_version());
+        write_binary(out, analysis.get_data());
+    });
+}
@@ -0,0 +1,210 @@
+#include "yamlwriter.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+
+#include <yaml-cpp/yaml.h>
+
+#include "binaryio.h"
+
+namespace {
+// Strings yaml-cpp writes unquoted: identifier-like names, numbers, versions.
+// Anything else goes through YAML::Emitter so quoting and escaping match.
+bool is_simple_plain(std::string_view s) {
+    if (s.empty() || s == "-" || s == "null" || s == "Null" || s == "NULL") return false;
+    for (char c : s) {
+        const bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                        (c >= '0' && c <= '9') ||
+                        c == '_' || c == '-' || c == '.' || c == '+' || c == '/';
+        if (!ok) return false;
+    }
+    return true;
+}
+} // namespace
+
+YamlWriter::YamlWriter(const std::string& filename, size_t buffer_size)
+    : filename_(filename), tmp_(binaryio::unique_temp_path(filename)),
+      out_(tmp_, std::ios::binary), buffer_size_(buffer_size)
+{
+    if (!out_) throw std::runtime_error("Failed to open " + tmp_);
+    buf_.reserve(buffer_size_ + 4096);
+}
+
+YamlWriter::~YamlWriter() {
+    if (tmp_.empty()) return;
+    out_.close();
+    std::remove(tmp_.c_str());
+}
+
+void YamlWriter::flush() {
+    out_.write(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+    buf_.clear();
+    if (!out_) throw std::runtime_error("Failed to write " + filename_);
+}
+
+void YamlWriter::close() {
+    flush();
+    out_.close();
+    if (!out_) throw std::runtime_error("Failed to write " + filename_);
+    if (std::rename(tmp_.c_str(), filename_.c_str()) != 0) {
+        throw std::runtime_error("Failed to write " + filename_);
+    }
+    tmp_.clear();
+}
+
+void YamlWriter::newline(int indent) {
+    if (!at_start_) buf_ += '\n';
+    at_start_ = false;
+    buf_.append(indent, ' ');
+}
+
+void YamlWriter::seq_item(bool same_line) {
+    Level& top = stack_.back();
+    if (!(top.inline_first && top.count == 0)) newline(top.indent);
+    buf_ += same_line ? "- " : "-";
+    ++top.count;
+}
+
+void YamlWriter::begin_value() {
+    at_start_ = false;
+    if (stack_.empty()) return;
+    if (stack_.back().is_map) {
+        buf_ += ' ';  // after "key:"
+    } else {
+        seq_item();
+    }
+}
+
+YamlWriter& YamlWriter::end_value() {
+    if (buf_.size() >= buffer_size_) flush();
+    return *this;
+}
+
+YamlWriter& YamlWriter::begin_map() {
+    if (stack_.empty()) {
+        stack_.push_back({true, 0, 0, false});
+    } else if (stack_.back().is_map) {
+        stack_.push_back({true, stack_.back().indent + 2, 0, false});
+    } else {
+        seq_item();
+        stack_.push_back({true, stack_.back().indent + 2, 0, true});
+    }
+    return *this;
+}
+
+YamlWriter& YamlWriter::begin_seq() {
+    if (stack_.empty()) {
+        stack_.push_back({false, 0, 0, false});
+    } else if (stack_.back().is_map) {
+        stack_.push_back({false, stack_.back().indent + 2, 0, false});
+    } else {
+        // Unlike a map, a sequence item that is a sequence starts on the
+        // line after its "-".
+        seq_item(false);
+        stack_.push_back({false, stack_.back().indent + 2, 0, false});
+    }
+    return *this;
+}
+
+void YamlWriter::end_collection(bool is_map) {
+    if (stack_.empty() || stack_.back().is_map != is_map) {
+        throw std::runtime_error(is_map ? "YamlWriter: end_map without begin_map"
+                                        : "YamlWriter: end_seq without begin_seq");
+    }
+    const Level level = stack_.back();
+    stack_.pop_back();
+    if (level.count == 0) {
+        // Empty collections are written in flow style, on their own line
+        // unless they follow "- ".
+        if (!level.inline_first) newline(level.indent);
+        buf_ += is_map ? "{}" : "[]";
+    }
+}
+
+YamlWriter& YamlWriter::end_map() {
+    end_collection(true);
+    return end_value();
+}
+
+YamlWriter& YamlWriter::end_seq() {
+    end_collection(false);
+    return end_value();
+}
+
+YamlWriter& YamlWriter::key(std::string_view k, bool double_quoted) {
+    if (stack_.empty() || !stack_.back().is_map) {
+        throw std::runtime_error("YamlWriter: key outside a map");
+    }
+    Level& top = stack_.back();
+    if (!(top.inline_first && top.count == 0)) newline(top.indent);
+    ++top.count;
+    put_scalar(k, double_quoted);
+    buf_ += ':';
+    return *this;
+}
+
+YamlWriter& YamlWriter::value(int v) {
+    begin_value();
+    put_number(v);
+    return end_value();
+}
+
+YamlWriter& YamlWriter::value(uint64_t v) {
+    begin_value();
+    put_number(v);
+    return end_value();
+}
+
+YamlWriter& YamlWriter::value(double v) {
+    begin_value();
+    put_number(v);
+    return end_value();
+}
+
+YamlWriter& YamlWriter::value(std::string_view v) {
+    begin_value();
+    put_scalar(v, false);
+    return end_value();
+}
+
+void YamlWriter::put_scalar(std::string_view s, bool double_quoted) {
+    if (is_simple_plain(s)) {
+        if (double_quoted) buf_ += '"';
+        buf_ += s;
+        if (double_quoted) buf_ += '"';
+        return;
+    }
+    YAML::Emitter out;
+    if (double_quoted) out << YAML::DoubleQuoted;
+    out << std::string(s);
+    buf_ += out.c_str();
+}
+
+void YamlWriter::put_number(int v) {
+    char tmp[16];
+    const auto result = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buf_.append(tmp, result.ptr);
+}
+
+void YamlWriter::put_number(uint64_t v) {
+    char tmp[24];
+    const auto result = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buf_.append(tmp, result.ptr);
+}
+
+// As yaml-cpp: %.17g, and .nan / .inf / -.inf.
+void YamlWriter::put_number(double v) {
+    if (std::isnan(v)) {
+        buf_ += ".nan";
+    } else if (std::isinf(v)) {
+        buf_ += v < 0 ? "-.inf" : ".inf";
+    } else {
+        char tmp[32];
+        const auto result = std::to_chars(tmp, tmp + sizeof(tmp), v, std::chars_format::general,
+                                          std::numeric_limits<double>::max_digits10);
+        buf_.append(tmp, result.ptr);
+    }
+}
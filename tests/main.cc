@@ -0,0 +1,15 @@
+#include "testing.h"
+
+int main() {
+    for (const auto& test : testing::registry()) {
+        const int before = testing::failures();
+        try {
+            test.run();
+        } catch (const std::exception& e) {
+            testing::fail(test.name, 0, std::string("unexpected exception: ") + e.what());
+        }
+        std::cout << (testing::failures() == before ? "ok    " : "FAIL  ") << test.name << "\n";
+    }
+    std::cout << testing::registry().size() << " tests, " << testing::failures() << " failed checks\n";
+    return testing::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+// SmashFile.h
+#ifndef SMASH_FILE_H
+#define SMASH_FILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "binaryio.h"
+
+// Writes small SMASH binary files for tests. Records hold the quantities
+// in SmashFile::quantities(); unless given explicitly, a particle's p0 is
+// its index in the block.
+class SmashFile {
+public:
+    struct Particle {
+        double p0 = 0.0, px = 0.1, py = 0.2, pz = 0.3;
+        int32_t pdg = 211, ncoll = 0;
+    };
+
+    explicit SmashFile(const std::string& path) : out_(path, std::ios::binary) {
+        const std::string version = "SMASH-3.2";
+        out_.write("SMSH", 4);
+        binaryio::put(out_, uint16_t{9});
+        binaryio::put(out_, uint16_t{0});
+        binaryio::put(out_, static_cast<uint32_t>(version.size()));
+        out_.write(version.data(), static_cast<std::streamsize>(version.size()));
+    }
+
+    static std::vector<std::string> quantities() { return {"p0", "px", "py", "pz", "pdg", "ncoll"}; }
+
+    SmashFile& particles(int32_t event, int32_t ensemble, uint32_t n) {
+        out_.put('p');
+        binaryio::put(out_, event);
+        binaryio::put(out_, ensemble);
+        binaryio::put(out_, n);
+        records(n);
+        return *this;
+    }
+
+    SmashFile& particles(int32_t event, int32_t ensemble, const std::vector<Particle>& list) {
+        out_.put('p');
+        binaryio::put(out_, event);
+        binaryio::put(out_, ensemble);
+        binaryio::put(out_, static_cast<uint32_t>(list.size()));
+        for (const Particle& p : list) record(p);
+        return *this;
+    }
+
+    SmashFile& interaction(uint32_t n_in, uint32_t n_out) {
+        out_.put('i');
+        binaryio::put(out_, n_in);
+        binaryio::put(out_, n_out);
+        binaryio::put(out_, 0.1);   // density
+        binaryio::put(out_, 10.0);  // total cross section
+        binaryio::put(out_, 1.0);   // partial cross section
+        binaryio::put(out_, uint32_t{1});
+        records(n_in + n_out);
+        return *this;
+    }
+
+    SmashFile& end(uint32_t event, uint32_t ensemble = 0, bool empty = false) {
+        out_.put('f');
+        binaryio::put(out_, event);
+        binaryio::put(out_, ensemble);
+        binaryio::put(out_, 5.0);  // impact parameter
+        out_.put(empty ? 1 : 0);
+        return *this;
+    }
+
+    void close() { out_.close(); }
+
+private:
+    void records(uint32_t n) {
+        for (uint32_t k = 0; k < n; ++k) record({static_cast<double>(k)});
+    }
+
+    void record(const Particle& p) {
+        binaryio::put(out_, p.p0);
+        binaryio::put(out_, p.px);
+        binaryio::put(out_, p.py);
+        binaryio::put(out_, p.pz);
+        binaryio::put(out_, p.pdg);
+        binaryio::put(out_, p.ncoll);
+    }
+
+    std::ofstream out_;
+};
+
+#endif // SMASH_FILE_H
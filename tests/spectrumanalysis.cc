@@ -0,0 +1,31 @@
+#include "spectrumanalysis.h"
+
+#include "analysisregister.h"
+
+REGISTER_ANALYSIS(SpectrumAnalysis::NAME, SpectrumAnalysis);
+
+void SpectrumAnalysis::on_layout(const Accessor& accessor) {
+    p0_ = accessor.resolve<double>("p0");
+    pz_ = accessor.resolve<double>("pz");
+    pdg_ = accessor.resolve<int32_t>("pdg");
+    ncoll_ = accessor.resolve<int32_t>("ncoll");
+}
+
+void SpectrumAnalysis::analyze_particle_block(const ParticleBlock& block, const Accessor& /*accessor*/) {
+    ++*dataNode.handle<int>("blocks", 0);
+    *dataNode.handle<int>("particles", 0) += static_cast<int>(block.npart);
+    auto p0 = dataNode.handle("p0", Histogram1D(0.0, 64.0, 64));
+    auto pz = dataNode.handle("pz", Histogram1D(-1.0, 1.0, 40));
+    auto ncoll = dataNode.handle("ncoll", Histogram1D(0.0, 8.0, 8));
+    for (ParticleView p : block) {
+        ++*dataNode.handle<int>("species/" + std::to_string(pdg_(p)), 0);
+        p0->fill(p0_(p));
+        pz->fill(pz_(p));
+        ncoll->fill(ncoll_(p));
+    }
+}
+
+void SpectrumAnalysis::analyze_interaction_block(const InteractionBlock& block, const Accessor& /*accessor*/) {
+    ++*dataNode.handle<int>("interactions", 0);
+    *dataNode.handle<int>("interaction_particles", 0) += static_cast<int>(block.size());
+}
@@ -0,0 +1,35 @@
+// SpectrumAnalysis.h
+#ifndef SPECTRUM_ANALYSIS_H
+#define SPECTRUM_ANALYSIS_H
+
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+
+// Analysis of SmashFile records for the tests of the read paths: block and
+// particle counts, a count per species and unit-weight histograms of p0, pz
+// and ncoll. Every value merges exactly, so any split of a file over
+// instances must give the same tree as one instance reading it all.
+// Registered as SpectrumAnalysis::NAME.
+class SpectrumAnalysis : public Analysis {
+public:
+    static constexpr const char* NAME = "SpectrumAnalysis";
+
+    std::vector<Quantity> required_quantities() const override {
+        return {Quantity::P0, Quantity::PZ, Quantity::PDG, Quantity::NCOLL};
+    }
+
+    void on_layout(const Accessor& accessor) override;
+    void analyze_particle_block(const ParticleBlock& block, const Accessor& accessor) override;
+    void analyze_interaction_block(const InteractionBlock& block, const Accessor& accessor) override;
+
+    void finalize() override {}
+    void save(const std::string& /*save_dir_path*/) override {}
+
+private:
+    QuantityHandle<double> p0_, pz_;
+    QuantityHandle<int32_t> pdg_, ncoll_;
+};
+
+#endif // SPECTRUM_ANALYSIS_H
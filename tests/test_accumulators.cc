@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "accumulators.h"
+#include "testing.h"
+
+namespace {
+// Uniform in [0, 1) from the top 53 bits: unlike std::uniform_real_distribution
+// the same on every standard library.
+double uniform(std::mt19937_64& rng) {
+    return static_cast<double>(rng() >> 11) * 0x1p-53;
+}
+
+// `parts` sketches of `per_part` values each, merged in order; `values`
+// receives every value added.
+QuantileSketch merged_sketch(uint64_t seed, int parts, int per_part, bool exponential,
+                             std::vector<double>& values) {
+    std::mt19937_64 rng(seed);
+    QuantileSketch total;
+    for (int p = 0; p < parts; ++p) {
+        QuantileSketch part;
+        for (int i = 0; i < per_part; ++i) {
+            const double u = uniform(rng);
+            const double x = exponential ? -std::log1p(-u) : u;
+            part.add(x);
+            values.push_back(x);
+        }
+        total += part;
+    }
+    return total;
+}
+
+// Largest |F(quantile(q)) - q| over the levels written to YAML, with F the
+// empirical distribution of `values`.
+double max_rank_error(const QuantileSketch& sketch, std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    double worst = 0.0;
+    for (double q : sketch_yaml_levels) {
+        const double x = sketch.quantile(q);
+        const auto below = std::lower_bound(values.begin(), values.end(), x) - values.begin();
+        worst = std::max(worst, std::fabs(static_cast<double>(below) / values.size() - q));
+    }
+    return worst;
+}
+
+bool same_bits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+bool same_centroids(const std::vector<QuantileSketch::Centroid>& a,
+                    const std::vector<QuantileSketch::Centroid>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!same_bits(a[i].mean, b[i].mean) || !same_bits(a[i].weight, b[i].weight)) return false;
+    }
+    return true;
+}
+} // namespace
+
+TEST(quantile_sketch_rank_error_after_merging) {
+    // The bound documented on QuantileSketch: 50 merged parts, default compression.
+    for (bool exponential : {false, true}) {
+        std::vector<double> values;
+        const QuantileSketch sketch = merged_sketch(7, 50, 20000, exponential, values);
+        CHECK(sketch.total_weight() == 1e6);
+        CHECK(sketch.min() == *std::min_element(values.begin(), values.end()));
+        CHECK(sketch.max() == *std::max_element(values.begin(), values.end()));
+        CHECK(max_rank_error(sketch, values) < 5e-4);
+    }
+}
+
+TEST(quantile_sketch_size_is_bounded) {
+    std::vector<double> values;
+    QuantileSketch sketch = merged_sketch(3, 20, 50000, false, values);
+    sketch.compress();
+    CHECK(sketch.buffer().empty());
+    CHECK(sketch.centroids().size() <= sketch.compression());
+}
+
+TEST(quantile_sketch_merge_is_deterministic) {
+    std::vector<double> values_a, values_b;
+    const QuantileSketch a = merged_sketch(11, 30, 3000, true, values_a);
+    const QuantileSketch b = merged_sketch(11, 30, 3000, true, values_b);
+    CHECK(same_centroids(a.centroids(), b.centroids()));
+    CHECK(same_centroids(a.buffer(), b.buffer()));
+    for (double q : sketch_yaml_levels) CHECK(same_bits(a.quantile(q), b.quantile(q)));
+
+    // A sketch restored from its stored state merges like the original.
+    const QuantileSketch restored(a.compression(), a.total_weight(), a.min(), a.max(),
+                                  a.centroids(), a.buffer());
+    QuantileSketch x = b, y = b;
+    x += a;
+    y += restored;
+    CHECK(same_centroids(x.centroids(), y.centroids()));
+}
+
+TEST(quantile_sketch_edge_cases) {
+    QuantileSketch empty;
+    CHECK(std::isnan(empty.quantile(0.5)));
+
+    QuantileSketch one;
+    one.add(2.5);
+    CHECK(one.quantile(0.0) == 2.5);
+    CHECK(one.quantile(0.5) == 2.5);
+    CHECK(one.quantile(1.0) == 2.5);
+
+    QuantileSketch ignored;
+    ignored.add(std::nan(""));
+    ignored.add(1.0, 0.0);
+    CHECK(ignored.total_weight() == 0.0);
+
+    CHECK_THROWS(QuantileSketch(0.0), std::invalid_argument);
+}
+
+TEST(running_moments_merge_matches_single_pass) {
+    std::mt19937_64 rng(5);
+    RunningMoments all, merged;
+    double sum = 0.0;
+    std::vector<double> values;
+    for (int p = 0; p < 10; ++p) {
+        RunningMoments part;
+        for (int i = 0; i < 1000; ++i) {
+            const double x = 100.0 + uniform(rng);
+            part.add(x);
+            all.add(x);
+            values.push_back(x);
+            sum += x;
+        }
+        merged += part;
+    }
+    const double mean = sum / values.size();
+    double m2 = 0.0;
+    for (double x : values) m2 += (x - mean) * (x - mean);
+    const double variance = m2 / (values.size() - 1);
+
+    CHECK(merged.count() == values.size());
+    CHECK(std::fabs(merged.mean() - mean) < 1e-12 * mean);
+    CHECK(std::fabs(merged.variance() - variance) < 1e-9 * variance);
+    CHECK(std::fabs(all.variance() - variance) < 1e-9 * variance);
+    CHECK(std::isnan(RunningMoments().mean()));
+}
+
+TEST(min_max_merge) {
+    MinMax a, b;
+    a.add(3.0);
+    a.add(-1.0);
+    b.add(7.0);
+    a += b;
+    a += MinMax();
+    CHECK(a.count() == 3);
+    CHECK(a.min() == -1.0);
+    CHECK(a.max() == 7.0);
+}
+
+TEST(kahan_sum_keeps_low_bits) {
+    KahanSum s;
+    double naive = 0.0;
+    for (int i = 0; i < 10000000; ++i) {
+        s.add(0.1);
+        naive += 0.1;
+    }
+    CHECK(s.sum() == 1e6);
+    CHECK(naive != 1e6);
+
+    KahanSum big, small;
+    big.add(1e16);
+    for (int i = 0; i < 1000; ++i) small.add(1.0);
+    big += small;
+    CHECK(big.sum() == 1e16 + 1000.0);
+    CHECK(big.count() == 1001);
+}
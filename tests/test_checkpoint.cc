@@ -0,0 +1,70 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "checkpoint.h"
+#include "testing.h"
+#include "treeanalysis.h"
+
+namespace {
+Checkpoint sample_checkpoint() {
+    Checkpoint cp;
+    cp.config = "quantities=p0,px,py,pz,pdg|events=0:100";
+    cp.analysis_names = {TreeAnalysis::NAME, TreeAnalysis::NAME};
+    cp.completed = {{"a.bin", "sqrt_s=5.02"}, {"b.bin", "sqrt_s=7.7"}};
+    cp.results.push_back({tree_entry(1, {MergeKey("sqrt_s", 5.02)}),
+                          tree_entry(2, {MergeKey("sqrt_s", 7.7)})});
+    cp.results.push_back({tree_entry(3, {MergeKey("system", std::string("AuAu")), MergeKey("run", 4)})});
+    return cp;
+}
+} // namespace
+
+TEST(checkpoint_round_trip) {
+    testing::TempDir dir;
+    const std::string path = dir.file("run.bkcp");
+    const Checkpoint saved = sample_checkpoint();
+    saved.save(path);
+    const Checkpoint loaded = Checkpoint::load(path);
+
+    CHECK(loaded.config == saved.config);
+    CHECK(loaded.analysis_names == saved.analysis_names);
+    CHECK(loaded.completed == saved.completed);
+    CHECK(loaded.results.size() == saved.results.size());
+    for (size_t a = 0; a < saved.results.size() && a < loaded.results.size(); ++a) {
+        CHECK(loaded.results[a].size() == saved.results[a].size());
+        for (size_t e = 0; e < saved.results[a].size() && e < loaded.results[a].size(); ++e) {
+            const Entry& x = saved.results[a][e];
+            const Entry& y = loaded.results[a][e];
+            CHECK(y.key == x.key);
+            CHECK(y.analysis->get_merge_keys() == x.key);
+            CHECK(y.analysis->get_smash_version() == x.analysis->get_smash_version());
+            CHECK(testing::binary_of(y.analysis->get_data()) == testing::binary_of(x.analysis->get_data()));
+        }
+    }
+}
+
+TEST(checkpoint_save_replaces_previous) {
+    testing::TempDir dir;
+    const std::string path = dir.file("run.bkcp");
+    Checkpoint cp = sample_checkpoint();
+    cp.save(path);
+    cp.completed.emplace_back("c.bin", "sqrt_s=7.7");
+    cp.save(path);
+    CHECK(Checkpoint::load(path).completed.size() == 3);
+    CHECK(std::distance(std::filesystem::directory_iterator(dir.path),
+                        std::filesystem::directory_iterator()) == 1);
+}
+
+TEST(checkpoint_load_rejects_other_files) {
+    testing::TempDir dir;
+    const std::string path = dir.file("run.bkcp");
+    CHECK_THROWS(Checkpoint::load(path), std::runtime_error);
+
+    std::ofstream(path, std::ios::binary) << "not a checkpoint";
+    CHECK_THROWS(Checkpoint::load(path), std::runtime_error);
+
+    sample_checkpoint().save(path);
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+    CHECK_THROWS(Checkpoint::load(path), std::runtime_error);
+}
@@ -0,0 +1,58 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "binaryreader.h"
+#include "columnarfile.h"
+#include "smashfile.h"
+#include "testing.h"
+
+namespace {
+// Records what a reader delivers.
+struct BlockRecorder : Accessor {
+    std::vector<uint32_t> npart;
+    std::vector<EndBlock> end_blocks;
+
+    void on_particle_block(const ParticleBlock& block) override { npart.push_back(block.npart); }
+    void on_end_block(const EndBlock& block) override { end_blocks.push_back(block); }
+};
+
+std::shared_ptr<BlockRecorder> read_all(const std::string& path) {
+    auto recorder = std::make_shared<BlockRecorder>();
+    BinaryReader reader(path, SmashFile::quantities(), recorder, ReadMode::Mmap);
+    reader.read();
+    return recorder;
+}
+} // namespace
+
+TEST(columnar_file_round_trips_blocks) {
+    testing::TempDir dir;
+    const std::string path = dir.file("particles.bin");
+    {
+        SmashFile file(path);
+        for (uint32_t event = 0; event < 5; ++event) {
+            file.particles(static_cast<int32_t>(event), 0, event == 3 ? 0 : 2 + event)
+                .end(event, 0, event == 3);
+        }
+        file.particles(5, 0, 1);  // so the last end block is delivered
+    }
+    const std::string bkc = columnar_path(path);
+    ConvertOptions options;
+    options.chunk_events = 2;
+    convert_to_columnar(path, bkc, SmashFile::quantities(), options);
+    CHECK(ColumnarFile::is_columnar(bkc));
+
+    const auto original = read_all(path);
+    const auto columnar = read_all(bkc);
+    CHECK(columnar->npart == original->npart);
+    CHECK(columnar->end_blocks.size() == original->end_blocks.size());
+    for (size_t k = 0; k < original->end_blocks.size() && k < columnar->end_blocks.size(); ++k) {
+        const EndBlock& a = original->end_blocks[k];
+        const EndBlock& b = columnar->end_blocks[k];
+        CHECK(a.event_number == b.event_number);
+        CHECK(a.ensamble_number == b.ensamble_number);
+        CHECK(a.impact_parameter == b.impact_parameter);
+        CHECK(a.empty == b.empty);
+    }
+    CHECK(columnar->end_blocks.size() == 5 && columnar->end_blocks[3].empty == 1);
+}
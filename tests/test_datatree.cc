@@ -0,0 +1,231 @@
+#include <cmath>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "binaryio.h"
+#include "datatree.h"
+#include "testing.h"
+
+namespace {
+// One leaf of every Data alternative, plus a nested branch.
+DataNode sample_tree() {
+    DataNode root("root");
+    root.add_child("empty");
+    root.add_child("int", -42);
+    root.add_child("double", std::numeric_limits<double>::quiet_NaN());
+    root.add_child("ints", std::vector<int>{1, -2, 3});
+    root.add_child("doubles", std::vector<double>{0.5, -1e300, 1e-300});
+
+    Histogram1D h(-1.0, 1.0, 8);
+    h.fill(0.3, 2.5);
+    h.fill(-0.9);
+    root.add_child("branch").add_child("histogram", h);
+
+    RunningMoments moments;
+    MinMax minmax;
+    QuantileSketch sketch(50.0);
+    KahanSum sum;
+    for (int i = 0; i < 1000; ++i) {
+        const double x = std::sin(i * 0.37) * 10.0;
+        moments.add(x);
+        minmax.add(x);
+        sketch.add(x, 1.0 + (i % 3));  // leaves both centroids and a buffer
+        sum.add(x);
+    }
+    root.add_child("moments", moments);
+    root.add_child("minmax", minmax);
+    root.add_child("sketch", sketch);
+    root.add_child("sum", sum);
+    return root;
+}
+} // namespace
+
+TEST(binary_round_trip_covers_every_data_alternative) {
+    const DataNode tree = sample_tree();
+
+    std::vector<bool> seen(std::variant_size_v<Data>, false);
+    seen[tree.get_data().index()] = true;
+    for (const auto& [_, child] : tree.children()) {
+        seen[child.get_data().index()] = true;
+        for (const auto& [__, grandchild] : child.children()) seen[grandchild.get_data().index()] = true;
+    }
+    for (bool s : seen) CHECK(s);
+
+    const std::string bytes = testing::binary_of(tree);
+    std::istringstream in(bytes);
+    const DataNode copy = read_binary(in);
+    CHECK(testing::binary_of(copy) == bytes);
+    CHECK(in.peek() == std::char_traits<char>::eof());
+
+    const auto& sketch = std::get<QuantileSketch>(copy.children().find("sketch")->second.get_data());
+    const auto& original = std::get<QuantileSketch>(tree.children().find("sketch")->second.get_data());
+    CHECK(!sketch.centroids().empty());
+    CHECK(!sketch.buffer().empty());
+    CHECK(sketch.quantile(0.3) == original.quantile(0.3));
+    CHECK(std::get<int>(copy.children().find("int")->second.get_data()) == -42);
+}
+
+TEST(binary_read_rejects_truncated_data) {
+    const std::string bytes = testing::binary_of(sample_tree());
+    for (size_t cut : {size_t{0}, size_t{3}, bytes.size() / 2, bytes.size() - 1}) {
+        std::istringstream in(bytes.substr(0, cut));
+        CHECK_THROWS(read_binary(in), std::runtime_error);
+    }
+}
+
+TEST(binary_read_rejects_deep_nesting) {
+    // One child per level: as a cache entry or partial from a corrupt file
+    // this must throw, not overflow the stack.
+    auto chain = [](size_t depth) {
+        std::ostringstream out;
+        for (size_t level = 0; level <= depth; ++level) {
+            binaryio::put_string(out, "n");
+            binaryio::put(out, uint8_t{0});
+            binaryio::put(out, static_cast<uint32_t>(level < depth ? 1 : 0));
+        }
+        return out.str();
+    };
+    std::istringstream deep(chain(1000000));
+    CHECK_THROWS(read_binary(deep), std::runtime_error);
+
+    std::istringstream shallow(chain(100));
+    const DataNode tree = read_binary(shallow);
+    CHECK(testing::binary_of(tree) == chain(100));
+}
+
+TEST(parallel_merge_matches_serial_merge) {
+    std::vector<DataNode> serial_parts, parallel_parts;
+    for (int k = 0; k < 6; ++k) {
+        DataNode part = sample_tree();
+        std::get<KahanSum>(part.children().find("sum")->second.get_data()).add(k * 0.1);
+        std::get<QuantileSketch>(part.children().find("sketch")->second.get_data()).add(k);
+        serial_parts.push_back(part);
+        parallel_parts.push_back(part);
+    }
+
+    DataNode serial = sample_tree(), parallel = sample_tree();
+    std::vector<DataNode*> serial_sources, parallel_sources;
+    for (auto& p : serial_parts) serial_sources.push_back(&p);
+    for (auto& p : parallel_parts) parallel_sources.push_back(&p);
+    merge_trees(serial, serial_sources, 1);
+    merge_trees(parallel, parallel_sources, 4);
+    CHECK(testing::binary_of(serial) == testing::binary_of(parallel));
+
+    const auto& moments = std::get<RunningMoments>(serial.children().find("moments")->second.get_data());
+    CHECK(moments.count() == 7000);
+}
+
+namespace {
+// Whether every name, map and histogram of the tree comes from `resource`.
+bool uses(const DataNode& node, std::pmr::memory_resource* resource) {
+    if (node.get_allocator().resource() != resource) return false;
+    if (node.get_name().get_allocator().resource() != resource) return false;
+    if (auto* h = std::get_if<Histogram1D>(&node.get_data())) {
+        if (h->counts().get_allocator().resource() != resource) return false;
+    }
+    for (const auto& [key, child] : node.children()) {
+        if (key.get_allocator().resource() != resource || !uses(child, resource)) return false;
+    }
+    return true;
+}
+
+// A root holding one of sample_tree's keys, so merging sample_tree into it
+// both merges a leaf and adds new subtrees.
+DataNode partial_root(DataNode::allocator_type alloc = {}) {
+    DataNode root(alloc);
+    root.add_child("int", 1);
+    return root;
+}
+} // namespace
+
+TEST(trees_move_between_arena_and_heap) {
+    DataNode expected = partial_root();
+    expected += sample_tree();
+    const std::string want = testing::binary_of(expected);
+    DataNode unnamed;
+    unnamed += sample_tree();
+    const std::string want_whole = testing::binary_of(unnamed);
+    std::pmr::memory_resource* heap = std::pmr::get_default_resource();
+
+    // arena -> heap; the destinations outlive the arena
+    DataNode copied = partial_root(), moved = partial_root(), moved_whole;
+    std::optional<DataNode> extended_copy, extended_move;
+    {
+        DataArena arena;
+        DataNode in_arena{DataNode::allocator_type(&arena)};
+        in_arena += sample_tree();
+        CHECK(uses(in_arena, &arena));
+
+        copied += in_arena;
+        extended_copy.emplace(in_arena, DataNode::allocator_type(heap));
+        DataNode twin(in_arena, DataNode::allocator_type(&arena));
+        moved += std::move(in_arena);
+        extended_move.emplace(std::move(twin), DataNode::allocator_type(heap));
+
+        DataNode whole{DataNode::allocator_type(&arena)};
+        whole += sample_tree();
+        moved_whole += std::move(whole);  // empty destination takes it as a whole
+    }
+    CHECK(uses(copied, heap));
+    CHECK(uses(moved, heap));
+    CHECK(uses(moved_whole, heap));
+    CHECK(uses(*extended_copy, heap));
+    CHECK(uses(*extended_move, heap));
+    CHECK(testing::binary_of(copied) == want);
+    CHECK(testing::binary_of(moved) == want);
+    CHECK(testing::binary_of(moved_whole) == want_whole);
+    CHECK(testing::binary_of(*extended_copy) == want_whole);
+    CHECK(testing::binary_of(*extended_move) == want_whole);
+
+    // heap -> arena; the arena tree outlives its sources
+    DataArena arena;
+    DataNode copied_in = partial_root(DataNode::allocator_type(&arena));
+    DataNode moved_in = partial_root(DataNode::allocator_type(&arena));
+    {
+        const DataNode source = sample_tree();
+        copied_in += source;
+        DataNode movable = sample_tree();
+        moved_in += std::move(movable);
+    }
+    CHECK(uses(copied_in, &arena));
+    CHECK(uses(moved_in, &arena));
+    CHECK(testing::binary_of(copied_in) == want);
+    CHECK(testing::binary_of(moved_in) == want);
+
+    // within one arena new subtrees are spliced rather than copied
+    DataNode spliced = partial_root(DataNode::allocator_type(&arena));
+    DataNode source{DataNode::allocator_type(&arena)};
+    source += sample_tree();
+    const DataNode* branch = &source.children().find("branch")->second;
+    spliced += std::move(source);
+    CHECK(&spliced.children().find("branch")->second == branch);
+    CHECK(testing::binary_of(spliced) == want);
+}
+
+TEST(merge_trees_into_arena_root) {
+    std::vector<DataNode> heap_parts, arena_parts;
+    for (int k = 0; k < 5; ++k) {
+        DataNode part = sample_tree();
+        std::get<KahanSum>(part.children().find("sum")->second.get_data()).add(k * 0.25);
+        heap_parts.push_back(part);
+        arena_parts.push_back(part);
+    }
+    DataNode expected = partial_root();
+    std::vector<DataNode*> heap_sources;
+    for (auto& p : heap_parts) heap_sources.push_back(&p);
+    merge_trees(expected, heap_sources, 1);
+
+    DataArena arena;
+    DataNode merged = partial_root(DataNode::allocator_type(&arena));
+    std::vector<DataNode*> sources;
+    for (auto& p : arena_parts) sources.push_back(&p);
+    merge_trees(merged, sources, 4);
+    arena_parts.clear();  // the merged tree must not point into its sources
+
+    CHECK(uses(merged, &arena));
+    CHECK(testing::binary_of(merged) == testing::binary_of(expected));
+}
@@ -0,0 +1,107 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "binaryreader.h"
+#include "eventindex.h"
+#include "smashfile.h"
+#include "testing.h"
+
+namespace {
+// Counts the blocks a reader delivers.
+struct BlockCounter : Accessor {
+    size_t particle_blocks = 0;
+    size_t interactions = 0;
+    size_t end_blocks = 0;
+
+    void on_particle_block(const ParticleBlock& /*block*/) override { ++particle_blocks; }
+    void on_interaction_block(const InteractionBlock& /*block*/) override { ++interactions; }
+    void on_end_block(const EndBlock& /*block*/) override { ++end_blocks; }
+};
+
+size_t particle_size() {
+    return compute_particle_size(SmashFile::quantities());
+}
+
+std::shared_ptr<BlockCounter> read_range(const std::string& path, EventRange range,
+                                         const EventIndex* index) {
+    auto counter = std::make_shared<BlockCounter>();
+    BinaryReader reader(path, SmashFile::quantities(), counter, ReadMode::Mmap);
+    reader.set_event_range(range, index);
+    reader.read();
+    return counter;
+}
+} // namespace
+
+TEST(event_index_of_collision_history_without_particle_blocks) {
+    testing::TempDir dir;
+    const std::string path = dir.file("collisions.bin");
+    {
+        SmashFile file(path);
+        for (uint32_t event = 0; event < 4; ++event) {
+            file.interaction(2, 2).interaction(1, 3).end(event);
+        }
+    }
+    const EventIndex index = EventIndex::build(path, particle_size());
+    CHECK(index.event_count() == 4);
+    CHECK(index.particle_block_count() == 0);
+    CHECK(index.interaction_block_count() == 8);
+
+    // Every event is found, and sharding by events loses none of them.
+    size_t interactions = 0;
+    const auto ranges = index.split(2);
+    CHECK(ranges.size() == 2);
+    for (const auto& range : ranges) interactions += read_range(path, range, &index)->interactions;
+    CHECK(interactions == 8);
+    CHECK(read_range(path, {2, 3}, &index)->interactions == 2);
+}
+
+TEST(event_index_groups_ensembles_and_interactions_by_event) {
+    testing::TempDir dir;
+    const std::string path = dir.file("particles.bin");
+    {
+        SmashFile file(path);
+        for (int32_t event = 0; event < 6; ++event) {
+            for (int32_t ensemble = 0; ensemble < 3; ++ensemble) {
+                file.particles(event, ensemble, 10 + event);
+                if (event % 2) file.interaction(2, 1);
+                file.end(event, ensemble);
+            }
+        }
+        file.particles(6, 0, 1);  // trailing block: not delivered, not indexed
+    }
+    const EventIndex index = EventIndex::build(path, particle_size());
+    CHECK(index.event_count() == 6);
+    CHECK(index.particle_block_count() == 18);
+    CHECK(index.interaction_block_count() == 9);
+    for (const auto& e : index.entries()) {
+        CHECK(e.particle_blocks == 3);
+        CHECK(e.end_blocks == 3);
+        CHECK(e.particles == 3u * (10 + e.event_number));
+        CHECK(e.offset < e.end);
+    }
+
+    // Seeking through the index delivers what a full scan delivers.
+    for (EventRange range : {EventRange{0, 1}, EventRange{1, 4}, EventRange{5, 100}}) {
+        const auto seek = read_range(path, range, &index);
+        const auto scan = read_range(path, range, nullptr);
+        CHECK(seek->particle_blocks == scan->particle_blocks);
+        CHECK(seek->interactions == scan->interactions);
+        CHECK(seek->end_blocks == scan->end_blocks);
+    }
+}
+
+TEST(event_index_sidecar_round_trip) {
+    testing::TempDir dir;
+    const std::string path = dir.file("particles.bin");
+    {
+        SmashFile file(path);
+        for (uint32_t event = 0; event < 5; ++event) file.particles(event, 0, 4).end(event);
+    }
+    const EventIndex built = EventIndex::open(path, particle_size());
+    const EventIndex loaded = EventIndex::load(index_path(path));
+    CHECK(loaded.event_count() == built.event_count());
+    CHECK(loaded.particle_count() == 20);
+    CHECK(loaded.entries().back().end == built.entries().back().end);
+    CHECK(loaded.split(3).size() == 3);
+}
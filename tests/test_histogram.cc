@@ -0,0 +1,232 @@
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "histogram1d.h"
+#include "histogram2d.h"
+#include "histogramfill.h"
+#include "shardedhistogram.h"
+#include "testing.h"
+
+namespace {
+constexpr double not_a_number = std::numeric_limits<double>::quiet_NaN();
+
+double total(const std::vector<double>& counts) {
+    return std::accumulate(counts.begin(), counts.end(), 0.0);
+}
+
+// Every bin edge of `spec` and the values up to 4 ulps either side of it,
+// plus the range ends and the non-finite values.
+std::vector<double> edge_values(const BinSpec& spec) {
+    constexpr double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> values = {spec.min, spec.max, std::nextafter(spec.max, -inf),
+                                  inf, -inf, not_a_number};
+    for (size_t i = 0; i <= spec.bins; ++i) {
+        const double edge = spec.min + static_cast<double>(i) * spec.width;
+        double below = edge, above = edge;
+        values.push_back(edge);
+        for (int ulp = 1; ulp <= 4; ++ulp) {
+            below = std::nextafter(below, -inf);
+            above = std::nextafter(above, inf);
+            values.push_back(below);
+            values.push_back(above);
+        }
+    }
+    return values;
+}
+
+// Deterministic pseudo-random values in [lo, hi), with a NaN and values
+// outside the range mixed in now and then.
+std::vector<double> sample_values(size_t n, double lo, double hi, uint64_t seed) {
+    std::vector<double> values(n);
+    for (size_t i = 0; i < n; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const double u = static_cast<double>(seed >> 11) * 0x1.0p-53;
+        values[i] = i % 97 == 0 ? not_a_number : lo + (hi - lo) * (1.2 * u - 0.1);
+    }
+    return values;
+}
+
+// Runs fill(t) on `threads` threads at once.
+template <typename F>
+void on_threads(size_t threads, F fill) {
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; ++t) pool.emplace_back(fill, t);
+    for (auto& thread : pool) thread.join();
+}
+
+template <typename Counts>
+std::vector<double> counts_of(const Counts& counts) {
+    return std::vector<double>(counts.begin(), counts.end());
+}
+
+constexpr size_t fill_threads = 4;
+constexpr size_t fills_per_thread = 20000;
+} // namespace
+
+TEST(histogram_fill_rejects_nan_and_out_of_range) {
+    Histogram1D h(0.0, 1.0, 4);
+    CHECK(!h.fill(not_a_number));
+    CHECK(!h.fill(-0.5));
+    CHECK(!h.fill(1.0));
+    CHECK(h.fill(0.999));
+    const std::vector<double> values = {not_a_number, 0.1, 2.0, not_a_number, 0.6};
+    CHECK(h.fill(values) == 2);
+    const std::vector<double> counts(h.counts().begin(), h.counts().end());
+    CHECK(total(counts) == 3.0);
+    CHECK(counts.back() == 1.0);  // NaN must not land in the last bin
+
+    Histogram2D h2(0.0, 1.0, 2, 0.0, 1.0, 2);
+    h2.fill(not_a_number, 0.5);
+    h2.fill(0.5, not_a_number);
+    h2.fill(0.25, 0.75);
+    const std::vector<double> xs = {not_a_number, 0.25};
+    const std::vector<double> ys = {0.25, not_a_number};
+    CHECK(h2.fill(xs, ys) == 0);
+    CHECK(total(h2.counts()) == 1.0);
+
+    ShardedHistogram1D sharded(h, 2);
+    CHECK(!sharded.fill(1, not_a_number));
+    AtomicHistogram2D atomic(h2);
+    CHECK(!atomic.fill(0.5, not_a_number));
+}
+
+TEST(compute_bins_matches_bin_index_with_every_kernel) {
+    const std::vector<Histogram1D> axes = {
+        Histogram1D(0.0, 1.0, 4),      Histogram1D(0.1, 0.7, 6),     Histogram1D(-2.5, 3.7, 31),
+        Histogram1D(-1e3, 1e3, 1000),  Histogram1D(100.0, 100.3, 3), Histogram1D(-1e-6, 3e-6, 7),
+    };
+    const std::pair<BinKernel, const char*> kernels[] = {
+        {BinKernel::Scalar, "scalar"}, {BinKernel::Avx2, "avx2"}, {BinKernel::Avx512, "avx512"}};
+    for (const auto& [kernel, name] : kernels) {
+        if (!bin_kernel_supported(kernel)) {
+            std::cout << "  " << name << " kernel not supported on this CPU, skipped\n";
+            continue;
+        }
+        for (const auto& axis : axes) {
+            const BinSpec spec = axis.bin_spec();
+            const std::vector<double> values = edge_values(spec);
+            std::vector<int32_t> bins(values.size());
+            compute_bins(values.data(), values.size(), spec, bins.data(), kernel);
+            size_t mismatches = 0;
+            for (size_t i = 0; i < values.size(); ++i) mismatches += bins[i] != bin_index(values[i], spec);
+            CHECK(mismatches == 0);
+        }
+    }
+
+    Histogram1D h(-2.5, 3.7, 31);
+    const std::vector<double> values = edge_values(h.bin_spec());
+    std::vector<int32_t> bins(values.size());
+    compute_bins(values.data(), values.size(), h.bin_spec(), bins.data());
+    for (size_t i = 0; i < values.size(); ++i) CHECK(bins[i] == bin_index(values[i], h.bin_spec()));
+}
+
+TEST(sharded_histograms_filled_from_threads_match_a_serial_fill) {
+    std::vector<std::vector<double>> xs, ys, weights;
+    for (size_t t = 0; t < fill_threads; ++t) {
+        xs.push_back(sample_values(fills_per_thread, -1.0, 2.0, 2 * t + 1));
+        ys.push_back(sample_values(fills_per_thread, 0.0, 5.0, 2 * t + 2));
+        weights.push_back(sample_values(fills_per_thread, 0.1, 3.0, 100 + t));
+        for (double& w : weights.back()) w = std::isfinite(w) ? w : 0.5;
+    }
+
+    // 1D: shard t gets thread t's values, half one by one and half batched.
+    // Reduction adds the shards in order, so it equals adding per-shard
+    // serial fills in that order bit for bit, whatever the weights.
+    ShardedHistogram1D h1(-1.0, 2.0, 37, fill_threads);
+    on_threads(fill_threads, [&](size_t t) {
+        const size_t half = fills_per_thread / 2;
+        for (size_t i = 0; i < half; ++i) h1.fill(t, xs[t][i], weights[t][i]);
+        h1.fill(t, std::span<const double>(xs[t]).subspan(half),
+                std::span<const double>(weights[t]).subspan(half));
+    });
+    Histogram1D expected1(-1.0, 2.0, 37);
+    for (size_t t = 0; t < fill_threads; ++t) {
+        Histogram1D shard(-1.0, 2.0, 37);
+        for (size_t i = 0; i < fills_per_thread; ++i) shard.fill(xs[t][i], weights[t][i]);
+        expected1 += shard;
+    }
+    CHECK(counts_of(h1.reduce().counts()) == counts_of(expected1.counts()));
+
+    Histogram1D sum1(-1.0, 2.0, 37);
+    sum1.fill(0.5, 3.0);
+    Histogram1D prior1 = sum1;
+    sum1 += h1;
+    prior1 += h1.reduce();
+    CHECK(counts_of(sum1.counts()) == counts_of(prior1.counts()));
+
+    // 2D with x_bins != y_bins, so a transposed index would land elsewhere.
+    ShardedHistogram2D h2(-1.0, 2.0, 3, 0.0, 5.0, 7, fill_threads);
+    on_threads(fill_threads, [&](size_t t) {
+        for (size_t i = 0; i < fills_per_thread; ++i) h2.fill(t, xs[t][i], ys[t][i], weights[t][i]);
+    });
+    Histogram2D expected2(-1.0, 2.0, 3, 0.0, 5.0, 7);
+    for (size_t t = 0; t < fill_threads; ++t) {
+        Histogram2D shard(-1.0, 2.0, 3, 0.0, 5.0, 7);
+        for (size_t i = 0; i < fills_per_thread; ++i) shard.fill(xs[t][i], ys[t][i], weights[t][i]);
+        expected2 += shard;
+    }
+    CHECK(h2.reduce().counts() == expected2.counts());
+
+    Histogram2D sum2(-1.0, 2.0, 3, 0.0, 5.0, 7);
+    sum2 += h2;
+    CHECK(sum2.counts() == expected2.counts());
+
+    ShardedHistogram2D corner(-1.0, 2.0, 3, 0.0, 5.0, 7, 2);
+    corner.fill(1, 1.5, 0.5);  // x bin 2, y bin 0
+    CHECK(corner.reduce().counts()[2 * 7 + 0] == 1.0);
+    CHECK(corner.reduce().get_bin_count(2, 0) == 1.0);
+
+    h1.clear();
+    CHECK(total(counts_of(h1.reduce().counts())) == 0.0);
+}
+
+TEST(atomic_histograms_filled_from_threads_match_a_serial_fill) {
+    std::vector<std::vector<double>> xs, ys;
+    for (size_t t = 0; t < fill_threads; ++t) {
+        xs.push_back(sample_values(fills_per_thread, -1.0, 2.0, 2 * t + 1));
+        ys.push_back(sample_values(fills_per_thread, 0.0, 5.0, 2 * t + 2));
+    }
+
+    // Unit weights: every partial sum is an integer well below 2^53, so the
+    // result is exact whatever order the threads' adds land in. Few bins, so
+    // the threads keep hitting the same ones.
+    AtomicHistogram1D h1(-1.0, 2.0, 5);
+    AtomicHistogram2D h2(-1.0, 2.0, 3, 0.0, 5.0, 2);
+    on_threads(fill_threads, [&](size_t t) {
+        for (size_t i = 0; i < fills_per_thread; ++i) {
+            h1.fill(xs[t][i]);
+            h2.fill(xs[t][i], ys[t][i]);
+        }
+    });
+    Histogram1D expected1(-1.0, 2.0, 5);
+    Histogram2D expected2(-1.0, 2.0, 3, 0.0, 5.0, 2);
+    for (size_t t = 0; t < fill_threads; ++t) {
+        for (size_t i = 0; i < fills_per_thread; ++i) {
+            expected1.fill(xs[t][i]);
+            expected2.fill(xs[t][i], ys[t][i]);
+        }
+    }
+    CHECK(counts_of(h1.reduce().counts()) == counts_of(expected1.counts()));
+    CHECK(h2.reduce().counts() == expected2.counts());
+
+    Histogram1D sum1(-1.0, 2.0, 5);
+    sum1 += h1;
+    CHECK(counts_of(sum1.counts()) == counts_of(expected1.counts()));
+    Histogram2D sum2(-1.0, 2.0, 3, 0.0, 5.0, 2);
+    sum2 += h2;
+    CHECK(sum2.counts() == expected2.counts());
+
+    AtomicHistogram2D corner(-1.0, 2.0, 3, 0.0, 5.0, 2);
+    corner.fill(-0.5, 4.0);  // x bin 0, y bin 1
+    corner.fill(1.5, 0.5);   // x bin 2, y bin 0
+    CHECK(corner.reduce().counts()[0 * 2 + 1] == 1.0);
+    CHECK(corner.reduce().counts()[2 * 2 + 0] == 1.0);
+    CHECK(total(corner.reduce().counts()) == 2.0);
+
+    h2.clear();
+    CHECK(total(h2.reduce().counts()) == 0.0);
+}
@@ -0,0 +1,74 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "orderedparallel.h"
+#include "testing.h"
+
+namespace {
+// A delay of up to ~300 us that does not follow the item order.
+void scrambled_delay(size_t k) {
+    uint64_t h = (k + 1) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    std::this_thread::sleep_for(std::chrono::microseconds(h % 300));
+}
+} // namespace
+
+TEST(ordered_parallel_consumes_in_order_within_the_window) {
+    for (size_t window : {size_t{1}, size_t{3}, size_t{0}}) {
+        const size_t first = 5, n = 200;
+        std::vector<size_t> order;
+        std::atomic<size_t> n_consumed{0};
+        std::atomic<bool> ran_ahead{false};
+        ordered_parallel(first, n, 8,
+            [&](size_t k) {
+                // Items start less than `window` past the next to consume.
+                const size_t limit = window == 0 ? 4 * 8 : window;
+                if (k >= first + n_consumed + limit) ran_ahead = true;
+                scrambled_delay(k);
+                return std::to_string(k);
+            },
+            [&](size_t k, std::string result) {
+                if (result != std::to_string(k)) ran_ahead = true;
+                order.push_back(k);
+                ++n_consumed;
+            },
+            window);
+
+        CHECK(!ran_ahead);
+        CHECK(order.size() == n - first);
+        bool in_order = true;
+        for (size_t i = 0; i < order.size(); ++i) in_order = in_order && order[i] == first + i;
+        CHECK(in_order);
+    }
+}
+
+TEST(ordered_parallel_rethrows_the_first_error) {
+    for (bool in_consume : {false, true}) {
+        std::vector<size_t> order;
+        std::string message;
+        try {
+            ordered_parallel(0, 500, 8,
+                [&](size_t k) {
+                    scrambled_delay(k);
+                    if (!in_consume && k == 37) throw std::runtime_error("item 37");
+                    return k;
+                },
+                [&](size_t k, size_t) {
+                    if (in_consume && k == 37) throw std::runtime_error("item 37");
+                    order.push_back(k);
+                },
+                3);
+        } catch (const std::runtime_error& e) {
+            message = e.what();
+        }
+        CHECK(message == "item 37");
+        // Nothing after the failed item is consumed.
+        CHECK(order.size() == 37);
+        for (size_t i = 0; i < order.size(); ++i) CHECK(order[i] == i);
+    }
+}
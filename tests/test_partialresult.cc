@@ -0,0 +1,149 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "binaryio.h"
+#include "partialresult.h"
+#include "testing.h"
+#include "treeanalysis.h"
+
+namespace {
+PartialResult sample_partial(int seed, uint32_t shard) {
+    PartialResult partial;
+    partial.analysis_name = TreeAnalysis::NAME;
+    partial.provenance = {"run-1", 2, {shard}};
+    partial.config = "q=;events=0:100;pdg=211,;charge=;cuts=";
+    partial.analysis_config = TreeAnalysis::NAME;
+    partial.entries = {tree_entry(seed, {MergeKey("sqrt_s", 5.02)}),
+                       tree_entry(seed + 1, {MergeKey("sqrt_s", 7.7)})};
+    return partial;
+}
+
+bool same_entries(const std::vector<Entry>& a, const std::vector<Entry>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t k = 0; k < a.size(); ++k) {
+        if (!(a[k].key == b[k].key) ||
+            a[k].analysis->get_smash_version() != b[k].analysis->get_smash_version() ||
+            testing::binary_of(a[k].analysis->get_data()) != testing::binary_of(b[k].analysis->get_data())) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+TEST(partial_result_round_trip) {
+    testing::TempDir dir;
+    const std::string path = dir.file("TreeAnalysis.bark");
+    const PartialResult saved = sample_partial(1, 0);
+    saved.save(path);
+
+    const PartialResult loaded = PartialResult::load(path);
+    CHECK(loaded.analysis_name == saved.analysis_name);
+    CHECK(loaded.provenance.run == "run-1");
+    CHECK(loaded.provenance.shard_count == 2);
+    CHECK(loaded.provenance.shards == std::vector<uint32_t>{0});
+    CHECK(loaded.config == saved.config);
+    CHECK(loaded.analysis_config == saved.analysis_config);
+    CHECK(same_entries(loaded.entries, saved.entries));
+
+    const PartialResult header = PartialResult::load(path, false);
+    CHECK(header.analysis_name == saved.analysis_name);
+    CHECK(header.entries.empty());
+}
+
+TEST(partial_result_load_rejects_other_files) {
+    testing::TempDir dir;
+    const std::string path = dir.file("bad.bark");
+    std::ofstream(path, std::ios::binary) << "BKCP not a partial result";
+    CHECK_THROWS(PartialResult::load(path), std::runtime_error);
+
+    sample_partial(3, 0).save(path);
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    CHECK_THROWS(PartialResult::load(path), std::runtime_error);
+
+    // Any other version, older or newer, is refused rather than read with
+    // defaults that would skip the settings check of merge.
+    for (uint16_t version : {uint16_t{0}, uint16_t{PartialResult::VERSION + 1}}) {
+        sample_partial(1, 0).save(path);
+        {
+            std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+            out.seekp(sizeof(PartialResult::MAGIC));
+            binaryio::put(out, version);
+        }
+        CHECK_THROWS(PartialResult::load(path), std::runtime_error);
+    }
+}
+
+TEST(partial_result_load_rejects_oversized_string_lengths) {
+    // A name claiming 4 GiB but holding three bytes must fail as truncated
+    // rather than allocate the full length first.
+    testing::TempDir dir;
+    const std::string path = dir.file("huge.bark");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(PartialResult::MAGIC, sizeof(PartialResult::MAGIC));
+        binaryio::put(out, PartialResult::VERSION);
+        binaryio::put(out, uint32_t{0xffffffff});
+        out << "abc";
+    }
+    CHECK_THROWS(PartialResult::load(path), std::runtime_error);
+}
+
+TEST(merging_stored_partials_matches_merging_in_memory) {
+    testing::TempDir dir;
+    const PartialResult first = sample_partial(4, 0);
+    const PartialResult second = sample_partial(6, 1);
+    // Given out of shard order: merge_results sorts shards.
+    second.save(dir.file("shard-1.bark"));
+    first.save(dir.file("shard-0.bark"));
+    merge_results({dir.file("shard-1.bark"), dir.file("shard-0.bark")}, true, false,
+                  dir.file("merged"), 2, OutputFormat::Binary);
+
+    const PartialResult merged = PartialResult::load(dir.file("merged/TreeAnalysis.bark"));
+    CHECK(merged.provenance.is_complete());
+    CHECK(merged.entries.size() == first.entries.size());
+    for (size_t k = 0; k < merged.entries.size() && k < first.entries.size(); ++k) {
+        TreeAnalysis expected;
+        expected.set_merge_keys(first.entries[k].key);
+        expected.restore("SMASH-3.2", first.entries[k].analysis->get_data());
+        expected += *second.entries[k].analysis;
+        CHECK(merged.entries[k].key == first.entries[k].key);
+        CHECK(testing::binary_of(merged.entries[k].analysis->get_data()) ==
+              testing::binary_of(expected.get_data()));
+    }
+
+    CHECK_THROWS(merge_results({dir.file("shard-0.bark"), dir.file("shard-0.bark")}, false, false,
+                               dir.file("twice"), 1, OutputFormat::Binary),
+                 std::runtime_error);
+}
+
+TEST(merge_rejects_partials_with_different_settings) {
+    testing::TempDir dir;
+    PartialResult pions = sample_partial(4, 0);
+    pions.provenance = {};
+    PartialResult first_events = pions;
+    first_events.config = "q=;events=0:5;pdg=;charge=;cuts=";
+    PartialResult other_binning = pions;
+    other_binning.analysis_config = "TreeAnalysis:bins=40";
+    pions.save(dir.file("pions.bark"));
+    first_events.save(dir.file("events.bark"));
+    other_binning.save(dir.file("binning.bark"));
+
+    CHECK_THROWS(merge_results({dir.file("pions.bark"), dir.file("events.bark")}, true, false,
+                               dir.file("mixed"), 2, OutputFormat::Binary),
+                 std::runtime_error);
+    CHECK_THROWS(merge_results({dir.file("pions.bark"), dir.file("binning.bark")}, true, false,
+                               dir.file("mixed"), 1, OutputFormat::Yaml),
+                 std::runtime_error);
+    CHECK(!std::filesystem::exists(dir.file("mixed/TreeAnalysis.bark")));
+    CHECK(!std::filesystem::exists(dir.file("mixed/TreeAnalysis.yaml")));
+
+    // The settings carry over, so merged partials can be merged again.
+    merge_results({dir.file("pions.bark"), dir.file("pions.bark")}, true, false,
+                  dir.file("merged"), 1, OutputFormat::Binary);
+    const PartialResult merged = PartialResult::load(dir.file("merged/TreeAnalysis.bark"), false);
+    CHECK(merged.config == pions.config);
+    CHECK(merged.analysis_config == pions.analysis_config);
+}
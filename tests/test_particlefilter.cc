@@ -0,0 +1,165 @@
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+#include "binaryreader.h"
+#include "columnarfile.h"
+#include "particlefilter.h"
+#include "partialresult.h"
+#include "smashfile.h"
+#include "spectrumanalysis.h"
+#include "testing.h"
+
+namespace {
+using Ranges = std::unordered_map<Quantity, std::pair<double, double>>;
+
+// Records what a reader delivers: each block's size and all record bytes.
+struct RecordCollector : Accessor {
+    std::vector<uint32_t> npart;
+    std::string records;
+
+    void on_particle_block(const ParticleBlock& block) override {
+        npart.push_back(block.npart);
+        records.append(block.records().data(), block.records().size());
+    }
+};
+
+// pdg in {211, -211}, |pz| in [0.125, 0.5) and ncoll (an int column) in [1, 3).
+ParticleFilter sample_filter() {
+    ParticleFilter filter;
+    filter.pdgs = {211, -211};
+    filter.cuts.push_back(parse_cut("pz:0.125:0.5", true));
+    filter.cuts.push_back(parse_cut("ncoll:1:3"));
+    return filter;
+}
+
+// sample_filter written out by hand.
+bool passes(const SmashFile::Particle& p) {
+    return (p.pdg == 211 || p.pdg == -211) && std::fabs(p.pz) >= 0.125 && std::fabs(p.pz) < 0.5 &&
+           p.ncoll >= 1 && p.ncoll < 3;
+}
+
+// Writes `events` to `path`, keeping only the particles that pass the filter
+// when `filtered`. pz values sit exactly on the cut boundaries.
+void write_events(const std::string& path, bool filtered) {
+    const double pzs[] = {-0.75, -0.5, -0.25, -0.125, 0.0, 0.125, 0.25, 0.5, 0.75};
+    const int32_t pdgs[] = {211, -211, 111, 2212, -211};
+    SmashFile file(path);
+    for (int32_t event = 0; event < 6; ++event) {
+        for (int32_t ensemble = 0; ensemble < 2; ++ensemble) {
+            std::vector<SmashFile::Particle> particles;
+            const int n = event == 2 ? 0 : 7 + 5 * event + ensemble;
+            for (int i = 0; i < n; ++i) {
+                SmashFile::Particle p;
+                p.p0 = i;
+                p.pz = pzs[(3 * i + event) % 9];
+                p.pdg = event == 4 ? 111 : pdgs[(i + ensemble) % 5];  // event 4: nothing passes
+                p.ncoll = (i + event) % 4;
+                if (!filtered || passes(p)) particles.push_back(p);
+            }
+            file.particles(event, ensemble, particles);
+        }
+        file.end(static_cast<uint32_t>(event));
+    }
+}
+
+std::shared_ptr<RecordCollector> collect(const std::string& path, ReadMode mode,
+                                         const ParticleFilter* filter) {
+    auto collector = std::make_shared<RecordCollector>();
+    BinaryReader reader(path, SmashFile::quantities(), collector, mode);
+    if (filter) reader.set_filter(*filter);
+    reader.read();
+    return collector;
+}
+
+// The SpectrumAnalysis tree of a run over `path`.
+std::string spectrum(const std::string& path, const std::string& output, ReadMode mode,
+                     int block_workers, const ParticleFilter& filter) {
+    run_analysis({{path, ""}}, SpectrumAnalysis::NAME, SmashFile::quantities(), true, false, output,
+                 mode, 1, block_workers, {}, filter, "", {}, OutputFormat::Binary);
+    const PartialResult result = PartialResult::load(output + "/" + SpectrumAnalysis::NAME + ".bark");
+    return result.entries.size() == 1 ? testing::binary_of(result.entries[0].analysis->get_data()) : "";
+}
+} // namespace
+
+TEST(filtered_reads_match_a_prefiltered_file) {
+    testing::TempDir dir;
+    const std::string full = dir.file("full.bin");
+    const std::string reference = dir.file("reference.bin");
+    write_events(full, false);
+    write_events(reference, true);
+    const ParticleFilter filter = sample_filter();
+
+    const auto expected = collect(reference, ReadMode::Stream, nullptr);
+    CHECK(!expected->records.empty());
+    for (ReadMode mode : {ReadMode::Stream, ReadMode::Mmap, ReadMode::ReadAhead}) {
+        const auto filtered = collect(full, mode, &filter);
+        CHECK(filtered->npart == expected->npart);
+        CHECK(filtered->records == expected->records);
+
+        const std::string want = spectrum(reference, dir.file("want"), mode, 1, {});
+        CHECK(!want.empty());
+        CHECK(spectrum(full, dir.file("serial"), mode, 1, filter) == want);
+        CHECK(spectrum(full, dir.file("workers"), mode, 3, filter) == want);
+    }
+
+    // Columnar caches skip chunks that can't pass, so only the records compare.
+    ConvertOptions options;
+    options.chunk_events = 1;
+    convert_to_columnar(full, columnar_path(full), SmashFile::quantities(), options);
+    CHECK(collect(columnar_path(full), ReadMode::Mmap, &filter)->records == expected->records);
+}
+
+TEST(filter_may_match_treats_ranges_as_closed_and_cuts_as_half_open) {
+    ParticleFilter cut;
+    cut.cuts.push_back(parse_cut("pz:0.1:0.5"));
+    CHECK(cut.may_match({}));                                    // no statistics
+    CHECK(cut.may_match({{Quantity::PZ, {-1.0, 0.1}}}));         // max == cut.min passes
+    CHECK(!cut.may_match({{Quantity::PZ, {-1.0, 0.0999}}}));
+    CHECK(!cut.may_match({{Quantity::PZ, {0.5, 2.0}}}));         // min == cut.max fails
+    CHECK(cut.may_match({{Quantity::PZ, {0.4999, 2.0}}}));
+    CHECK(!cut.may_match({{Quantity::PZ, {1.0, -1.0}}}));        // empty range
+    CHECK(cut.may_match({{Quantity::PX, {5.0, 6.0}}}));          // other quantity
+
+    ParticleFilter abs;
+    abs.cuts.push_back(parse_cut("pz:0.1:0.5", true));
+    CHECK(!abs.may_match({{Quantity::PZ, {-0.05, 0.05}}}));      // |pz| <= 0.05
+    CHECK(abs.may_match({{Quantity::PZ, {-0.05, 0.1}}}));        // |pz| reaches 0.1
+    CHECK(abs.may_match({{Quantity::PZ, {-0.7, 0.05}}}));        // |pz| spans [0, 0.7]
+    CHECK(!abs.may_match({{Quantity::PZ, {-0.9, -0.5}}}));       // |pz| in [0.5, 0.9]
+    CHECK(abs.may_match({{Quantity::PZ, {-0.9, -0.4}}}));
+
+    ParticleFilter species;
+    species.pdgs = {211, -211};
+    CHECK(species.may_match({{Quantity::PDG, {211.0, 2212.0}}}));
+    CHECK(species.may_match({{Quantity::PDG, {-211.0, -211.0}}}));
+    CHECK(!species.may_match({{Quantity::PDG, {-210.0, 210.0}}}));
+    CHECK(!species.may_match({{Quantity::PDG, {212.0, 2212.0}}}));
+
+    ParticleFilter ints;
+    ints.cuts.push_back(parse_cut("ncoll:1:3"));
+    CHECK(ints.may_match({{Quantity::NCOLL, {0.0, 1.0}}}));
+    CHECK(!ints.may_match({{Quantity::NCOLL, {3.0, 9.0}}}));
+}
+
+TEST(parse_cut_reads_open_bounds_and_rejects_bad_specs) {
+    const ParticleFilter::Cut upper = parse_cut("pz::1.5", true);
+    CHECK(upper.quantity == Quantity::PZ);
+    CHECK(upper.absolute);
+    CHECK(std::isinf(upper.min) && upper.min < 0);
+    CHECK(upper.max == 1.5);
+
+    const ParticleFilter::Cut lower = parse_cut("ncoll:2:");
+    CHECK(lower.quantity == Quantity::NCOLL);
+    CHECK(!lower.absolute);
+    CHECK(lower.min == 2.0);
+    CHECK(std::isinf(lower.max) && lower.max > 0);
+
+    CHECK_THROWS(parse_cut("pz:1"), std::runtime_error);
+    CHECK_THROWS(parse_cut("bogus:0:1"), std::runtime_error);
+    CHECK_THROWS(parse_cut("pz:low:1"), std::runtime_error);
+    CHECK(parse_int_list("211,,-211") == std::vector<int32_t>({211, -211}));
+    CHECK_THROWS(parse_int_list("211,pion"), std::runtime_error);
+}
@@ -0,0 +1,108 @@
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "analysis.h"
+#include "binaryreader.h"
+#include "pipeline.h"
+#include "smashfile.h"
+#include "spectrumanalysis.h"
+#include "testing.h"
+
+namespace {
+// Remembers the (event, ensemble) of every particle block it analyses,
+// outside the result tree so that merging leaves it in place.
+class EventLog : public Analysis {
+public:
+    std::vector<std::pair<int32_t, int32_t>> blocks;
+
+    void analyze_particle_block(const ParticleBlock& block, const Accessor& /*accessor*/) override {
+        blocks.emplace_back(block.event_number, block.ensamble_number);
+    }
+    void finalize() override {}
+    void save(const std::string& /*save_dir_path*/) override {}
+};
+
+// Events of three ensembles with varying sizes, some empty, then a stretch of
+// collision history.
+void write_ensembles(const std::string& path) {
+    SmashFile file(path);
+    for (int32_t event = 0; event < 12; ++event) {
+        for (int32_t ensemble = 0; ensemble < 3; ++ensemble) {
+            const uint32_t n = (event * 7 + ensemble * 3) % 11 == 0 ? 0 : 1 + (event * 5 + ensemble) % 9;
+            file.particles(event, ensemble, n);
+        }
+        for (uint32_t ensemble = 0; ensemble < 3; ++ensemble) {
+            file.end(static_cast<uint32_t>(event), ensemble, event % 5 == 3);
+        }
+    }
+    for (uint32_t event = 12; event < 16; ++event) {
+        file.interaction(2, 2).interaction(1, 3 + event % 2).end(event);
+    }
+}
+
+struct PipelineRun {
+    std::string tree;                // merged SpectrumAnalysis result
+    std::vector<std::shared_ptr<EventLog>> logs;  // per worker
+};
+
+PipelineRun read_pipelined(const std::string& path, ReadMode mode, int n_workers, size_t batch_size) {
+    PipelineRun run;
+    std::vector<std::vector<std::shared_ptr<Analysis>>> analyses;
+    for (int w = 0; w < n_workers; ++w) {
+        auto spectrum = std::make_shared<SpectrumAnalysis>();
+        auto log = std::make_shared<EventLog>();
+        run.logs.push_back(log);
+        analyses.push_back({spectrum, log});
+    }
+    auto pipeline = std::make_shared<PipelinedAccessor>(std::move(analyses), batch_size);
+    BinaryReader reader(path, SmashFile::quantities(), pipeline, mode);
+    reader.read();
+    run.tree = testing::binary_of(pipeline->finish().front()->get_data());
+    return run;
+}
+
+std::string read_serial(const std::string& path) {
+    auto spectrum = std::make_shared<SpectrumAnalysis>();
+    auto dispatcher = std::make_shared<DispatchingAccessor>();
+    dispatcher->register_analysis(spectrum);
+    BinaryReader reader(path, SmashFile::quantities(), dispatcher, ReadMode::Stream);
+    reader.read();
+    return testing::binary_of(spectrum->get_data());
+}
+} // namespace
+
+TEST(block_workers_match_a_serial_read) {
+    testing::TempDir dir;
+    const std::string path = dir.file("ensembles.bin");
+    write_ensembles(path);
+    const std::string serial = read_serial(path);
+
+    for (ReadMode mode : {ReadMode::Stream, ReadMode::Mmap, ReadMode::ReadAhead}) {
+        for (int n_workers : {1, 2, 3, 5}) {
+            for (size_t batch_size : {size_t{1}, size_t{2}, size_t{7}, size_t{64}}) {
+                const PipelineRun run = read_pipelined(path, mode, n_workers, batch_size);
+                CHECK(run.tree == serial);
+
+                // Every event's blocks went to one worker, in file order.
+                std::vector<int> worker_of(12, -1);
+                size_t n_blocks = 0;
+                for (size_t w = 0; w < run.logs.size(); ++w) {
+                    const auto& blocks = run.logs[w]->blocks;
+                    n_blocks += blocks.size();
+                    for (size_t k = 0; k < blocks.size(); ++k) {
+                        const auto [event, ensemble] = blocks[k];
+                        if (k > 0) CHECK(blocks[k - 1] < blocks[k]);
+                        if (ensemble == 0) {
+                            worker_of[event] = static_cast<int>(w);
+                        } else {
+                            CHECK(worker_of[event] == static_cast<int>(w));
+                        }
+                    }
+                }
+                CHECK(n_blocks == 36);
+            }
+        }
+    }
+}
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+#include "partialresult.h"
+#include "smashfile.h"
+#include "testing.h"
+
+namespace {
+using Block = std::vector<SmashFile::Particle>;
+
+// Blocks of mixed species with momenta inside and outside the histogram
+// ranges, some without wounded nucleons and one with more than the last
+// wounded bin.
+std::vector<Block> sample_blocks() {
+    const int pdgs[] = {211, -211, 111, 2212, -2212, 2112, 321, -3334, 3312, 22, 1000010020, 310};
+    uint64_t seed = 12345;
+    auto uniform = [&](double lo, double hi) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return lo + (hi - lo) * (static_cast<double>(seed >> 11) * 0x1.0p-53);
+    };
+    std::vector<Block> blocks;
+    for (int b = 0; b < 60; ++b) {
+        Block block(b == 17 ? 450 : static_cast<size_t>(uniform(0.0, 80.0)));
+        for (SmashFile::Particle& p : block) {
+            p.pdg = b == 17 && uniform(0.0, 1.0) < 0.95 ? 2212 : pdgs[static_cast<int>(uniform(0.0, 12.0))];
+            p.ncoll = b % 7 == 3 ? 0 : static_cast<int32_t>(uniform(0.0, 4.0));
+            p.p0 = uniform(0.1, 5.0);
+            p.pz = uniform(-5.0, 5.0);
+            p.px = uniform(-2.0, 2.0);
+            p.py = uniform(-2.0, 2.0);
+        }
+        blocks.push_back(std::move(block));
+    }
+    return blocks;
+}
+
+// The Rapidity tree by the original per-particle add_child/fill path.
+DataNode per_particle_tree(const std::vector<Block>& blocks) {
+    std::set<int> selected;
+    for (int pdg : {111, 211, 311, 321, 310, 130, 3122, 3222, 3212, 3112, 3322, 3312, 3334, 2212}) {
+        selected.insert(pdg);
+        if (pdg != 111 && pdg != 310 && pdg != 130) selected.insert(-pdg);
+    }
+    const Histogram1D y_hist(-4.0, 4.0, 30), pt_hist(0.0, 3.0, 30);
+    auto histogram = [](DataNode& group, const std::string& key, const Histogram1D& like) -> Histogram1D& {
+        Data& d = group.add_child(key).get_data();
+        if (!std::holds_alternative<Histogram1D>(d)) d = like;
+        return std::get<Histogram1D>(d);
+    };
+
+    DataNode tree;
+    DataNode& wounded_node = tree.add_child("wounded");
+    for (const Block& block : blocks) {
+        int wounded = 0;
+        for (const auto& p : block) wounded += (p.pdg == 2212 || p.pdg == 2112) && p.ncoll > 0;
+        if (wounded <= 0) continue;
+        const int start = std::clamp(wounded, 0, 416) / 10 * 10;
+        char label[32];
+        std::snprintf(label, sizeof(label), "w%03d-%03d", start, std::min(start + 9, 416));
+        DataNode& group = wounded_node.add_child(label);
+
+        for (const auto& p : block) {
+            if (!selected.count(p.pdg)) continue;
+            const double y = 0.5 * std::log((p.p0 + p.pz) / (p.p0 - p.pz));
+            if (std::isfinite(p.p0) && std::isfinite(p.pz) && p.p0 > std::abs(p.pz) &&
+                std::isfinite(y) && y >= -4.0 && y < 4.0) {
+                histogram(group, "rapidity_pdg_" + std::to_string(p.pdg), y_hist).fill(y);
+            }
+            const double pt = std::hypot(p.px, p.py);
+            if (std::isfinite(pt) && pt >= 0.0 && pt < 3.0 && std::abs(y) < 0.5) {
+                histogram(group, "p_perp_pdg_" + std::to_string(p.pdg), pt_hist).fill(pt);
+            }
+        }
+        Data& n_events = group.add_child("n_events").get_data();
+        if (!std::holds_alternative<int>(n_events)) n_events = 0;
+        ++std::get<int>(n_events);
+    }
+    return tree;
+}
+} // namespace
+
+TEST(rapidity_matches_per_particle_fills) {
+    testing::TempDir dir;
+    const std::string path = dir.file("events.bin");
+    const std::vector<Block> blocks = sample_blocks();
+    {
+        SmashFile file(path);
+        for (size_t b = 0; b < blocks.size(); b += 2) {  // two ensembles per event
+            const int32_t event = static_cast<int32_t>(b / 2);
+            file.particles(event, 0, blocks[b]).particles(event, 1, blocks[b + 1]);
+            file.end(static_cast<uint32_t>(event), 0).end(static_cast<uint32_t>(event), 1);
+        }
+    }
+    const std::string expected = testing::binary_of(per_particle_tree(blocks));
+
+    for (int block_workers : {1, 3}) {
+        const std::string output = dir.file("out" + std::to_string(block_workers));
+        run_analysis({{path, ""}}, "Rapidity", SmashFile::quantities(), true, false, output,
+                     ReadMode::Stream, 1, block_workers, {}, {}, "", {}, OutputFormat::Binary);
+        const PartialResult result = PartialResult::load(output + "/Rapidity.bark");
+        CHECK(result.entries.size() == 1);
+        if (result.entries.size() != 1) continue;
+        CHECK(testing::binary_of(result.entries[0].analysis->get_data()) == expected);
+    }
+}
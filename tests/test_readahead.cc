@@ -0,0 +1,82 @@
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "readahead.h"
+#include "testing.h"
+
+namespace {
+constexpr size_t BUFFER = 4096;
+
+// A file of `size` bytes that differ from their neighbours and from the
+// bytes one buffer further on.
+std::vector<char> write_pattern(const std::string& path, size_t size) {
+    std::vector<char> bytes(size);
+    for (size_t i = 0; i < size; ++i) bytes[i] = static_cast<char>((i * 131 + i / BUFFER * 7) & 0xff);
+    std::ofstream(path, std::ios::binary).write(bytes.data(), static_cast<std::streamsize>(size));
+    return bytes;
+}
+
+bool same(const char* got, const std::vector<char>& bytes, size_t at, size_t n) {
+    return at + n <= bytes.size() && std::memcmp(got, bytes.data() + at, n) == 0;
+}
+} // namespace
+
+TEST(read_ahead_with_small_buffers_returns_the_file_bytes) {
+    testing::TempDir dir;
+    const std::string path = dir.file("pattern.bin");
+    const std::vector<char> bytes = write_pattern(path, 10 * BUFFER + 123);
+    ReadAheadFile file(path, BUFFER, 2);
+
+    // Reads that fit, end on and straddle buffer boundaries, and take(n)
+    // longer than one and than two buffers.
+    size_t at = 0;
+    char c = 0;
+    CHECK(file.peek(c) && c == bytes[0]);
+    CHECK(file.next(c) && c == bytes[at++]);
+    for (size_t n : {size_t{100}, BUFFER - 101, size_t{16}, BUFFER, BUFFER + 1000, 2 * BUFFER + 7, size_t{1}}) {
+        CHECK(same(file.take(n), bytes, at, n));
+        at += n;
+        CHECK(file.next(c) && c == bytes[at++]);
+    }
+
+    // Random walk of next/take, with seeks to offsets in and on buffer edges.
+    std::mt19937 rng(7);
+    for (int step = 0; step < 2000; ++step) {
+        const unsigned op = rng() % 10;
+        if (op == 0) {
+            at = rng() % 3 == 0 ? (rng() % 10) * BUFFER : rng() % bytes.size();
+            file.seek(at);
+        } else if (op < 4) {
+            if (at == bytes.size()) continue;
+            CHECK(file.next(c) && c == bytes[at]);
+            ++at;
+        } else {
+            const size_t n = std::min<size_t>(rng() % (op == 9 ? 3 * BUFFER : 300), bytes.size() - at);
+            CHECK(same(file.take(n), bytes, at, n));
+            at += n;
+        }
+    }
+
+    // A take up to the end of a buffer stays valid while peek() moves on to
+    // the next one (as after the records of a block), and so does a staged one.
+    file.seek(BUFFER - 20);
+    const char* tail = file.take(20);
+    CHECK(file.peek(c) && c == bytes[BUFFER]);
+    CHECK(same(tail, bytes, BUFFER - 20, 20));
+    const char* staged = file.take(2 * BUFFER + 5);
+    CHECK(file.peek(c) && c == bytes[3 * BUFFER + 5]);
+    CHECK(same(staged, bytes, BUFFER, 2 * BUFFER + 5));
+
+    // The end of the file, then back to the start.
+    file.seek(bytes.size() - 5);
+    CHECK(same(file.take(4), bytes, bytes.size() - 5, 4));
+    CHECK(file.next(c) && c == bytes.back());
+    CHECK(!file.next(c));
+    CHECK(!file.peek(c));
+    file.seek(0);
+    CHECK(same(file.take(3 * BUFFER), bytes, 0, 3 * BUFFER));
+    CHECK_THROWS(file.take(bytes.size()), std::runtime_error);
+}
@@ -0,0 +1,54 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "record.h"
+#include "testing.h"
+
+namespace {
+// Records of P0 (double) and PDG (int32) followed by 4 bytes the layout does
+// not describe, so the record is wider than the quantities it lists.
+constexpr size_t record_size = 16;
+
+std::vector<char> records(const std::vector<std::pair<double, int32_t>>& particles) {
+    std::vector<char> bytes(particles.size() * record_size, 0);
+    for (size_t i = 0; i < particles.size(); ++i) {
+        std::memcpy(bytes.data() + i * record_size, &particles[i].first, sizeof(double));
+        std::memcpy(bytes.data() + i * record_size + 8, &particles[i].second, sizeof(int32_t));
+    }
+    return bytes;
+}
+
+const std::unordered_map<Quantity, size_t> layout = {{Quantity::P0, 0}, {Quantity::PDG, 8}};
+} // namespace
+
+TEST(dynamic_record_rejects_quantities_outside_the_layout) {
+    CHECK_THROWS((DynamicRecord(layout, {Quantity::P0, Quantity::PZ})), std::runtime_error);
+
+    const DynamicRecord rec(layout, {Quantity::P0, Quantity::PDG});
+    const std::vector<char> bytes = records({{1.5, 211}});
+    CHECK(rec.get<Quantity::P0>(bytes.data()) == 1.5);
+    CHECK(rec.get<Quantity::PDG>(bytes.data()) == 211);
+    CHECK_THROWS(rec.get<Quantity::PZ>(bytes.data()), std::runtime_error);
+    CHECK_THROWS(rec.get<Quantity::NCOLL>(bytes.data()), std::runtime_error);
+
+    const DynamicRecord unbound;
+    CHECK_THROWS(unbound.get<Quantity::P0>(bytes.data()), std::runtime_error);
+}
+
+TEST(for_each_record_steps_by_the_block_particle_size) {
+    const std::vector<std::pair<double, int32_t>> particles = {{1.0, 211}, {2.0, -211}, {3.0, 2212}};
+    const std::vector<char> bytes = records(particles);
+    ParticleBlock block;
+    block.npart = static_cast<uint32_t>(particles.size());
+    block.set_records(bytes.data(), record_size, false);
+
+    const DynamicRecord rec(layout, {Quantity::P0, Quantity::PDG});
+    std::vector<std::pair<double, int32_t>> seen;
+    for_each_record(block, rec, [&](const char* p) {
+        seen.emplace_back(rec.get<Quantity::P0>(p), rec.get<Quantity::PDG>(p));
+    });
+    CHECK(seen == particles);
+}
@@ -0,0 +1,99 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "analysisregister.h"
+#include "resultcache.h"
+#include "testing.h"
+#include "treeanalysis.h"
+
+namespace {
+void write_file(const std::string& path, const std::string& content) {
+    std::ofstream out(path, std::ios::binary);
+    out << content;
+}
+
+size_t count_files(const std::filesystem::path& dir) {
+    size_t n = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        (void)entry;
+        ++n;
+    }
+    return n;
+}
+} // namespace
+
+TEST(result_cache_round_trip) {
+    testing::TempDir dir;
+    const ResultCache cache(dir.file("cache"));
+    const std::string key = ResultCache::make_key("fingerprint", TreeAnalysis::NAME, TreeAnalysis::NAME, "config");
+
+    TreeAnalysis stored;
+    stored.fill(1);
+    stored.set_smash_version("SMASH-3.2");
+    cache.store(key, stored);
+
+    TreeAnalysis loaded;
+    CHECK(cache.load(key, loaded));
+    CHECK(loaded.get_smash_version() == "SMASH-3.2");
+    CHECK(testing::binary_of(loaded.get_data()) == testing::binary_of(stored.get_data()));
+
+    TreeAnalysis other;
+    CHECK(!cache.load(ResultCache::make_key("fingerprint", TreeAnalysis::NAME, TreeAnalysis::NAME, "other config"), other));
+    CHECK(!cache.load(ResultCache::make_key("fingerprint", TreeAnalysis::NAME, "other binning", "config"), other));
+}
+
+TEST(analysis_config_id_defaults_to_registered_name) {
+    const auto analysis = AnalysisRegistry::instance().create(TreeAnalysis::NAME);
+    CHECK(analysis->get_name() == TreeAnalysis::NAME);
+    CHECK(analysis->config_id() == TreeAnalysis::NAME);
+}
+
+TEST(result_cache_ignores_unreadable_entries) {
+    testing::TempDir dir;
+    const ResultCache cache(dir.file("cache"));
+    const std::string key = ResultCache::make_key("fingerprint", TreeAnalysis::NAME, TreeAnalysis::NAME, "config");
+    TreeAnalysis stored;
+    stored.fill(2);
+    cache.store(key, stored);
+
+    for (const auto& entry : std::filesystem::directory_iterator(dir.file("cache"))) {
+        std::filesystem::resize_file(entry.path(), std::filesystem::file_size(entry.path()) / 2);
+    }
+    TreeAnalysis loaded;
+    CHECK(!cache.load(key, loaded));
+}
+
+TEST(result_cache_concurrent_stores_leave_one_entry) {
+    testing::TempDir dir;
+    const ResultCache cache(dir.file("cache"));
+    const std::string key = ResultCache::make_key("fingerprint", TreeAnalysis::NAME, TreeAnalysis::NAME, "config");
+    TreeAnalysis stored;
+    stored.fill(3);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 20; ++i) cache.store(key, stored);
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    CHECK(count_files(dir.file("cache")) == 1);  // no temporaries left behind
+    TreeAnalysis loaded;
+    CHECK(cache.load(key, loaded));
+    CHECK(testing::binary_of(loaded.get_data()) == testing::binary_of(stored.get_data()));
+}
+
+TEST(file_fingerprint_tracks_content) {
+    testing::TempDir dir;
+    const std::string path = dir.file("particles.bin");
+    write_file(path, std::string(4096, 'a'));
+    const std::string before = ResultCache::file_fingerprint(path);
+    CHECK(ResultCache::file_fingerprint(path) == before);
+
+    write_file(path, std::string(4095, 'a') + 'b');  // same size
+    CHECK(ResultCache::file_fingerprint(path) != before);
+}
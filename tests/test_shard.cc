@@ -0,0 +1,160 @@
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "analysis.h"
+#include "eventindex.h"
+#include "partialresult.h"
+#include "smashfile.h"
+#include "spectrumanalysis.h"
+#include "testing.h"
+
+namespace {
+using Inputs = std::vector<std::pair<std::string, std::string>>;
+
+// `events` events of `ensembles` ensembles each; event e has e % 4 + 1
+// particles per ensemble, with species and momenta that differ per file.
+void write_events(const std::string& path, int32_t events, int32_t ensembles, int32_t file_id) {
+    SmashFile file(path);
+    for (int32_t event = 0; event < events; ++event) {
+        for (int32_t ensemble = 0; ensemble < ensembles; ++ensemble) {
+            std::vector<SmashFile::Particle> particles;
+            for (int32_t k = 0; k <= event % 4; ++k) {
+                SmashFile::Particle p;
+                p.p0 = event + k + 0.5;
+                p.pz = 0.1 * (k - 1) + 0.01 * file_id;
+                p.pdg = 211 + file_id;
+                p.ncoll = (event + ensemble) % 8;
+                particles.push_back(p);
+            }
+            file.particles(event, ensemble, particles);
+        }
+        for (int32_t ensemble = 0; ensemble < ensembles; ++ensemble) {
+            file.end(static_cast<uint32_t>(event), static_cast<uint32_t>(ensemble));
+        }
+    }
+}
+
+// Files with a merge key each, so entries show which file they came from.
+Inputs write_inputs(const testing::TempDir& dir, int32_t n_files) {
+    Inputs inputs;
+    for (int32_t f = 0; f < n_files; ++f) {
+        const std::string path = dir.file("run" + std::to_string(f) + ".bin");
+        write_events(path, 5 + 2 * f, 1 + f % 2, f);
+        inputs.emplace_back(path, "file=" + std::to_string(f));
+    }
+    return inputs;
+}
+
+void run(const Inputs& inputs, const std::string& output, const ShardSpec& shard = {}) {
+    run_analysis(inputs, SpectrumAnalysis::NAME, SmashFile::quantities(), true, false, output,
+                 ReadMode::Stream, 1, 1, {}, {}, "", {}, OutputFormat::Binary, shard);
+}
+
+// 1/1 is not sharded and writes the plain partial.
+std::string shard_file(const std::string& output, const ShardSpec& shard) {
+    if (!shard.is_sharded()) return output + "/" + SpectrumAnalysis::NAME + ".bark";
+    return output + "/" + SpectrumAnalysis::NAME + ".shard-" + std::to_string(shard.index) + "-of-" +
+           std::to_string(shard.count) + ".bark";
+}
+
+// Label and tree of every entry, in key order.
+std::vector<std::pair<std::string, std::string>> trees(const std::string& bark) {
+    std::vector<std::pair<std::string, std::string>> out;
+    for (const Entry& e : PartialResult::load(bark).entries) {
+        out.emplace_back(label_from_keyset(e.key), testing::binary_of(e.analysis->get_data()));
+    }
+    return out;
+}
+
+// Runs every shard i/N of `inputs`, merges them and returns the merged trees.
+std::vector<std::pair<std::string, std::string>> merged_shards(const testing::TempDir& dir,
+                                                               const Inputs& inputs,
+                                                               uint32_t count, ShardSpec::Mode mode) {
+    const std::string tag = std::to_string(count) + (mode == ShardSpec::Mode::Files ? "f" : "e");
+    const std::string output = dir.file("shards-" + tag);
+    std::vector<std::string> partials;
+    for (uint32_t i = 0; i < count; ++i) {
+        const ShardSpec shard{i, count, mode};
+        run(inputs, output, shard);
+        partials.push_back(shard_file(output, shard));
+    }
+    merge_results(partials, true, false, dir.file("merged-" + tag), 1, OutputFormat::Binary);
+    return trees(dir.file("merged-" + tag) + "/" + SpectrumAnalysis::NAME + ".bark");
+}
+} // namespace
+
+TEST(parse_shard_takes_only_whole_numbers) {
+    const ShardSpec first = parse_shard("0/1");
+    CHECK(first.index == 0 && first.count == 1 && !first.is_sharded());
+    const ShardSpec last = parse_shard("3/4");
+    CHECK(last.index == 3 && last.count == 4 && last.is_sharded());
+
+    for (const char* bad : {"1/4x", "1x/4", "4/4", "1/0", "/4", "1/", "1", "a/b", " 1/4", "1/ 4",
+                            "-1/4", "+1/4", "1/4/5", "1/4294967296", ""}) {
+        CHECK_THROWS(parse_shard(bad), std::runtime_error);
+    }
+}
+
+TEST(event_splits_cover_every_event_once) {
+    testing::TempDir dir;
+    const std::string path = dir.file("events.bin");
+    write_events(path, 9, 2, 0);
+    const EventIndex index = EventIndex::build(path, compute_particle_size(SmashFile::quantities()));
+    CHECK(index.event_count() == 9);
+    for (size_t parts = 1; parts <= 12; ++parts) {
+        const std::vector<EventRange> ranges = index.split(parts);
+        CHECK(!ranges.empty() && ranges.size() <= parts);
+        CHECK(ranges.back().last == std::numeric_limits<int32_t>::max());
+        for (size_t k = 0; k + 1 < ranges.size(); ++k) CHECK(ranges[k].last == ranges[k + 1].first);
+        for (const EventIndexEntry& e : index.entries()) {
+            size_t owners = 0;
+            for (const EventRange& r : ranges) owners += r.contains(e.event_number);
+            CHECK(owners == 1);
+        }
+    }
+}
+
+TEST(file_shards_slice_the_inputs_and_merge_to_the_unsharded_run) {
+    testing::TempDir dir;
+    const Inputs inputs = write_inputs(dir, 3);
+    run(inputs, dir.file("all"));
+    const auto expected = trees(dir.file("all/") + SpectrumAnalysis::NAME + ".bark");
+    CHECK(expected.size() == inputs.size());
+
+    // More shards than files leaves some shards empty; each file is in
+    // exactly the shard n * i / N <= f < n * (i + 1) / N.
+    for (uint32_t count : {1u, 2u, 3u, 5u}) {
+        std::vector<int> owners(inputs.size(), 0);
+        for (uint32_t i = 0; i < count; ++i) {
+            const ShardSpec shard{i, count, ShardSpec::Mode::Files};
+            const std::string output = dir.file("slice-" + std::to_string(count));
+            run(inputs, output, shard);
+            for (const auto& [label, tree] : trees(shard_file(output, shard))) {
+                for (size_t f = 0; f < inputs.size(); ++f) {
+                    if (label.find("file=" + std::to_string(f)) == std::string::npos) continue;
+                    ++owners[f];
+                    CHECK(f >= inputs.size() * i / count && f < inputs.size() * (i + 1) / count);
+                }
+            }
+        }
+        for (int n : owners) CHECK(n == 1);
+        CHECK(merged_shards(dir, inputs, count, ShardSpec::Mode::Files) == expected);
+    }
+}
+
+TEST(event_shards_merge_to_the_unsharded_run) {
+    testing::TempDir dir;
+    const Inputs inputs = write_inputs(dir, 2);
+    run(inputs, dir.file("all"));
+    const auto expected = trees(dir.file("all/") + SpectrumAnalysis::NAME + ".bark");
+    CHECK(expected.size() == inputs.size());
+
+    // 20 shards is more than either file has events.
+    for (uint32_t count : {1u, 2u, 3u, 20u}) {
+        CHECK(merged_shards(dir, inputs, count, ShardSpec::Mode::Events) == expected);
+    }
+}
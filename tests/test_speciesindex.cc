@@ -0,0 +1,70 @@
+#include <map>
+#include <vector>
+
+#include "speciesindex.h"
+#include "testing.h"
+
+namespace {
+// index() of every code in [-20000, 20000] and of `extra` agrees with `expected`.
+bool matches(const SpeciesIndex& species, const std::map<int, int>& expected,
+             const std::vector<int>& extra) {
+    auto want = [&](int pdg) {
+        auto it = expected.find(pdg);
+        return it == expected.end() ? -1 : it->second;
+    };
+    for (int pdg = -20000; pdg <= 20000; ++pdg) {
+        if (species.index(pdg) != want(pdg)) return false;
+    }
+    for (int pdg : extra) {
+        if (species.index(pdg) != want(pdg)) return false;
+    }
+    for (const auto& [pdg, idx] : expected) {
+        if (species.pdg(idx) != pdg) return false;
+    }
+    return species.size() == expected.size();
+}
+} // namespace
+
+TEST(species_index_grows_and_falls_back_to_the_hash) {
+    const std::vector<int> nuclei = {1000010020, -1000010020, 1000020040, 1 << 14, -(1 << 14), 100000};
+    const std::vector<int> probes = {1000010030, -1000020040, 1 << 15, 99999, 16383, -16383};
+
+    SpeciesIndex species;
+    std::map<int, int> expected;
+    CHECK(matches(species, expected, probes));
+    auto add = [&](int pdg) {
+        const int idx = species.add(pdg);
+        expected.emplace(pdg, idx);
+        CHECK(idx == expected.at(pdg));
+    };
+
+    // Negative codes, then codes that grow and re-centre the table.
+    add(211);
+    add(-211);
+    add(111);
+    CHECK(matches(species, expected, probes));
+    add(-3334);
+    add(3312);
+    CHECK(matches(species, expected, probes));
+    CHECK(species.index(211) == 0 && species.index(-211) == 1 && species.index(-3334) == 3);
+
+    // Nuclei and |pdg| >= 2^14 go to the hash. Codes inside the table range
+    // that miss it must still report -1 with the hash non-empty.
+    for (int pdg : nuclei) add(pdg);
+    CHECK(matches(species, expected, probes));
+    CHECK(species.index(212) == -1 && species.index(0) == -1 && species.index(-111) == -1);
+
+    // Growing the table again keeps every earlier index, hashed ones too.
+    add(16383);
+    add(-9000);
+    CHECK(matches(species, expected, probes));
+
+    // Adding a known code returns its index and adds nothing.
+    const size_t size = species.size();
+    CHECK(species.add(-3334) == 3 && species.add(1000010020) == expected.at(1000010020));
+    CHECK(species.size() == size);
+
+    const SpeciesIndex from_list({2212, -2212, 1000010020, 22});
+    CHECK(from_list.index(-2212) == 1 && from_list.index(1000010020) == 2 && from_list.index(22) == 3);
+    CHECK(from_list.pdgs() == std::vector<int>({2212, -2212, 1000010020, 22}));
+}
@@ -0,0 +1,239 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "analysisregister.h"
+#include "datatree.h"
+#include "smashfile.h"
+#include "testing.h"
+#include "yamlwriter.h"
+
+namespace {
+constexpr double inf = std::numeric_limits<double>::infinity();
+constexpr double not_a_number = std::numeric_limits<double>::quiet_NaN();
+
+// Writes the same document through a YamlWriter and a YAML::Emitter.
+struct BothWriters {
+    std::string path;
+    YamlWriter writer;
+    YAML::Emitter emitter;
+
+    explicit BothWriters(std::string p) : path(std::move(p)), writer(path) {}
+
+    BothWriters& begin_map() { writer.begin_map(); emitter << YAML::BeginMap; return *this; }
+    BothWriters& end_map() { writer.end_map(); emitter << YAML::EndMap; return *this; }
+    BothWriters& begin_seq() { writer.begin_seq(); emitter << YAML::BeginSeq; return *this; }
+    BothWriters& end_seq() { writer.end_seq(); emitter << YAML::EndSeq; return *this; }
+
+    BothWriters& key(std::string_view k, bool double_quoted = false) {
+        writer.key(k, double_quoted);
+        emitter << YAML::Key;
+        if (double_quoted) emitter << YAML::DoubleQuoted;
+        emitter << std::string(k) << YAML::Value;
+        return *this;
+    }
+
+    template <typename T>
+    BothWriters& value(T v) {
+        writer.value(v);
+        if constexpr (std::is_same_v<T, std::string_view>) {
+            emitter << std::string(v);
+        } else {
+            emitter << v;
+        }
+        return *this;
+    }
+
+    template <typename T>
+    BothWriters& flow_seq(const std::vector<T>& values) {
+        writer.flow_seq(values);
+        emitter << YAML::Flow << YAML::BeginSeq;
+        for (const T& v : values) emitter << v;
+        emitter << YAML::EndSeq;
+        return *this;
+    }
+
+    // The YamlWriter's file and the emitter's output.
+    std::pair<std::string, std::string> finish() {
+        writer.close();
+        std::ifstream in(path, std::ios::binary);
+        std::ostringstream written;
+        written << in.rdbuf();
+        return {written.str(), emitter.c_str()};
+    }
+};
+
+#define CHECK_SAME_YAML(BOTH)                                                   \
+    do {                                                                        \
+        const auto [written, emitted] = (BOTH).finish();                        \
+        CHECK(written == emitted);                                              \
+        if (written != emitted) std::cerr << "YamlWriter:\n" << written         \
+                                          << "\nYAML::Emitter:\n" << emitted << "\n"; \
+    } while (0)
+
+// Fails in finalize(), after write_results has started on its YAML file.
+class FailingFinalize : public Analysis {
+public:
+    static constexpr const char* NAME = "FailingFinalize";
+    void finalize() override { throw std::runtime_error("finalize failed"); }
+    void save(const std::string& /*save_dir_path*/) override {}
+};
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+size_t files_in(const std::filesystem::path& dir) {
+    size_t n = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) n += entry.is_regular_file();
+    return n;
+}
+
+const std::vector<double> awkward_doubles = {
+    0.0, -0.0, 1.0, 100.0, 0.1, 1.0 / 3.0, -2.5e-5, 1e-5, 1e16, 1e21, 123456789012345678.0,
+    5e-324, 2.2250738585072014e-308, 1.7976931348623157e308, 0.30000000000000004};
+} // namespace
+
+REGISTER_ANALYSIS(FailingFinalize::NAME, FailingFinalize);
+
+TEST(yaml_writer_quotes_strings_like_the_emitter) {
+    testing::TempDir dir;
+    BothWriters both(dir.file("strings.yaml"));
+    const std::vector<std::string> strings = {
+        "plain", "SMASH-3.2", "rapidity_pdg_-211", "a/b", "1.5", "+3", "", "-", "~", "null", "Null",
+        "true", "no", "a: b", "a #b", "#comment", " leading", "trailing ", "it's", "say \"hi\"",
+        "two\nlines", "tab\there", "[x]", "{y}", "*ref", "&anchor", "!tag", "%pct", "@at", "`tick`",
+        "a,b", "?", "ünïcödé"};
+    both.begin_map();
+    for (size_t k = 0; k < strings.size(); ++k) {
+        both.key(strings[k], k % 2 == 1).value(std::string_view(strings[k]));
+    }
+    both.key("list").begin_seq();
+    for (const auto& s : strings) both.value(std::string_view(s));
+    both.end_seq().end_map();
+    CHECK_SAME_YAML(both);
+}
+
+TEST(yaml_writer_nests_collections_like_the_emitter) {
+    testing::TempDir dir;
+    BothWriters both(dir.file("nested.yaml"));
+    both.begin_map();
+    both.key("empty_map").begin_map().end_map();
+    both.key("empty_seq").begin_seq().end_seq();
+    both.key("items").begin_seq();
+    both.begin_map().end_map();                        // empty map as an item
+    both.begin_seq().end_seq();                        // empty sequence as an item
+    both.begin_map().key("a").value(1).key("b").begin_seq().value(2).end_seq().end_map();
+    both.begin_map().key("empty").begin_map().end_map().key("c").value(3).end_map();
+    both.begin_seq().begin_seq().value(4).end_seq().begin_map().key("d").value(5).end_map().end_seq();
+    both.begin_seq().begin_map().end_map().begin_seq().end_seq().end_seq();
+    both.flow_seq(std::vector<int>{1, 2, 3});
+    both.flow_seq(std::vector<int>{});
+    both.value(std::string_view("last"));
+    both.end_seq();
+    both.key("after").value(uint64_t{18446744073709551615ull});
+    both.end_map();
+    CHECK_SAME_YAML(both);
+}
+
+TEST(yaml_writer_writes_doubles_like_the_emitter) {
+    testing::TempDir dir;
+    BothWriters both(dir.file("doubles.yaml"));
+    std::vector<double> values = awkward_doubles;
+    values.insert(values.end(), {not_a_number, inf, -inf});
+    both.begin_map();
+    both.key("values").begin_seq();
+    for (double v : values) both.value(v);
+    both.end_seq();
+    both.key("flow").flow_seq(values);
+    both.key("nan").value(not_a_number).key("inf").value(inf).key("minus_inf").value(-inf);
+    both.key("ints").flow_seq(std::vector<int>{0, -1, std::numeric_limits<int>::min(),
+                                               std::numeric_limits<int>::max()});
+    both.end_map();
+    CHECK_SAME_YAML(both);
+}
+
+TEST(yaml_writer_writes_result_trees_like_the_emitter) {
+    testing::TempDir dir;
+    DataNode root;
+    DataNode& branch = root.add_child("branch");
+    Histogram1D h(-1.0, 1.0, 5);
+    for (double v : awkward_doubles) h.fill(v / 2e5, v);
+    branch.add_child("histogram", h);
+    branch.add_child("empty_branch");
+    root.add_child("double", 0.1);
+    root.add_child("nan", not_a_number);
+    root.add_child("ints", std::vector<int>{-1, 0, 1});
+    root.add_child("doubles", awkward_doubles);
+    root.add_child("no doubles", std::vector<double>{});
+    RunningMoments moments;
+    QuantileSketch sketch(20.0);
+    for (double v : awkward_doubles) {
+        if (std::abs(v) < 1e300) moments.add(v * 1e-10);
+        sketch.add(v);
+    }
+    root.add_child("moments", moments);
+    root.add_child("sketch", sketch);
+
+    const std::string path = dir.file("tree.yaml");
+    YamlWriter writer(path);
+    to_yaml(writer, root);
+    writer.close();
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream written;
+    written << in.rdbuf();
+
+    YAML::Emitter emitter;
+    to_yaml(emitter, root);
+    CHECK(written.str() == emitter.c_str());
+}
+
+TEST(yaml_writer_replaces_the_file_only_on_close) {
+    testing::TempDir dir;
+    const std::string path = dir.file("out.yaml");
+    {
+        std::ofstream(path) << "previous: 1\n";
+    }
+    {
+        YamlWriter out(path, 16);  // small buffer: flushes while writing
+        out.begin_map().key("a_long_enough_key").value(std::string_view("a long enough value"));
+        CHECK(read_file(path) == "previous: 1\n");
+    }
+    CHECK(read_file(path) == "previous: 1\n");
+    CHECK(files_in(dir.path) == 1);
+
+    YamlWriter out(path);
+    out.begin_map().key("current").value(2).end_map();
+    out.close();
+    CHECK(read_file(path) == "current: 2");
+    CHECK(files_in(dir.path) == 1);
+}
+
+TEST(failed_finalize_keeps_the_previous_yaml) {
+    testing::TempDir dir;
+    const std::string input = dir.file("events.bin");
+    SmashFile(input).particles(0, 0, 3).end(0).close();
+    const std::string output = dir.file("out");
+    std::filesystem::create_directories(output);
+    const std::string yaml = output + "/" + FailingFinalize::NAME + ".yaml";
+    {
+        std::ofstream(yaml) << "previous: 1\n";
+    }
+
+    CHECK_THROWS(run_analysis({{input, ""}}, FailingFinalize::NAME, SmashFile::quantities(),
+                              true, false, output),
+                 std::runtime_error);
+    CHECK(read_file(yaml) == "previous: 1\n");
+    CHECK(files_in(output) == 1);  // no temporary left behind
+}
@@ -0,0 +1,96 @@
+// Testing.h
+#ifndef TESTING_H
+#define TESTING_H
+
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "datatree.h"
+
+// Minimal harness for unit_tests: TEST(name) registers a test, CHECK
+// reports a failed condition and lets the test continue. main() (main.cc)
+// runs every test and fails if any check did.
+namespace testing {
+
+struct Test {
+    const char* name;
+    std::function<void()> run;
+};
+
+inline std::vector<Test>& registry() {
+    static std::vector<Test> tests;
+    return tests;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline bool register_test(const char* name, std::function<void()> run) {
+    registry().push_back({name, std::move(run)});
+    return true;
+}
+
+inline void fail(const char* file, int line, const std::string& what) {
+    ++failures();
+    std::cerr << file << ":" << line << ": CHECK failed: " << what << "\n";
+}
+
+// The tree as written by write_binary; equal bytes mean equal trees.
+inline std::string binary_of(const DataNode& node) {
+    std::ostringstream out;
+    write_binary(out, node);
+    return out.str();
+}
+
+// A fresh directory under the system temporary directory, removed with
+// everything in it when the object goes.
+struct TempDir {
+    std::filesystem::path path;
+
+    TempDir()
+        : path(std::filesystem::temp_directory_path() /
+               ("bark-test-" + std::to_string(std::random_device{}()))) {
+        std::filesystem::create_directories(path);
+    }
+    ~TempDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    std::string file(const std::string& name) const { return (path / name).string(); }
+};
+
+} // namespace testing
+
+#define TEST(NAME)                                                              \
+    static void test_##NAME();                                                  \
+    static const bool registered_##NAME = testing::register_test(#NAME, test_##NAME); \
+    static void test_##NAME()
+
+#define CHECK(COND)                                                             \
+    do {                                                                        \
+        if (!(COND)) testing::fail(__FILE__, __LINE__, #COND);                  \
+    } while (0)
+
+// Runs STATEMENT and checks that it throws EXCEPTION.
+#define CHECK_THROWS(STATEMENT, EXCEPTION)                                      \
+    do {                                                                        \
+        bool thrown = false;                                                    \
+        try {                                                                   \
+            STATEMENT;                                                          \
+        } catch (const EXCEPTION&) {                                            \
+            thrown = true;                                                      \
+        }                                                                       \
+        if (!thrown) testing::fail(__FILE__, __LINE__, #STATEMENT " throws " #EXCEPTION); \
+    } while (0)
+
+#endif // TESTING_H
@@ -0,0 +1,34 @@
+#include "treeanalysis.h"
+
+#include <cmath>
+
+#include "analysisregister.h"
+
+REGISTER_ANALYSIS(TreeAnalysis::NAME, TreeAnalysis);
+
+void TreeAnalysis::fill(int seed) {
+    DataNode& species = dataNode.add_child("species").add_child(std::to_string(211 + seed % 2));
+    species.add_child("count", 0);
+    species.add_child("pt", Histogram1D(0.0, 2.0, 20));
+    species.add_child("pt_moments", RunningMoments());
+    species.add_child("pt_range", MinMax());
+    species.add_child("pt_quantiles", QuantileSketch(50.0));
+    species.add_child("pt_sum", KahanSum());
+
+    auto& count = std::get<int>(species.children().find("count")->second.get_data());
+    for (int i = 0; i < 500; ++i) {
+        const double pt = 1.0 + std::sin(seed * 7.1 + i * 0.53);
+        ++count;
+        for (auto& [name, node] : species.children()) {
+            std::visit([&](auto& v) {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, Histogram1D>) {
+                    v.fill(pt, 0.5);
+                } else if constexpr (std::is_same_v<T, RunningMoments> || std::is_same_v<T, MinMax> ||
+                                     std::is_same_v<T, QuantileSketch> || std::is_same_v<T, KahanSum>) {
+                    v.add(pt);
+                }
+            }, node.get_data());
+        }
+    }
+}
@@ -0,0 +1,36 @@
+// TreeAnalysis.h
+#ifndef TREE_ANALYSIS_H
+#define TREE_ANALYSIS_H
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "analysis.h"
+
+// Analysis whose result tree is filled directly, for the tests of the
+// stored formats, which recreate analyses through the registry. Registered
+// as TreeAnalysis::NAME.
+class TreeAnalysis : public Analysis {
+public:
+    static constexpr const char* NAME = "TreeAnalysis";
+
+    // Adds a histogram, a count and every accumulator, with values
+    // depending on `seed`.
+    void fill(int seed);
+    void set_smash_version(std::string version) { smash_version = std::move(version); }
+
+    void finalize() override {}
+    void save(const std::string& /*save_dir_path*/) override {}
+};
+
+// A result entry holding a TreeAnalysis filled from `seed`.
+inline Entry tree_entry(int seed, MergeKeySet key) {
+    auto analysis = std::make_shared<TreeAnalysis>();
+    analysis->set_merge_keys(key);
+    analysis->set_smash_version("SMASH-3.2");
+    analysis->fill(seed);
+    return Entry{std::move(key), std::move(analysis)};
+}
+
+#endif // TREE_ANALYSIS_H